@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @brief A non-owning view of a contiguous range of elements
+ *
+ * Converts implicitly from std::vector with any allocator, so functions that take a span work on
+ * vectors as well as on memory owned by something else, such as the
+ * generations of a RetentiveArray.
+ */
+template<typename Type>
+class ArraySpan
+{
+public:
+	using ElementType = std::remove_const_t<Type>;
+
+	ArraySpan() = default;
+	ArraySpan(Type* data, size_t size) : pointer(data), count(size) {}
+
+	template<typename Allocator>
+	ArraySpan(std::vector<ElementType, Allocator>& vector) : pointer(vector.data()), count(vector.size()) {}
+
+	template<typename Allocator, typename Other = Type, typename std::enable_if_t<std::is_const<Other>::value, bool> = true>
+	ArraySpan(const std::vector<ElementType, Allocator>& vector) : pointer(vector.data()), count(vector.size()) {}
+
+	operator ArraySpan<const Type>() const { return ArraySpan<const Type>(pointer, count); }
+
+	Type& operator[](size_t index) const { return pointer[index]; }
+
+	Type* data() const { return pointer; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	Type* begin() const { return pointer; }
+	Type* end() const { return pointer + count; }
+
+private:
+	Type* pointer = nullptr;
+	size_t count = 0;
+};
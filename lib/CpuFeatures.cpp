@@ -0,0 +1,43 @@
+#include "CpuFeatures.hpp"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static CpuFeatures DetectCpuFeatures()
+{
+	CpuFeatures features;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	features.avx2 = __builtin_cpu_supports("avx2");
+	features.avx512f = __builtin_cpu_supports("avx512f");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || maxLeaf < 7)
+		return features;
+
+	unsigned long long xcr0 = _xgetbv(0);
+	bool ymmState = (xcr0 & 0x6) == 0x6;
+	bool zmmState = (xcr0 & 0xe6) == 0xe6;
+
+	__cpuidex(info, 7, 0);
+	features.avx2 = ymmState && (info[1] & (1 << 5)) != 0;
+	features.avx512f = zmmState && (info[1] & (1 << 16)) != 0;
+#endif
+
+	return features;
+}
+
+const CpuFeatures& GetCpuFeatures()
+{
+	static const CpuFeatures features = DetectCpuFeatures();
+	return features;
+}
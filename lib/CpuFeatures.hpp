@@ -0,0 +1,18 @@
+#pragma once
+
+/**
+ * @brief Instruction set extensions supported by the CPU the program is running on
+ *
+ * Only reports an extension if the operating system also saves the registers it needs,
+ * so everything reported here is safe to use.
+ */
+struct CpuFeatures
+{
+	bool avx2 = false;
+	bool avx512f = false;
+};
+
+/**
+ * @brief Detects the features of the current CPU. The result is cached after the first call.
+ */
+const CpuFeatures& GetCpuFeatures();
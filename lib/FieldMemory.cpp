@@ -0,0 +1,301 @@
+#include "FieldMemory.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <utility>
+
+#include "ThreadPool.hpp"
+
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#endif
+
+// Default of the most memory the pool keeps
+#define FIELD_POOL_LIMIT ((size_t)1024 * 1024 * 1024)
+
+struct FieldMemoryState
+{
+	std::mutex mutex;
+	HugePageMode mode = HugePageMode::Advise;
+	size_t poolLimit = FIELD_POOL_LIMIT;
+
+	// Free blocks by their rounded size
+	std::unordered_map<size_t, std::vector<void*>> pool;
+	FieldMemoryStats stats;
+
+	~FieldMemoryState();
+};
+
+static FieldMemoryState& GetState()
+{
+	static FieldMemoryState state;
+	return state;
+}
+
+static thread_local ThreadPool* firstTouchPool = nullptr;
+
+static bool IsLarge(size_t bytes)
+{
+	return bytes >= FIELD_HUGE_PAGE_SIZE;
+}
+
+// Blocks are pooled by the size they were really allocated with
+static size_t RoundUp(size_t bytes)
+{
+	size_t granularity = IsLarge(bytes) ? FIELD_HUGE_PAGE_SIZE : FIELD_ALIGNMENT;
+	return (std::max(bytes, (size_t)1) + granularity - 1) / granularity * granularity;
+}
+
+#if !defined(_WIN32)
+
+// Maps `bytes` (a multiple of the huge page size) at a huge page boundary
+static void* MapLarge(size_t bytes, HugePageMode mode)
+{
+#if defined(MAP_HUGETLB)
+	if (mode == HugePageMode::Explicit)
+	{
+		void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (memory != MAP_FAILED)
+			return memory;
+	}
+#endif
+
+	// Map one huge page more than needed and cut off the unaligned ends
+	size_t padded = bytes + FIELD_HUGE_PAGE_SIZE;
+	char* mapping = (char*)mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mapping == (char*)MAP_FAILED)
+		return nullptr;
+
+	char* aligned = (char*)(((uintptr_t)mapping + FIELD_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(FIELD_HUGE_PAGE_SIZE - 1));
+	if (aligned != mapping)
+		munmap(mapping, aligned - mapping);
+
+	char* end = aligned + bytes;
+	if (end != mapping + padded)
+		munmap(end, mapping + padded - end);
+
+#if defined(MADV_HUGEPAGE)
+	if (mode != HugePageMode::Off)
+		madvise(aligned, bytes, MADV_HUGEPAGE);
+#endif
+
+	return aligned;
+}
+
+static void UnmapLarge(void* memory, size_t bytes)
+{
+	munmap(memory, bytes);
+}
+
+#else
+
+static void* MapLarge(size_t bytes, HugePageMode mode)
+{
+	void* memory = ::operator new(bytes, std::align_val_t(FIELD_HUGE_PAGE_SIZE), std::nothrow);
+	if (memory != nullptr)
+		std::memset(memory, 0, bytes);
+
+	return memory;
+}
+
+static void UnmapLarge(void* memory, size_t bytes)
+{
+	::operator delete(memory, std::align_val_t(FIELD_HUGE_PAGE_SIZE));
+}
+
+#endif
+
+static void ReleaseBlock(void* memory, size_t rounded)
+{
+	if (IsLarge(rounded))
+		UnmapLarge(memory, rounded);
+	else
+		::operator delete(memory, std::align_val_t(FIELD_ALIGNMENT));
+}
+
+// Blocks still pooled at exit go back to the system like in ReleasePooledFieldMemory
+FieldMemoryState::~FieldMemoryState()
+{
+	for (auto& blocks : pool)
+		for (void* memory : blocks.second)
+			ReleaseBlock(memory, blocks.first);
+}
+
+// Takes pooled blocks of any size but `keep` out of the pool until it holds at most `limit` bytes.
+// The caller holds the lock and releases the blocks after dropping it.
+static void EvictPooled(FieldMemoryState& state, size_t limit, size_t keep, std::vector<std::pair<void*, size_t>>& evicted)
+{
+	for (auto& blocks : state.pool)
+	{
+		if (blocks.first == keep)
+			continue;
+
+		while (state.stats.pooledBytes > limit && !blocks.second.empty())
+		{
+			evicted.emplace_back(blocks.second.back(), blocks.first);
+			blocks.second.pop_back();
+			state.stats.pooledBytes -= blocks.first;
+		}
+	}
+}
+
+// Zeroes a fresh block on the threads of the pool, in the chunks ParallelFor gives them
+static void FirstTouch(void* memory, size_t bytes, ThreadPool* pool)
+{
+	const size_t page = 4096;
+	int pages = (int)((bytes + page - 1) / page);
+
+	pool->ParallelFor(0, pages, [&](int begin, int end)
+	{
+		size_t offset = (size_t)begin * page;
+		std::memset((char*)memory + offset, 0, std::min((size_t)end * page, bytes) - offset);
+	});
+}
+
+void* AllocateFieldMemory(size_t bytes)
+{
+	size_t rounded = RoundUp(bytes);
+	FieldMemoryState& state = GetState();
+
+	HugePageMode mode;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		state.stats.allocations++;
+		state.stats.liveBytes += rounded;
+		mode = state.mode;
+
+		// A pooled large block keeps the placement of its previous owner, which is not what a first touch scope asks for
+		bool placed = IsLarge(rounded) && firstTouchPool != nullptr;
+
+		auto blocks = state.pool.find(rounded);
+		if (!placed && blocks != state.pool.end() && !blocks->second.empty())
+		{
+			void* memory = blocks->second.back();
+			blocks->second.pop_back();
+			state.stats.pooledBytes -= rounded;
+			state.stats.reused++;
+			return memory;
+		}
+
+		if (IsLarge(rounded))
+			state.stats.largeBlocks++;
+	}
+
+	if (!IsLarge(rounded))
+		return ::operator new(rounded, std::align_val_t(FIELD_ALIGNMENT));
+
+	void* memory = MapLarge(rounded, mode);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+
+	if (firstTouchPool != nullptr)
+		FirstTouch(memory, rounded, firstTouchPool);
+
+	return memory;
+}
+
+void FreeFieldMemory(void* memory, size_t bytes)
+{
+	if (memory == nullptr)
+		return;
+
+	size_t rounded = RoundUp(bytes);
+	FieldMemoryState& state = GetState();
+	std::vector<std::pair<void*, size_t>> evicted;
+	bool pooled = false;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		state.stats.liveBytes -= rounded;
+
+		if (rounded <= state.poolLimit)
+		{
+			EvictPooled(state, state.poolLimit - rounded, rounded, evicted);
+			if (state.stats.pooledBytes + rounded <= state.poolLimit)
+			{
+				state.pool[rounded].push_back(memory);
+				state.stats.pooledBytes += rounded;
+				pooled = true;
+			}
+		}
+	}
+
+	for (const std::pair<void*, size_t>& block : evicted)
+		ReleaseBlock(block.first, block.second);
+
+	if (!pooled)
+		ReleaseBlock(memory, rounded);
+}
+
+void SetHugePageMode(HugePageMode mode)
+{
+	FieldMemoryState& state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	state.mode = mode;
+}
+
+HugePageMode GetHugePageMode()
+{
+	FieldMemoryState& state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	return state.mode;
+}
+
+void ReleasePooledFieldMemory()
+{
+	FieldMemoryState& state = GetState();
+	std::unordered_map<size_t, std::vector<void*>> pool;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		pool.swap(state.pool);
+		state.stats.pooledBytes = 0;
+	}
+
+	for (auto& blocks : pool)
+		for (void* memory : blocks.second)
+			ReleaseBlock(memory, blocks.first);
+}
+
+void SetFieldPoolLimit(size_t bytes)
+{
+	FieldMemoryState& state = GetState();
+	std::vector<std::pair<void*, size_t>> evicted;
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		state.poolLimit = bytes;
+
+		// Nothing is kept from being evicted here, no size is 0 bytes
+		EvictPooled(state, bytes, 0, evicted);
+	}
+
+	for (const std::pair<void*, size_t>& block : evicted)
+		ReleaseBlock(block.first, block.second);
+}
+
+size_t GetFieldPoolLimit()
+{
+	FieldMemoryState& state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	return state.poolLimit;
+}
+
+FieldMemoryStats GetFieldMemoryStats()
+{
+	FieldMemoryState& state = GetState();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	return state.stats;
+}
+
+ScopedFirstTouch::ScopedFirstTouch(ThreadPool* pool) :
+	previous(firstTouchPool)
+{
+	firstTouchPool = pool;
+}
+
+ScopedFirstTouch::~ScopedFirstTouch()
+{
+	firstTouchPool = previous;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+// Every field allocation starts on its own cache line
+#define FIELD_ALIGNMENT 64
+
+// Allocations from this size on are mapped directly from the OS and aligned to huge pages
+#define FIELD_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * @brief How the large field allocations are backed
+ */
+enum class HugePageMode
+{
+	Off,		// Regular pages
+	Advise,		// Transparent huge pages through madvise(MADV_HUGEPAGE), the default
+	Explicit	// Pages from the hugetlbfs pool, falling back to Advise if it is empty
+};
+
+/**
+ * @brief Allocates memory for simulation fields
+ *
+ * Small blocks come from the aligned heap. Large blocks are mapped directly, aligned to
+ * huge pages and backed by them as far as the mode and the OS allow, which keeps the TLB
+ * misses of sweeps over big grids down. Freed blocks are kept in a pool and handed out
+ * again for the next request of the same size, so fields that are created and destroyed
+ * over and over, like the runs of an ensemble, don't go back to the OS every time.
+ *
+ * Blocks from the pool hold whatever their last owner left in them. Fresh large blocks
+ * are zero and have not been touched yet. Inside a ScopedFirstTouch large blocks are
+ * never taken from the pool, since their pages already live wherever they were first
+ * touched. They are mapped fresh and cleared by the threads of its pool instead, each
+ * thread the same part it gets from ThreadPool::ParallelFor, so on NUMA machines the
+ * pages end up next to the threads that will work on them. Thread safe.
+ */
+void* AllocateFieldMemory(size_t bytes);
+void FreeFieldMemory(void* memory, size_t bytes);
+
+// Applies to the blocks allocated after the call
+void SetHugePageMode(HugePageMode mode);
+HugePageMode GetHugePageMode();
+
+// Hands every pooled block back to the OS
+void ReleasePooledFieldMemory();
+
+// Most bytes the pool keeps, 1 GiB by default. A freed block that doesn't fit pushes out
+// blocks of other sizes first, which are the least likely to be asked for again, and is
+// returned to the OS if that is not enough. Lowering the limit trims the pool right away.
+void SetFieldPoolLimit(size_t bytes);
+size_t GetFieldPoolLimit();
+
+struct FieldMemoryStats
+{
+	size_t liveBytes = 0;		// Held by fields right now
+	size_t pooledBytes = 0;		// Freed and waiting to be reused
+	long long allocations = 0;
+	long long reused = 0;		// Allocations served from the pool
+	long long largeBlocks = 0;	// Blocks mapped from the OS so far
+};
+
+FieldMemoryStats GetFieldMemoryStats();
+
+/**
+ * @brief Makes the calling thread place new large field blocks with first touch on the pool's threads
+ *
+ * Scopes nest, and a null pool places them on the calling thread again.
+ */
+class ScopedFirstTouch
+{
+public:
+	ScopedFirstTouch(ThreadPool* pool);
+	~ScopedFirstTouch();
+
+	ScopedFirstTouch(const ScopedFirstTouch& other) = delete;
+	ScopedFirstTouch& operator=(const ScopedFirstTouch& other) = delete;
+
+private:
+	ThreadPool* previous;
+};
+
+/**
+ * @brief A standard allocator on top of AllocateFieldMemory
+ */
+template<typename T>
+class FieldAllocator
+{
+public:
+	using value_type = T;
+
+	FieldAllocator() = default;
+
+	template<typename Other>
+	FieldAllocator(const FieldAllocator<Other>&) {}
+
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(AllocateFieldMemory(count * sizeof(T)));
+	}
+
+	void deallocate(T* memory, size_t count)
+	{
+		FreeFieldMemory(memory, count * sizeof(T));
+	}
+
+	template<typename Other>
+	bool operator==(const FieldAllocator<Other>&) const { return true; }
+
+	template<typename Other>
+	bool operator!=(const FieldAllocator<Other>&) const { return false; }
+};
+
+template<typename T>
+using FieldVector = std::vector<T, FieldAllocator<T>>;
@@ -0,0 +1,43 @@
+#include "FloatingPoint.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define HAS_MXCSR 1
+#else
+#define HAS_MXCSR 0
+#endif
+
+// Flush-to-zero for results and denormals-are-zero for inputs
+#define MXCSR_FTZ 0x8000
+#define MXCSR_DAZ 0x0040
+
+unsigned int GetFloatingPointMode()
+{
+#if HAS_MXCSR
+	return _mm_getcsr();
+#else
+	return 0;
+#endif
+}
+
+void SetFloatingPointMode(unsigned int mode)
+{
+#if HAS_MXCSR
+	_mm_setcsr(mode);
+#else
+	(void)mode;
+#endif
+}
+
+ScopedFlushDenormals::ScopedFlushDenormals(bool enable) :
+	previous(GetFloatingPointMode()), active(enable)
+{
+	if (active)
+		SetFloatingPointMode(previous | MXCSR_FTZ | MXCSR_DAZ);
+}
+
+ScopedFlushDenormals::~ScopedFlushDenormals()
+{
+	if (active)
+		SetFloatingPointMode(previous);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+/**
+ * @brief Reads the floating point control state of the calling thread
+ *
+ * On x86 this is the MXCSR register, elsewhere it is always 0.
+ */
+unsigned int GetFloatingPointMode();
+
+/**
+ * @brief Replaces the floating point control state of the calling thread
+ */
+void SetFloatingPointMode(unsigned int mode);
+
+/**
+ * @brief Makes the calling thread flush denormal numbers to zero until it goes out of scope
+ *
+ * Values that decay towards zero spend a long time in the denormal range, and
+ * arithmetic on denormals is an order of magnitude slower on most CPUs.
+ * This matters for single precision fields in particular, where the denormal
+ * range starts at around 1e-38. Does nothing on platforms without such a mode.
+ */
+class ScopedFlushDenormals
+{
+public:
+	ScopedFlushDenormals(bool enable = true);
+	~ScopedFlushDenormals();
+
+	ScopedFlushDenormals(const ScopedFlushDenormals& other) = delete;
+	ScopedFlushDenormals& operator=(const ScopedFlushDenormals& other) = delete;
+
+private:
+	unsigned int previous;
+	bool active;
+};
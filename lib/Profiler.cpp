@@ -0,0 +1,238 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	enum class EventType : uint8_t
+	{
+		Scope,
+		Counter
+	};
+
+	struct Event
+	{
+		const char* name;
+		uint64_t start;
+		uint64_t duration;
+		double value;
+		EventType type;
+	};
+
+	struct ThreadBuffer
+	{
+		int index = 0;
+		std::string name;
+
+		std::vector<Event> events = std::vector<Event>(PROFILER_RING_CAPACITY);
+		std::atomic<uint64_t> count{ 0 };
+	};
+
+	std::atomic<bool> enabled{ false };
+	const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> registry;
+	thread_local ThreadBuffer* localBuffer = nullptr;
+
+	// Kept apart from the buffer, so naming a thread does not allocate a ring it may never use
+	thread_local std::string localName;
+
+	ThreadBuffer& GetBuffer()
+	{
+		if (localBuffer == nullptr)
+		{
+			std::lock_guard<std::mutex> lock(registryMutex);
+			registry.push_back(std::make_unique<ThreadBuffer>());
+			registry.back()->index = (int)registry.size();
+			registry.back()->name = localName;
+			localBuffer = registry.back().get();
+		}
+
+		return *localBuffer;
+	}
+
+	void Record(const Event& event)
+	{
+		if (!enabled.load(std::memory_order_relaxed))
+			return;
+
+		ThreadBuffer& buffer = GetBuffer();
+
+		// Only this thread writes the buffer, readers see complete events up to count
+		uint64_t count = buffer.count.load(std::memory_order_relaxed);
+		buffer.events[count & (PROFILER_RING_CAPACITY - 1)] = event;
+		buffer.count.store(count + 1, std::memory_order_release);
+	}
+
+	// Calls `visit(buffer, event)` for every event still held, oldest first
+	template<typename Visitor>
+	void ForEachEvent(Visitor&& visit)
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (const std::unique_ptr<ThreadBuffer>& buffer : registry)
+		{
+			uint64_t count = buffer->count.load(std::memory_order_acquire);
+			uint64_t first = (count > PROFILER_RING_CAPACITY) ? count - PROFILER_RING_CAPACITY : 0;
+
+			for (uint64_t n = first; n < count; n++)
+				visit(*buffer, buffer->events[n & (PROFILER_RING_CAPACITY - 1)]);
+		}
+	}
+
+	double Percentile(std::vector<double>& values, double fraction)
+	{
+		size_t rank = std::min((size_t)(fraction * values.size()), values.size() - 1);
+		std::nth_element(values.begin(), values.begin() + rank, values.end());
+		return values[rank];
+	}
+}
+
+void Profiler::SetEnabled(bool enable)
+{
+	enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool Profiler::IsEnabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t Profiler::Now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::RecordScope(const char* name, uint64_t start, uint64_t end)
+{
+	Record({ name, start, end - start, 0.0, EventType::Scope });
+}
+
+void Profiler::RecordCounter(const char* name, double value)
+{
+	Record({ name, Now(), 0, value, EventType::Counter });
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	localName = name;
+	if (localBuffer == nullptr)
+		return;
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+	localBuffer->name = name;
+}
+
+bool Profiler::WriteChromeTrace(const std::string& path)
+{
+	FILE* file = std::fopen(path.c_str(), "w");
+	if (file == nullptr)
+		return false;
+
+	std::fprintf(file, "{\"traceEvents\":[\n");
+
+	bool first = true;
+	auto separator = [&]()
+	{
+		if (!first)
+			std::fprintf(file, ",\n");
+
+		first = false;
+	};
+
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (const std::unique_ptr<ThreadBuffer>& buffer : registry)
+		{
+			if (buffer->name.empty())
+				continue;
+
+			separator();
+			std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", buffer->index, buffer->name.c_str());
+		}
+	}
+
+	ForEachEvent([&](const ThreadBuffer& buffer, const Event& event)
+	{
+		separator();
+		if (event.type == EventType::Scope)
+		{
+			std::fprintf(file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				event.name, buffer.index, event.start * 1e-3, event.duration * 1e-3);
+		}
+		else
+		{
+			std::fprintf(file, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"value\":%.9g}}",
+				event.name, buffer.index, event.start * 1e-3, event.value);
+		}
+	});
+
+	std::fprintf(file, "\n]}\n");
+	return std::fclose(file) == 0;
+}
+
+void Profiler::PrintSummary(std::ostream& out)
+{
+	std::map<std::string, std::vector<double>> scopes;
+	std::map<std::string, std::vector<double>> counters;
+
+	ForEachEvent([&](const ThreadBuffer&, const Event& event)
+	{
+		if (event.type == EventType::Scope)
+			scopes[event.name].push_back(event.duration * 1e-3);
+		else
+			counters[event.name].push_back(event.value);
+	});
+
+	if (scopes.empty() && counters.empty())
+		return;
+
+	std::ios_base::fmtflags flags = out.flags();
+	out << std::fixed << std::setprecision(1);
+
+	if (!scopes.empty())
+	{
+		out << std::left << std::setw(24) << "Scope" << std::right << std::setw(10) << "count"
+			<< std::setw(12) << "p50 us" << std::setw(12) << "p99 us" << std::setw(12) << "max us" << std::setw(12) << "total ms" << std::endl;
+
+		for (auto& scope : scopes)
+		{
+			std::vector<double>& durations = scope.second;
+			double total = 0.0;
+			for (double duration : durations)
+				total += duration;
+
+			out << std::left << std::setw(24) << scope.first << std::right << std::setw(10) << durations.size()
+				<< std::setw(12) << Percentile(durations, 0.5) << std::setw(12) << Percentile(durations, 0.99)
+				<< std::setw(12) << *std::max_element(durations.begin(), durations.end()) << std::setw(12) << total * 1e-3 << std::endl;
+		}
+	}
+
+	if (!counters.empty())
+	{
+		out << std::left << std::setw(24) << "Counter" << std::right << std::setw(10) << "count"
+			<< std::setw(12) << "mean" << std::setw(12) << "max" << std::endl;
+
+		out << std::setprecision(4) << std::defaultfloat;
+		for (auto& counter : counters)
+		{
+			const std::vector<double>& values = counter.second;
+			double sum = 0.0;
+			for (double value : values)
+				sum += value;
+
+			out << std::left << std::setw(24) << counter.first << std::right << std::setw(10) << values.size()
+				<< std::setw(12) << sum / values.size() << std::setw(12) << *std::max_element(values.begin(), values.end()) << std::endl;
+		}
+	}
+
+	out.flags(flags);
+}
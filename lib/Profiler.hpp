@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Set by the build. Without it, PROFILE_SCOPE and PROFILE_COUNTER compile to nothing.
+#ifndef EULER_FLUID_PROFILING
+#define EULER_FLUID_PROFILING 0
+#endif
+
+// Events kept per thread, older ones are overwritten. Must be a power of two.
+#define PROFILER_RING_CAPACITY 65536
+
+/**
+ * @brief Collects timed scopes and counter values from any thread
+ *
+ * Every thread writes into a ring buffer of its own, so recording an event is a
+ * clock read and a store, without locks. Only the first event of a thread takes
+ * a lock to register its buffer, so threads that never record while profiling
+ * is enabled never allocate one. Buffers outlive their threads, so events of
+ * finished threads still show up in the output.
+ *
+ * Recording is off until SetEnabled(true) is called. WriteChromeTrace and
+ * PrintSummary read all buffers and should be called while the instrumented
+ * threads are idle, e.g. at exit.
+ */
+class Profiler
+{
+public:
+	static void SetEnabled(bool enabled);
+	static bool IsEnabled();
+
+	// Nanoseconds since the first use of the profiler
+	static uint64_t Now();
+
+	static void RecordScope(const char* name, uint64_t start, uint64_t end);
+	static void RecordCounter(const char* name, double value);
+
+	// Label for the calling thread in the trace. Only the name is stored until the thread records an event.
+	static void SetThreadName(const char* name);
+
+	/**
+	 * @brief Writes all recorded events in the Chrome trace event format
+	 *
+	 * The file can be opened in chrome://tracing or Perfetto.
+	 */
+	static bool WriteChromeTrace(const std::string& path);
+
+	/**
+	 * @brief Prints count, p50, p99 and maximum of every scope, and mean and maximum of every counter
+	 *
+	 * Only the events still held by the ring buffers are included, so for long runs
+	 * this covers the most recent window.
+	 */
+	static void PrintSummary(std::ostream& out);
+};
+
+/**
+ * @brief Records the time between its construction and destruction as a scope event
+ */
+class ScopedTimer
+{
+public:
+	ScopedTimer(const char* name) :
+		name(name), active(Profiler::IsEnabled()), start(active ? Profiler::Now() : 0)
+	{
+	}
+
+	~ScopedTimer()
+	{
+		if (active)
+			Profiler::RecordScope(name, start, Profiler::Now());
+	}
+
+	ScopedTimer(const ScopedTimer& other) = delete;
+	ScopedTimer& operator=(const ScopedTimer& other) = delete;
+
+private:
+	const char* name;
+	bool active;
+	uint64_t start;
+};
+
+#if EULER_FLUID_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing block. `name` must be a string literal or otherwise outlive the profiler.
+#define PROFILE_SCOPE(name) ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_COUNTER(name, value) do { if (Profiler::IsEnabled()) Profiler::RecordCounter(name, (double)(value)); } while (0)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#endif
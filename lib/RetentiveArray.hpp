@@ -1,7 +1,10 @@
 #pragma once
 
+#include "ArraySpan.hpp"
 #include "RetentiveEntity.hpp"
 
+#include <type_traits>
+
 /**
 * @brief An array that remembers its past.
 * 
@@ -14,6 +17,10 @@
  * This structure handles the evolution of these kinds of arrays and takes
  * care of the memory allocation/freeing as well as properly swapping the 
  * arrays.
+ *
+ * All generations share one aligned allocation. Each generation starts on its
+ * own cache line, and evolving only moves the ring index, so no data is copied
+ * or swapped no matter how many generations are remembered.
  * 
  * @tparam Type The type of the elements in the array
  * @tparam AttentionSpan How many generations of the data will be remembered by the array
@@ -22,7 +29,7 @@ template<
 	typename Type, 
 	unsigned int AttentionSpan, 
 	typename std::enable_if_t<(AttentionSpan > 0), bool> = true>
-class RetentiveArray : public RetentiveEntity<std::vector<Type>, AttentionSpan>
+class RetentiveArray : public RetentiveEntity<AttentionSpan>
 {
 public:
 	/**
@@ -38,13 +45,10 @@ public:
 	 * 
 	 * @param size The size of the data contained in the array
 	 */
-	RetentiveArray(size_t size)
+	RetentiveArray(size_t size) :
+		size(size), stride(PaddedSize(size)), arena(stride * this->Generations, Type())
 	{
-		// Create new vectors for every generation that needs to be remembered
-		for (int n = 0; n <= AttentionSpan; n++)
-		{
-			data[n] = std::vector<Type>(size, Type());
-		}
+		// Do nothing
 	}
 
 	/**
@@ -52,64 +56,118 @@ public:
 	 *
 	 * @param other The retentive array to copy from
 	 */
+	RetentiveArray(const RetentiveArray<Type, AttentionSpan>& other) :
+		RetentiveEntity<AttentionSpan>(other), size(other.size), stride(other.stride), arena(other.arena)
+	{
+		// Do nothing
+	}
+
+	/**
+	 * @brief Constructs a new retentive array that takes over the memory of an rvalue
+	 *
+	 * @param other The retentive array to take the data from. It is left empty
+	 */
+	RetentiveArray(RetentiveArray<Type, AttentionSpan>&& other) noexcept
+	{
+		Swap(other);
+	}
+
+	/**
+	 * @brief Copies the data of another array into this one
+	 *
+	 * @param other The retentive array to copy from
+	 */
 	RetentiveArray<Type, AttentionSpan>& operator=(const RetentiveArray<Type, AttentionSpan>& other)
 	{
-		for (int n = 0; n <= AttentionSpan; n++)
-		{
-			data[n] = std::vector<Type>(other.data[n]);
-		}
+		RetentiveArray<Type, AttentionSpan> copy(other);
+		Swap(copy);
 
 		return *this;
 	}
 
 	/**
-	 * @brief Constructs a new retentive array pointing to the data of an rvalue
+	 * @brief Takes over the memory of an rvalue
 	 *
-	 * @param other The retentive array to set its data to
+	 * @param other The retentive array to take the data from
 	 */
-	RetentiveArray<Type, AttentionSpan>& operator=(RetentiveArray<Type, AttentionSpan>&& other)
+	RetentiveArray<Type, AttentionSpan>& operator=(RetentiveArray<Type, AttentionSpan>&& other) noexcept
 	{
-		for (int n = 0; n <= AttentionSpan; n++)
-		{
-			data[n] = std::vector<Type>(std::move(other.data[n]));
-		}
+		Swap(other);
 
 		return *this;
 	}
 
 	/**
-	 * @brief Constructs a new retentive array with the data of another array
+	 * @brief Get the array from `index` generations ago
 	 *
-	 * @param other The retentive array to copy from
+	 * @param index Amount of generations to go backwards in time
+	 * @return The array from before `index` generations
 	 */
-	RetentiveArray(const RetentiveArray<Type, AttentionSpan>& other)
+	ArraySpan<Type> operator[](size_t index)
 	{
-		*this = other;
+		return ArraySpan<Type>(arena.Get() + this->Slot(index) * stride, size);
 	}
 
 	/**
-	 * @brief Constructs a new retentive array pointing to the data of an rvalue
+	 * @brief Get the array from `index` generations ago
 	 *
-	 * @param other The retentive array to set its data to
+	 * @param index Amount of generations to go backwards in time
+	 * @return The array from before `index` generations
 	 */
-	RetentiveArray(RetentiveArray<Type, AttentionSpan>&& other)
+	ArraySpan<const Type> operator[](size_t index) const
 	{
-		*this = other;
+		return ArraySpan<const Type>(arena.Get() + this->Slot(index) * stride, size);
 	}
 
-	~RetentiveArray()
+	/**
+	 * @brief Get the most up-to-date array
+	 *
+	 * @return The array with generation 0
+	 */
+	ArraySpan<Type> Current()
 	{
-		// Do nothing
+		return (*this)[0];
+	}
+
+	/**
+	 * @brief Get the most up-to-date array
+	 *
+	 * @return The array with generation 0
+	 */
+	ArraySpan<const Type> Current() const
+	{
+		return (*this)[0];
+	}
+
+	/**
+	 * @brief The number of elements in every generation
+	 */
+	size_t GetSize() const
+	{
+		return size;
 	}
 
 private:
-	void CycleGenerations() override
+	void Swap(RetentiveArray<Type, AttentionSpan>& other) noexcept
 	{
-		// Cycle the array contents, so that the previous "current" array is now the 2nd. 
-		// The 2nd becomes the 3rd etc, and the former last array becomes the new current
-		for (int n = 1; n <= AttentionSpan; n++)
-		{
-			data[0].swap(data[n]);
-		}
+		this->SwapState(other);
+		std::swap(size, other.size);
+		std::swap(stride, other.stride);
+		std::swap(arena, other.arena);
 	}
+
+	// Rounds a generation up to whole cache lines, so the next one starts on a fresh line
+	static size_t PaddedSize(size_t size)
+	{
+		size_t line = RETENTIVE_ALIGNMENT / sizeof(Type);
+		if (line <= 1)
+			return size;
+
+		return (size + line - 1) / line * line;
+	}
+
+private:
+	size_t size = 0;
+	size_t stride = 0;
+	RetentiveArena<Type> arena;
 };
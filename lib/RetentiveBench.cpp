@@ -0,0 +1,122 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <utility>
+
+#include "RetentiveArray.hpp"
+#include "RetentiveObject.hpp"
+
+// Measures what retentive containers cost per generation, separately from the work the rule does.
+// The rule only writes one element and captures about as much state as the solver's rules do,
+// so whatever is left is bookkeeping.
+
+static constexpr int BENCH_ELEMENTS = 4096;
+static constexpr int BENCH_GENERATIONS = 2000000;
+
+struct Payload
+{
+	double values[8];
+};
+
+// Keeps the optimizer from dropping work whose result is never read
+static void Escape(void* pointer)
+{
+#if defined(__GNUC__)
+	asm volatile("" : : "g"(pointer) : "memory");
+#else
+	static void* volatile sink;
+	sink = pointer;
+#endif
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<unsigned int AttentionSpan>
+static void BenchArray()
+{
+	RetentiveArray<double, AttentionSpan> array(BENCH_ELEMENTS);
+	double scale = 0.5, offset = 0.25;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int n = 0; n < BENCH_GENERATIONS; n++)
+		array.Evolve([&array, n, scale, offset]() { array.Current()[n % BENCH_ELEMENTS] = n * scale + offset; });
+
+	Escape(&array.Current()[0]);
+
+	double evolve = Seconds(start) / BENCH_GENERATIONS;
+
+	start = std::chrono::steady_clock::now();
+	for (int n = 0; n < 1000; n++)
+	{
+		RetentiveArray<double, AttentionSpan> moved(std::move(array));
+		Escape(&moved);
+		array = std::move(moved);
+		Escape(&array);
+	}
+
+	double move = Seconds(start) / 2000;
+
+	start = std::chrono::steady_clock::now();
+	for (int n = 0; n < 1000; n++)
+	{
+		RetentiveArray<double, AttentionSpan> copy(array);
+		Escape(&copy.Current()[0]);
+	}
+
+	double copy = Seconds(start) / 1000;
+
+	std::cout << "RetentiveArray   span " << std::setw(3) << AttentionSpan
+		<< "  evolve " << std::setw(8) << evolve * 1e9 << " ns"
+		<< "  move " << std::setw(8) << move * 1e9 << " ns"
+		<< "  copy " << std::setw(10) << copy * 1e9 << " ns" << std::endl;
+}
+
+template<unsigned int AttentionSpan>
+static void BenchObject()
+{
+	RetentiveObject<Payload, AttentionSpan> object;
+	double scale = 0.5, offset = 0.25;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int n = 0; n < BENCH_GENERATIONS; n++)
+		object.Evolve([&object, n, scale, offset]() { object.Current().values[n % 8] = n * scale + offset; });
+
+	Escape(&object.Current());
+
+	double evolve = Seconds(start) / BENCH_GENERATIONS;
+
+	start = std::chrono::steady_clock::now();
+	for (int n = 0; n < 1000; n++)
+	{
+		RetentiveObject<Payload, AttentionSpan> moved(std::move(object));
+		Escape(&moved);
+		object = std::move(moved);
+		Escape(&object);
+	}
+
+	double move = Seconds(start) / 2000;
+
+	std::cout << "RetentiveObject  span " << std::setw(3) << AttentionSpan
+		<< "  evolve " << std::setw(8) << evolve * 1e9 << " ns"
+		<< "  move " << std::setw(8) << move * 1e9 << " ns" << std::endl;
+}
+
+int main()
+{
+	std::cout << std::fixed << std::setprecision(2);
+
+	BenchArray<1>();
+	BenchArray<4>();
+	BenchArray<16>();
+	BenchArray<64>();
+
+	BenchObject<1>();
+	BenchObject<4>();
+	BenchObject<16>();
+	BenchObject<64>();
+
+	return 0;
+}
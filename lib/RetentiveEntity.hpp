@@ -1,110 +1,136 @@
 #pragma once
 
-#include <vector>
-#include <array>
+#include <algorithm>
+#include <cstddef>
 #include <functional>
-#include <memory>
-
-template<
-	typename Type,
-	unsigned int AttentionSpan,
-	bool IsPointerType>
-class _RetentiveEntityBase;
-
-template<
-	typename Type,
-	unsigned int AttentionSpan>
-class _RetentiveEntityBase<Type, AttentionSpan, false>
+#include <new>
+#include <utility>
+
+#include "FieldMemory.hpp"
+
+// Every generation of a retentive entity starts on its own cache line
+#define RETENTIVE_ALIGNMENT FIELD_ALIGNMENT
+
+/**
+ * @brief One cache-aligned block of memory holding `count` objects
+ *
+ * All generations of a retentive entity live in a single arena, so evolving
+ * never allocates and the generations sit next to each other in memory.
+ * The arena comes from AllocateFieldMemory, so large ones use huge pages.
+ */
+template<typename Type>
+class RetentiveArena
 {
 public:
-	/**
-	 * @brief Get the entity from `index` generations ago
-	 *
-	 * @param index Amount of generations to go backwards in time
-	 * @return The entity from before `index` generations
-	 */
-	Type& operator[](size_t index)
+	RetentiveArena() {}
+
+	RetentiveArena(size_t count, const Type& value) :
+		count(count)
 	{
-		return data[index];
+		if (count == 0)
+			return;
+
+		objects = Allocate(count);
+		try
+		{
+			std::uninitialized_fill_n(objects, count, value);
+		}
+		catch (...)
+		{
+			// The objects that were constructed are already destroyed again
+			Free(objects, count);
+			throw;
+		}
 	}
 
-	/**
-	 * @brief Get the most up-to-date entity
-	 *
-	 * @return The entity with generation 0
-	 */
-	Type& Current()
+	RetentiveArena(const RetentiveArena& other) :
+		count(other.count)
 	{
-		return data[0];
+		if (count == 0)
+			return;
+
+		objects = Allocate(count);
+		try
+		{
+			std::uninitialized_copy_n(other.objects, count, objects);
+		}
+		catch (...)
+		{
+			Free(objects, count);
+			throw;
+		}
 	}
 
-protected:
-	std::array<Type, AttentionSpan + 1> data;
-};
+	RetentiveArena(RetentiveArena&& other) noexcept :
+		objects(other.objects), count(other.count)
+	{
+		other.objects = nullptr;
+		other.count = 0;
+	}
 
+	RetentiveArena& operator=(RetentiveArena other) noexcept
+	{
+		std::swap(objects, other.objects);
+		std::swap(count, other.count);
+		return *this;
+	}
 
-template<
-	typename Type,
-	unsigned int AttentionSpan>
-class _RetentiveEntityBase<Type, AttentionSpan, true>
-{
-public:
-	/**
-	 * @brief Get the entity from `index` generations ago
-	 *
-	 * @param index Amount of generations to go backwards in time
-	 * @return The entity from before `index` generations
-	 */
-	Type& operator[](size_t index)
+	~RetentiveArena()
 	{
-		return *(data[index]);
+		if (objects == nullptr)
+			return;
+
+		for (size_t i = 0; i < count; i++)
+			objects[i].~Type();
+
+		Free(objects, count);
 	}
 
-	/**
-	 * @brief Get the most up-to-date entity
-	 *
-	 * @return The entity with generation 0
-	 */
-	Type& Current()
+	Type* Get() const { return objects; }
+	size_t GetCount() const { return count; }
+
+private:
+	static Type* Allocate(size_t count)
 	{
-		return *(data[0]);
+		static_assert(alignof(Type) <= FIELD_ALIGNMENT, "Field memory is only aligned to cache lines");
+		return static_cast<Type*>(AllocateFieldMemory(count * sizeof(Type)));
 	}
 
-protected:
-	std::array<std::shared_ptr<Type>, AttentionSpan + 1> data;	// Shared for move semantics
+	static void Free(Type* objects, size_t count)
+	{
+		FreeFieldMemory(objects, count * sizeof(Type));
+	}
+
+private:
+	Type* objects = nullptr;
+	size_t count = 0;
 };
 
 /**
- * @brief Abstract base type for all retentive things
+ * @brief Base type for all retentive things
+ *
+ * Keeps track of which slot holds which generation. The slots themselves never move:
+ * evolving only rotates a ring index, so it costs the same for any attention span.
  *
- * @tparam Type The object to give a memory to
  * @tparam AttentionSpan How many generations of the data will be remembered by the object
  */
-template<
-	typename Type,
-	unsigned int AttentionSpan,
-	bool IsPointerType = false>
-class RetentiveEntity : public _RetentiveEntityBase<Type, AttentionSpan, IsPointerType>
+template<unsigned int AttentionSpan>
+class RetentiveEntity
 {
 public:
-	RetentiveEntity() {}
-	RetentiveEntity(const RetentiveEntity<Type, AttentionSpan>& other) = delete;
-	RetentiveEntity(RetentiveEntity<Type, AttentionSpan>&& other) = delete;
-	RetentiveEntity<Type, AttentionSpan>& operator=(const RetentiveEntity<Type, AttentionSpan>& other) = delete;
-	RetentiveEntity<Type, AttentionSpan>& operator=(RetentiveEntity<Type, AttentionSpan>&& other) = delete;
+	static constexpr unsigned int Generations = AttentionSpan + 1;
 
 	/**
 	 * @brief Evolve the data in the entity
 	 *
-	 * Simply calls the member function pointer. The called function is then
+	 * Simply calls the rule set with SetEvolutionRule. The called function is then
 	 * supposed to perform whatever is needed to compute the new object contents.
 	 *
-	 * The data is swapped BEFORE calling this function, so the evolution function should
-	 * modify the data in the Current() vector (index 0)
+	 * The data is cycled BEFORE calling this function, so the evolution function should
+	 * modify the data in the Current() slot (index 0)
 	 */
 	void Evolve()
 	{
-		// Evolve the object
 		CycleGenerations();
 		rule();
 	}
@@ -112,15 +138,17 @@ public:
 	/**
 	 * @brief Evolve the data in the object
 	 *
-	 * Simply calls the provided function pointer. The called function is then
-	 * supposed to perform whatever is needed to compute the new object contents.
+	 * Calls the provided callable, which is supposed to perform whatever is needed
+	 * to compute the new object contents. It is taken as a template parameter,
+	 * so lambdas are called directly and can be inlined.
 	 *
-	 * The data is swapped BEFORE calling this function, so the evolution function should
-	 * modify the data in the Current() vector (index 0)
+	 * The data is cycled BEFORE calling this function, so the evolution function should
+	 * modify the data in the Current() slot (index 0)
 	 *
-	 * @param rule A function that evolves the data in the object
+	 * @param rule A callable that evolves the data in the object
 	 */
-	void Evolve(std::function<void(void)> rule)
+	template<typename Rule>
+	void Evolve(Rule&& rule)
 	{
 		CycleGenerations();
 		rule();
@@ -133,12 +161,35 @@ public:
 	 */
 	void SetEvolutionRule(std::function<void(void)> rule)
 	{
-		this->rule = rule;
+		this->rule = std::move(rule);
 	}
 
 protected:
 	/**
-	 * @brief Swaps the objects in the array
+	 * @brief The slot that holds the data from `index` generations ago
 	 */
-	virtual void CycleGenerations() = 0;
+	unsigned int Slot(size_t index) const
+	{
+		// Valid indices never wrap around more than once
+		unsigned int slot = head + (unsigned int)index;
+		return (slot >= Generations) ? slot - Generations : slot;
+	}
+
+	/**
+	 * @brief Makes the oldest generation the new current one, and every other generation one older
+	 */
+	void CycleGenerations()
+	{
+		head = (head == 0) ? AttentionSpan : head - 1;
+	}
+
+	void SwapState(RetentiveEntity& other) noexcept
+	{
+		std::swap(head, other.head);
+		std::swap(rule, other.rule);
+	}
+
+protected:
+	unsigned int head = 0;
+	std::function<void(void)> rule;
 };
@@ -13,8 +13,8 @@
  * the state of the object from the last n generations.
  *
  * This structure handles the evolution of these kinds of objects and takes
- * care of the memory allocation/freeing as well as properly swapping the
- * object pointers.
+ * care of the memory allocation/freeing. The generations are stored next to
+ * each other in one aligned allocation, and evolving only moves the ring index.
  *
  * @tparam Type The object to give a memory to
  * @tparam AttentionSpan How many generations of the data will be remembered by the object
@@ -22,33 +22,27 @@
 template<
 	typename Type,
 	unsigned int AttentionSpan>
-class RetentiveObject : public RetentiveEntity<Type, AttentionSpan, true>
+class RetentiveObject : public RetentiveEntity<AttentionSpan>
 {
 public:
 	/**
 	 * @brief Constructs a new, empty retentive object
 	 */
-	RetentiveObject()
+	RetentiveObject() :
+		arena(this->Generations, Type())
 	{
-		// Create new vectors for every generation that needs to be remembered
-		for (int n = 0; n <= AttentionSpan; n++)
-		{
-			data[n] = std::make_shared<Type>();
-		}
+		// Do nothing
 	}
 
 	/**
 	 * @brief Constructs a new, empty retentive object
 	 *
-	 * @param size The size of the data contained in the object
+	 * @param initVal The value every generation starts out with
 	 */
-	RetentiveObject(const Type& initVal)
+	RetentiveObject(const Type& initVal) :
+		arena(this->Generations, initVal)
 	{
-		// Create new objects for every generation that needs to be remembered
-		for (int n = 0; n <= AttentionSpan; n++)
-		{
-			data[n] = std::make_shared<Type>(initVal);
-		}
+		// Do nothing
 	}
 
 	/**
@@ -56,62 +50,92 @@ public:
 	 *
 	 * @param other The retentive object to copy from
 	 */
+	RetentiveObject(const RetentiveObject<Type, AttentionSpan>& other) = default;
+
+	/**
+	 * @brief Constructs a new retentive object that takes over the memory of an rvalue
+	 *
+	 * @param other The retentive object to take the data from. It is left empty
+	 */
+	RetentiveObject(RetentiveObject<Type, AttentionSpan>&& other) noexcept
+	{
+		Swap(other);
+	}
+
+	/**
+	 * @brief Copies the data of another object into this one
+	 *
+	 * @param other The retentive object to copy from
+	 */
 	RetentiveObject<Type, AttentionSpan>& operator=(const RetentiveObject<Type, AttentionSpan>& other)
 	{
-		for (int n = 0; n <= AttentionSpan; n++)
-		{
-			*data[n] = *other.data[n];
-		}
+		RetentiveObject<Type, AttentionSpan> copy(other);
+		Swap(copy);
 
 		return *this;
 	}
 
 	/**
-	 * @brief Constructs a new retentive object pointing to the data of an rvalue
+	 * @brief Takes over the memory of an rvalue
 	 *
-	 * @param other The retentive object to set its data to
+	 * @param other The retentive object to take the data from
 	 */
-	RetentiveObject<Type, AttentionSpan>& operator=(RetentiveObject<Type, AttentionSpan>&& other)
+	RetentiveObject<Type, AttentionSpan>& operator=(RetentiveObject<Type, AttentionSpan>&& other) noexcept
 	{
-		for (int n = 0; n <= AttentionSpan; n++)
-		{
-			data[n] = other.data[n];
-		}
+		Swap(other);
 
 		return *this;
 	}
 
 	/**
-	 * @brief Constructs a new retentive object with the data of another object
+	 * @brief Get the entity from `index` generations ago
 	 *
-	 * @param other The retentive object to copy from
+	 * @param index Amount of generations to go backwards in time
+	 * @return The entity from before `index` generations
 	 */
-	RetentiveObject(const RetentiveObject<Type, AttentionSpan>& other)
+	Type& operator[](size_t index)
 	{
-		*this = other;
+		return arena.Get()[this->Slot(index)];
 	}
 
 	/**
-	 * @brief Constructs a new retentive object pointing to the data of an rvalue
+	 * @brief Get the entity from `index` generations ago
 	 *
-	 * @param other The retentive object to set its data to
+	 * @param index Amount of generations to go backwards in time
+	 * @return The entity from before `index` generations
 	 */
-	RetentiveObject(RetentiveObject<Type, AttentionSpan>&& other)
+	const Type& operator[](size_t index) const
 	{
-		*this = other;
+		return arena.Get()[this->Slot(index)];
 	}
 
-private:
 	/**
-	 * @brief Swaps the objects in the array
+	 * @brief Get the most up-to-date entity
+	 *
+	 * @return The entity with generation 0
+	 */
+	Type& Current()
+	{
+		return (*this)[0];
+	}
+
+	/**
+	 * @brief Get the most up-to-date entity
+	 *
+	 * @return The entity with generation 0
 	 */
-	void CycleGenerations() override
+	const Type& Current() const
 	{
-		// Cycle the object contents, so that the previous "current" object is now the 2nd. 
-		// The 2nd becomes the 3rd etc, and the former last object becomes the new current
-		for (int n = 1; n <= AttentionSpan; n++)
-		{
-			std::swap(data[0], data[n]);
-		}
+		return (*this)[0];
 	}
+
+private:
+	void Swap(RetentiveObject<Type, AttentionSpan>& other) noexcept
+	{
+		this->SwapState(other);
+		std::swap(arena, other.arena);
+	}
+
+private:
+	RetentiveArena<Type> arena;
 };
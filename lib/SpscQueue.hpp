@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Bounded lock-free queue for exactly one producer and one consumer thread
+ *
+ * @tparam Capacity Number of slots, must be a power of two
+ */
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	SpscQueue() = default;
+
+	SpscQueue(const SpscQueue& other) = delete;
+	SpscQueue& operator=(const SpscQueue& other) = delete;
+
+	/**
+	 * @brief Adds an element. Called by the producer only.
+	 *
+	 * @returns false if the queue is full, in which case the element is dropped
+	 */
+	bool TryPush(const T& value)
+	{
+		size_t currentTail = tail.load(std::memory_order_relaxed);
+		if (currentTail - head.load(std::memory_order_acquire) == Capacity)
+			return false;
+
+		slots[currentTail & (Capacity - 1)] = value;
+		tail.store(currentTail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * @brief Removes the oldest element. Called by the consumer only.
+	 *
+	 * @returns false if the queue is empty
+	 */
+	bool TryPop(T& value)
+	{
+		size_t currentHead = head.load(std::memory_order_relaxed);
+		if (currentHead == tail.load(std::memory_order_acquire))
+			return false;
+
+		value = slots[currentHead & (Capacity - 1)];
+		head.store(currentHead + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	T slots[Capacity];
+
+	alignas(64) std::atomic<size_t> head{ 0 };
+	alignas(64) std::atomic<size_t> tail{ 0 };
+};
@@ -0,0 +1,101 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+#include "FloatingPoint.hpp"
+
+// How often an idle thread polls for new work before going to sleep.
+// Kernels are usually launched back to back, so this saves most wake-ups.
+#define SPIN_COUNT 4096
+
+ThreadPool::ThreadPool(int threadCount) :
+	threadCount(std::max(threadCount, 1))
+{
+	partialSums = std::vector<double>(this->threadCount * PARTIAL_SUM_STRIDE, 0.0);
+
+	for (int i = 1; i < this->threadCount; i++)
+		workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+void ThreadPool::Run(const std::function<void(int)>& task)
+{
+	if (threadCount == 1)
+	{
+		task(0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->task = &task;
+		floatingPointMode = GetFloatingPointMode();
+		pending.store(threadCount - 1, std::memory_order_relaxed);
+		generation.fetch_add(1, std::memory_order_release);
+	}
+	wake.notify_all();
+
+	task(0);
+
+	for (int spin = 0; spin < SPIN_COUNT && pending.load(std::memory_order_acquire) != 0; spin++)
+		std::this_thread::yield();
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return pending.load(std::memory_order_acquire) == 0; });
+}
+
+void ThreadPool::GetChunk(int begin, int end, int thread, int& chunkBegin, int& chunkEnd) const
+{
+	int count = std::max(end - begin, 0);
+	int base = count / threadCount;
+	int remainder = count % threadCount;
+
+	// The first `remainder` threads get one extra element
+	chunkBegin = begin + thread * base + std::min(thread, remainder);
+	chunkEnd = chunkBegin + base + (thread < remainder ? 1 : 0);
+}
+
+void ThreadPool::WorkerLoop(int index)
+{
+	uint64_t seen = 0;
+	while (true)
+	{
+		for (int spin = 0; spin < SPIN_COUNT && generation.load(std::memory_order_acquire) == seen; spin++)
+			std::this_thread::yield();
+
+		const std::function<void(int)>* current;
+		unsigned int mode;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&] { return stopping || generation.load(std::memory_order_acquire) != seen; });
+			if (stopping)
+				return;
+
+			seen = generation.load(std::memory_order_acquire);
+			current = task;
+			mode = floatingPointMode;
+		}
+
+		if (GetFloatingPointMode() != mode)
+			SetFloatingPointMode(mode);
+
+		(*current)(index);
+
+		if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done.notify_one();
+		}
+	}
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief A fixed set of worker threads that execute one task at a time.
+ *
+ * The workers are created once and kept alive for the lifetime of the pool,
+ * so launching a parallel loop only costs a wake-up instead of a thread creation.
+ * The calling thread takes part in every task as thread 0.
+ *
+ * Work is always split the same way for a given thread count, so every thread
+ * touches the same part of the data on every call. Together with the fixed
+ * order in which partial sums are combined, this makes results deterministic
+ * for a fixed thread count.
+ */
+class ThreadPool
+{
+public:
+	/**
+	 * @brief Creates a pool
+	 *
+	 * @param threadCount Total number of threads working on each task, including the caller
+	 */
+	ThreadPool(int threadCount);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+
+	int GetThreadCount() const { return threadCount; }
+
+	/**
+	 * @brief Runs `task(threadIndex)` once on every thread and waits for all of them
+	 *
+	 * The workers run the task with the caller's floating point mode, so e.g. flushing
+	 * denormals to zero applies to the whole task.
+	 */
+	void Run(const std::function<void(int)>& task);
+
+	/**
+	 * @brief Splits [begin, end) into one contiguous chunk per thread
+	 *
+	 * @param task Called as `task(chunkBegin, chunkEnd)` for every non-empty chunk
+	 */
+	template<typename Task>
+	void ParallelFor(int begin, int end, Task&& task)
+	{
+		Run([&](int thread)
+			{
+				int chunkBegin, chunkEnd;
+				GetChunk(begin, end, thread, chunkBegin, chunkEnd);
+				if (chunkBegin < chunkEnd)
+					task(chunkBegin, chunkEnd);
+			});
+	}
+
+	/**
+	 * @brief Like ParallelFor, but sums up the values returned by every chunk
+	 *
+	 * The partial sums are always added up in chunk order.
+	 */
+	template<typename Task>
+	double ParallelSum(int begin, int end, Task&& task)
+	{
+		Run([&](int thread)
+			{
+				int chunkBegin, chunkEnd;
+				GetChunk(begin, end, thread, chunkBegin, chunkEnd);
+				partialSums[thread * PARTIAL_SUM_STRIDE] = (chunkBegin < chunkEnd) ? task(chunkBegin, chunkEnd) : 0.0;
+			});
+
+		double sum = 0.0;
+		for (int thread = 0; thread < threadCount; thread++)
+			sum += partialSums[thread * PARTIAL_SUM_STRIDE];
+
+		return sum;
+	}
+
+	/**
+	 * @brief Like ParallelSum, but returns the largest value returned by any chunk
+	 *
+	 * @return The maximum, or `lowest` if the range is empty
+	 */
+	template<typename Task>
+	double ParallelMax(int begin, int end, double lowest, Task&& task)
+	{
+		Run([&](int thread)
+			{
+				int chunkBegin, chunkEnd;
+				GetChunk(begin, end, thread, chunkBegin, chunkEnd);
+				partialSums[thread * PARTIAL_SUM_STRIDE] = (chunkBegin < chunkEnd) ? task(chunkBegin, chunkEnd) : lowest;
+			});
+
+		double maximum = lowest;
+		for (int thread = 0; thread < threadCount; thread++)
+			maximum = std::max(maximum, partialSums[thread * PARTIAL_SUM_STRIDE]);
+
+		return maximum;
+	}
+
+	/**
+	 * @brief The part of [begin, end) that belongs to the given thread
+	 */
+	void GetChunk(int begin, int end, int thread, int& chunkBegin, int& chunkEnd) const;
+
+private:
+	void WorkerLoop(int index);
+
+private:
+	// Keep every partial sum on its own cache line
+	static constexpr int PARTIAL_SUM_STRIDE = 8;
+
+	int threadCount;
+	std::vector<std::thread> workers;
+	std::vector<double> partialSums;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	const std::function<void(int)>* task = nullptr;
+	unsigned int floatingPointMode = 0;
+	std::atomic<uint64_t> generation{ 0 };
+	std::atomic<int> pending{ 0 };
+	bool stopping = false;
+};
+
+/**
+ * @brief Runs a loop on the pool if there is one, or on the calling thread otherwise
+ */
+template<typename Task>
+void ParallelFor(ThreadPool* pool, int begin, int end, Task&& task)
+{
+	if (pool)
+		pool->ParallelFor(begin, end, task);
+	else if (begin < end)
+		task(begin, end);
+}
+
+/**
+ * @brief Runs a reduction on the pool if there is one, or on the calling thread otherwise
+ */
+template<typename Task>
+double ParallelSum(ThreadPool* pool, int begin, int end, Task&& task)
+{
+	if (pool)
+		return pool->ParallelSum(begin, end, task);
+
+	return (begin < end) ? task(begin, end) : 0.0;
+}
+
+/**
+ * @brief Runs a maximum reduction on the pool if there is one, or on the calling thread otherwise
+ */
+template<typename Task>
+double ParallelMax(ThreadPool* pool, int begin, int end, double lowest, Task&& task)
+{
+	if (pool)
+		return pool->ParallelMax(begin, end, lowest, task);
+
+	return (begin < end) ? task(begin, end) : lowest;
+}
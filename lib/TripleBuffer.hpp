@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Lock-free hand-over of complete values from one producer thread to one consumer thread
+ *
+ * There are three slots: the producer owns one, the consumer owns one, and the
+ * third one sits in between. Publishing swaps the producer's slot with the middle
+ * one, acquiring swaps the middle one with the consumer's slot if it holds
+ * something newer. Neither side ever waits for the other or copies a value, and
+ * the consumer always sees the most recently published value in one piece.
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() = default;
+
+	TripleBuffer(const TripleBuffer& other) = delete;
+	TripleBuffer& operator=(const TripleBuffer& other) = delete;
+
+	/**
+	 * @brief Sets all three slots to `value`. Must not be called while either thread is using the buffer.
+	 */
+	void Fill(const T& value)
+	{
+		for (T& buffer : buffers)
+			buffer = value;
+	}
+
+	/**
+	 * @brief The slot the producer may write to until the next Publish
+	 */
+	T& GetWriteBuffer() { return buffers[writeIndex]; }
+
+	/**
+	 * @brief Makes the write buffer available to the consumer and hands the producer a free slot
+	 */
+	void Publish()
+	{
+		uint8_t previous = middle.exchange(writeIndex | NEW_DATA, std::memory_order_acq_rel);
+		writeIndex = previous & INDEX_MASK;
+	}
+
+	/**
+	 * @brief Returns the most recently published value. It stays valid until the next call.
+	 */
+	const T& Acquire()
+	{
+		if (middle.load(std::memory_order_relaxed) & NEW_DATA)
+		{
+			uint8_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+			readIndex = previous & INDEX_MASK;
+		}
+
+		return buffers[readIndex];
+	}
+
+	/**
+	 * @brief Whether something was published since the consumer last acquired a value
+	 */
+	bool HasNewData() const { return (middle.load(std::memory_order_relaxed) & NEW_DATA) != 0; }
+
+private:
+	static constexpr uint8_t INDEX_MASK = 0x03;
+	static constexpr uint8_t NEW_DATA = 0x04;
+
+	T buffers[3];
+
+	// Each index lives on its own cache line, so the two threads don't keep invalidating each other
+	alignas(64) uint8_t writeIndex = 0;
+	alignas(64) std::atomic<uint8_t> middle{ 1 };
+	alignas(64) uint8_t readIndex = 2;
+};
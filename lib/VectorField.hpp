@@ -1,26 +1,31 @@
 #pragma once
 
-#include <vector>
-
-struct SDL_Rect;
-struct SDL_Renderer;
+#include "FieldMemory.hpp"
 
+/**
+ * A pair of scalar fields holding the horizontal and vertical components of a
+ * vector field. Instantiated for float and double.
+ */
+template<typename T>
 class VectorField
 {
 public:
 	VectorField();
 	VectorField(int width, int height);
-	VectorField(int width, int height, const std::vector<double>& hori, const std::vector<double>& vert);
+	VectorField(int width, int height, const FieldVector<T>& hori, const FieldVector<T>& vert);
 
-	void Draw(SDL_Renderer* renderer, const SDL_Rect& targetRect);
 	void RecalculateMagnitude();
 
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	T GetBiggestMagnitude() const { return biggestMagnitude; }
+
 public:
-	std::vector<double> horizontal;
-	std::vector<double> vertical;
+	FieldVector<T> horizontal;
+	FieldVector<T> vertical;
 
 private:
 	int width, height;
 
-	double biggestMagnitude = 0.0;
+	T biggestMagnitude = 0.0;
 };
\ No newline at end of file
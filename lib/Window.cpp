@@ -3,6 +3,8 @@
 #include <iostream>
 #include <SDL.h>
 
+#include "Profiler.hpp"
+
 void Window::Launch()
 {
 	SDL_ShowWindow(window);
@@ -110,9 +112,13 @@ Window::~Window()
 
 void Window::HandleEvents()
 {
+	PROFILE_SCOPE("HandleEvents");
+
 	SDL_Event event;
 	while (SDL_PollEvent(&event))
 	{
+		OnEvent(event);
+
 		switch (event.type)
 		{
 		case SDL_WINDOWEVENT:
@@ -130,6 +136,8 @@ void Window::HandleEvents()
 
 void Window::Update()
 {
+	PROFILE_SCOPE("Update");
+
 	double dt = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - startOfLastFrame).count();
 	startOfLastFrame = std::chrono::steady_clock::now();
 
@@ -138,6 +146,8 @@ void Window::Update()
 
 void Window::Render()
 {
+	PROFILE_SCOPE("Render");
+
 	SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
 	SDL_RenderClear(renderer);
 
@@ -5,6 +5,7 @@
 
 struct SDL_Renderer;
 struct SDL_Window;
+union SDL_Event;
 
 class Window
 {
@@ -18,6 +19,8 @@ protected:
 	~Window();
 
 
+	// Called on the window's thread for every event, before the window handles it itself
+	virtual void OnEvent(const SDL_Event& event) {}
 	virtual void OnUpdate(double dt) {}
 	virtual void OnRender(SDL_Renderer* renderer) {}
 
@@ -0,0 +1,129 @@
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+
+#include "FloatingPoint.hpp"
+
+// The pool a worker belongs to is kept with its index, a worker of one pool is an outside thread to any other
+static thread_local const WorkStealingPool* workerPool = nullptr;
+static thread_local int workerIndex = -1;
+
+WorkStealingPool::WorkStealingPool(int threadCount)
+{
+	threadCount = std::max(threadCount, 1);
+
+	for (int i = 0; i < threadCount; i++)
+		queues.push_back(std::make_unique<Queue>());
+
+	for (int i = 0; i < threadCount; i++)
+		workers.emplace_back(&WorkStealingPool::WorkerLoop, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	Wait();
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+}
+
+int WorkStealingPool::GetWorkerIndex()
+{
+	return workerIndex;
+}
+
+void WorkStealingPool::Submit(std::function<void()> task)
+{
+	int index = (workerPool == this) ? workerIndex : -1;
+	if (index < 0)
+		index = (int)(nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size());
+
+	pending.fetch_add(1, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->tasks.push_back({ std::move(task), GetFloatingPointMode() });
+	}
+
+	// Taking the lock orders this against a worker that just found nothing and is about to sleep
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.fetch_add(1, std::memory_order_release);
+	}
+	wake.notify_one();
+}
+
+void WorkStealingPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	done.wait(lock, [this] { return pending.load(std::memory_order_acquire) == 0; });
+}
+
+bool WorkStealingPool::TryPop(int index, Task& task)
+{
+	Queue& queue = *queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.tasks.empty())
+		return false;
+
+	task = std::move(queue.tasks.back());
+	queue.tasks.pop_back();
+	return true;
+}
+
+bool WorkStealingPool::TrySteal(int thief, Task& task)
+{
+	int count = (int)queues.size();
+	for (int offset = 1; offset < count; offset++)
+	{
+		Queue& queue = *queues[(thief + offset) % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.tasks.empty())
+			continue;
+
+		task = std::move(queue.tasks.front());
+		queue.tasks.pop_front();
+		steals.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	return false;
+}
+
+void WorkStealingPool::WorkerLoop(int index)
+{
+	workerPool = this;
+	workerIndex = index;
+
+	while (true)
+	{
+		Task task;
+		if (TryPop(index, task) || TrySteal(index, task))
+		{
+			queued.fetch_sub(1, std::memory_order_relaxed);
+
+			if (GetFloatingPointMode() != task.floatingPointMode)
+				SetFloatingPointMode(task.floatingPointMode);
+
+			task.function();
+
+			if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				done.notify_all();
+			}
+
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+		if (stopping)
+			return;
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Worker threads that run many independent tasks of uneven length
+ *
+ * ThreadPool splits one loop into equal chunks, which only balances if every
+ * element costs the same. Here every worker owns a queue instead. Tasks submitted
+ * from outside, including from the workers of other pools, are dealt out round-robin,
+ * tasks submitted by a worker go to its own queue. A worker runs the newest task of its own queue, and once that is empty
+ * steals the oldest task of another queue, so no thread sits idle while work is left.
+ *
+ * Tasks run with the floating point mode of the thread that submitted them.
+ */
+class WorkStealingPool
+{
+public:
+	/**
+	 * @brief Creates a pool
+	 *
+	 * @param threadCount Number of worker threads, the caller does not take part
+	 */
+	WorkStealingPool(int threadCount);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool& other) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool& other) = delete;
+
+	void Submit(std::function<void()> task);
+
+	/**
+	 * @brief Blocks until every submitted task has finished
+	 */
+	void Wait();
+
+	int GetThreadCount() const { return (int)workers.size(); }
+
+	// Index of the calling thread within the pool it works for, or -1 outside of any pool
+	static int GetWorkerIndex();
+
+	// Tasks that ran on another worker than the one they were queued on
+	long long GetStealCount() const { return steals.load(std::memory_order_relaxed); }
+
+private:
+	struct Task
+	{
+		std::function<void()> function;
+		unsigned int floatingPointMode;
+	};
+
+	// Each queue on its own cache lines, so workers working off their own queues don't contend
+	struct alignas(64) Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	bool TryPop(int index, Task& task);
+	bool TrySteal(int thief, Task& task);
+	void WorkerLoop(int index);
+
+private:
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	// Tasks waiting in any queue, and tasks not finished yet
+	std::atomic<int> queued{ 0 };
+	std::atomic<int> pending{ 0 };
+
+	std::atomic<unsigned int> nextQueue{ 0 };
+	std::atomic<long long> steals{ 0 };
+	bool stopping = false;
+};
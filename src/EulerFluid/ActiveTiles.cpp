@@ -0,0 +1,135 @@
+#include "ActiveTiles.hpp"
+
+#include <algorithm>
+
+#define IDX(x, y, w) ((y) * (w) + (x))
+
+ActiveTiles::ActiveTiles(int resolution) :
+	N(resolution), tilesPerSide((resolution + ACTIVE_TILE_SIZE - 1) / ACTIVE_TILE_SIZE)
+{
+	current.resize(tilesPerSide * tilesPerSide, 0);
+	marked.resize(tilesPerSide * tilesPerSide, 0);
+	scratch.resize(tilesPerSide * tilesPerSide, 0);
+	spanStart.resize(tilesPerSide + 1, 0);
+}
+
+void ActiveTiles::Mark(int tileX, int tileY)
+{
+	marked[IDX(tileX, tileY, tilesPerSide)] = 1;
+}
+
+void ActiveTiles::MarkCell(int x, int y)
+{
+	if (x < 1 || x > N || y < 1 || y > N)
+		return;
+
+	Mark((x - 1) / ACTIVE_TILE_SIZE, (y - 1) / ACTIVE_TILE_SIZE);
+}
+
+void ActiveTiles::Dilate(int halo)
+{
+	if (halo <= 0)
+		return;
+
+	// The square neighbourhood is separable, so rows and columns are widened one after the other
+	for (int ty = 0; ty < tilesPerSide; ty++)
+	{
+		for (int tx = 0; tx < tilesPerSide; tx++)
+		{
+			uint8_t any = 0;
+			for (int k = std::max(tx - halo, 0); k <= std::min(tx + halo, tilesPerSide - 1); k++)
+				any |= marked[IDX(k, ty, tilesPerSide)];
+
+			scratch[IDX(tx, ty, tilesPerSide)] = any;
+		}
+	}
+
+	for (int ty = 0; ty < tilesPerSide; ty++)
+	{
+		for (int tx = 0; tx < tilesPerSide; tx++)
+		{
+			uint8_t any = 0;
+			for (int k = std::max(ty - halo, 0); k <= std::min(ty + halo, tilesPerSide - 1); k++)
+				any |= scratch[IDX(tx, k, tilesPerSide)];
+
+			marked[IDX(tx, ty, tilesPerSide)] = any;
+		}
+	}
+}
+
+void ActiveTiles::Commit()
+{
+	active.clear();
+	released.clear();
+	inactive.clear();
+	spans.clear();
+	activeRows.clear();
+
+	for (int ty = 0; ty < tilesPerSide; ty++)
+	{
+		spanStart[ty] = (int)spans.size();
+
+		for (int tx = 0; tx < tilesPerSide; tx++)
+		{
+			int tile = IDX(tx, ty, tilesPerSide);
+			if (marked[tile])
+			{
+				active.push_back(GetTile(tx, ty));
+
+				// Extends the span of the tile to the left if there is one
+				if (tx > 0 && marked[tile - 1])
+					spans.back().columnEnd = active.back().columnEnd;
+				else
+					spans.push_back(active.back());
+			}
+			else
+			{
+				inactive.push_back(GetTile(tx, ty));
+				if (current[tile])
+					released.push_back(inactive.back());
+			}
+		}
+
+		if ((int)spans.size() > spanStart[ty])
+		{
+			const Tile& first = spans[spanStart[ty]];
+			for (int j = first.rowBegin; j < first.rowEnd; j++)
+				activeRows.push_back(j);
+		}
+	}
+
+	spanStart[tilesPerSide] = (int)spans.size();
+
+	current.swap(marked);
+	std::fill(marked.begin(), marked.end(), 0);
+}
+
+void ActiveTiles::ActivateAll()
+{
+	std::fill(marked.begin(), marked.end(), 1);
+	Commit();
+}
+
+double ActiveTiles::GetActiveFraction() const
+{
+	long long cells = 0;
+	for (const Tile& tile : active)
+		cells += (long long)(tile.columnEnd - tile.columnBegin) * (tile.rowEnd - tile.rowBegin);
+
+	return (N > 0) ? (double)cells / ((double)N * (double)N) : 0.0;
+}
+
+Tile ActiveTiles::GetTile(int tileX, int tileY) const
+{
+	Tile tile;
+	tile.x = tileX;
+	tile.y = tileY;
+
+	// The last tile of a row or column is cut off if N isn't a multiple of the tile size
+	tile.columnBegin = 1 + tileX * ACTIVE_TILE_SIZE;
+	tile.columnEnd = std::min(tile.columnBegin + ACTIVE_TILE_SIZE, N + 1);
+	tile.rowBegin = 1 + tileY * ACTIVE_TILE_SIZE;
+	tile.rowEnd = std::min(tile.rowBegin + ACTIVE_TILE_SIZE, N + 1);
+
+	return tile;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Edge length of a tile in cells
+#define ACTIVE_TILE_SIZE 32
+
+// A tile and the interior cells it covers, as half-open ranges
+struct Tile
+{
+	int x, y;
+	int columnBegin, columnEnd;
+	int rowBegin, rowEnd;
+};
+
+/**
+ * Activity map of the interior of an N x N grid, split into square tiles.
+ *
+ * Tiles are marked while a step is prepared, and the marks only take effect
+ * with Commit. Commit also lists the tiles that were active before and are not
+ * marked anymore, so the caller can clear their cells. The active tiles are
+ * kept in row-major order.
+ *
+ * For the kernels, neighbouring active tiles of a tile row are merged into
+ * spans, so a fully active grid is swept in whole rows like a dense one.
+ */
+class ActiveTiles
+{
+public:
+	ActiveTiles(int resolution);
+
+	void Mark(int tileX, int tileY);
+	void MarkCell(int x, int y);
+
+	// Additionally marks every tile within `halo` tiles of a marked one
+	void Dilate(int halo);
+
+	void Commit();
+
+	// Makes every tile active. Tiles that aren't marked before the next Commit get released by it.
+	void ActivateAll();
+
+	int GetTilesPerSide() const { return tilesPerSide; }
+	const std::vector<Tile>& GetActive() const { return active; }
+	const std::vector<Tile>& GetReleased() const { return released; }
+	const std::vector<Tile>& GetInactive() const { return inactive; }
+
+	// Cell rows that cross at least one active tile, in increasing order
+	const std::vector<int>& GetActiveRows() const { return activeRows; }
+
+	// Calls visit(columnBegin, columnEnd) for every span of active cells in row j
+	template<typename Visitor>
+	void ForEachSpan(int j, Visitor&& visit) const
+	{
+		int tileY = (j - 1) / ACTIVE_TILE_SIZE;
+		for (int s = spanStart[tileY]; s < spanStart[tileY + 1]; s++)
+			visit(spans[s].columnBegin, spans[s].columnEnd);
+	}
+
+	// Share of the interior covered by active tiles
+	double GetActiveFraction() const;
+
+private:
+	Tile GetTile(int tileX, int tileY) const;
+
+private:
+	int N;
+	int tilesPerSide;
+
+	std::vector<uint8_t> current;
+	std::vector<uint8_t> marked;
+	std::vector<uint8_t> scratch;
+
+	std::vector<Tile> active;
+	std::vector<Tile> released;
+	std::vector<Tile> inactive;
+
+	std::vector<Tile> spans;
+	std::vector<int> spanStart;
+	std::vector<int> activeRows;
+};
@@ -0,0 +1,312 @@
+#include "AdvectionKernels.hpp"
+
+// This file is compiled with AVX2 enabled. It must not be called unless
+// ResolveAdvectionKernel confirmed that the CPU supports it.
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+void AdvectRowsAVX2(const AdvectionJob<double>& job, int rowBegin, int rowEnd)
+{
+	int N = job.N;
+	int size = job.size;
+
+	const __m256d dt0 = _mm256_set1_pd(job.dt0);
+	const __m256d lower = _mm256_set1_pd(0.5);
+	const __m256d upper = _mm256_set1_pd((double)N + 0.5);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d period = _mm256_set1_pd((double)N);
+	const bool periodic = job.periodic;
+	const __m256d laneOffsets = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+	const __m128i rowStride = _mm_set1_epi32(size);
+	const __m128i nextColumn = _mm_set1_epi32(1);
+
+	for (int j = rowBegin; j < rowEnd; j++)
+	{
+		const __m256d row = _mm256_set1_pd((double)j);
+
+		int i = job.columnBegin;
+		for (; i + 3 < job.columnEnd; i += 4)
+		{
+			int cell = j * size + i;
+			__m256d column = _mm256_add_pd(_mm256_set1_pd((double)i), laneOffsets);
+
+			// Same operations as AdvectCell, four cells at a time
+			__m256d x = _mm256_sub_pd(column, _mm256_mul_pd(dt0, _mm256_loadu_pd(job.u + cell)));
+			__m256d y = _mm256_sub_pd(row, _mm256_mul_pd(dt0, _mm256_loadu_pd(job.v + cell)));
+
+			if (periodic)
+			{
+				x = _mm256_sub_pd(x, _mm256_mul_pd(period, _mm256_floor_pd(_mm256_div_pd(_mm256_sub_pd(x, lower), period))));
+				y = _mm256_sub_pd(y, _mm256_mul_pd(period, _mm256_floor_pd(_mm256_div_pd(_mm256_sub_pd(y, lower), period))));
+			}
+
+			x = _mm256_min_pd(_mm256_max_pd(x, lower), upper);
+			y = _mm256_min_pd(_mm256_max_pd(y, lower), upper);
+
+			// Both coordinates are positive after clamping, so truncation is the floor
+			__m128i i0 = _mm256_cvttpd_epi32(x);
+			__m128i j0 = _mm256_cvttpd_epi32(y);
+
+			__m256d s1 = _mm256_sub_pd(x, _mm256_cvtepi32_pd(i0));
+			__m256d s0 = _mm256_sub_pd(one, s1);
+			__m256d t1 = _mm256_sub_pd(y, _mm256_cvtepi32_pd(j0));
+			__m256d t0 = _mm256_sub_pd(one, t1);
+
+			__m128i index00 = _mm_add_epi32(_mm_mullo_epi32(j0, rowStride), i0);
+			__m128i index01 = _mm_add_epi32(index00, rowStride);
+			__m128i index10 = _mm_add_epi32(index00, nextColumn);
+			__m128i index11 = _mm_add_epi32(index01, nextColumn);
+
+			for (int c = 0; c < job.channels; c++)
+			{
+				const double* src = job.source[c];
+
+				__m256d value00 = _mm256_i32gather_pd(src, index00, 8);
+				__m256d value01 = _mm256_i32gather_pd(src, index01, 8);
+				__m256d value10 = _mm256_i32gather_pd(src, index10, 8);
+				__m256d value11 = _mm256_i32gather_pd(src, index11, 8);
+
+				__m256d left = _mm256_add_pd(_mm256_mul_pd(t0, value00), _mm256_mul_pd(t1, value01));
+				__m256d right = _mm256_add_pd(_mm256_mul_pd(t0, value10), _mm256_mul_pd(t1, value11));
+
+				_mm256_storeu_pd(job.target[c] + cell, _mm256_add_pd(_mm256_mul_pd(s0, left), _mm256_mul_pd(s1, right)));
+			}
+		}
+
+		for (; i < job.columnEnd; i++)
+			AdvectCell(job, i, j);
+	}
+}
+
+void AdvectRowsAVX2(const AdvectionJob<float>& job, int rowBegin, int rowEnd)
+{
+	int N = job.N;
+	int size = job.size;
+
+	const __m256 dt0 = _mm256_set1_ps(job.dt0);
+	const __m256 lower = _mm256_set1_ps(0.5f);
+	const __m256 upper = _mm256_set1_ps((float)N + 0.5f);
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 period = _mm256_set1_ps((float)N);
+	const bool periodic = job.periodic;
+	const __m256 laneOffsets = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+	const __m256i rowStride = _mm256_set1_epi32(size);
+	const __m256i nextColumn = _mm256_set1_epi32(1);
+
+	for (int j = rowBegin; j < rowEnd; j++)
+	{
+		const __m256 row = _mm256_set1_ps((float)j);
+
+		int i = job.columnBegin;
+		for (; i + 7 < job.columnEnd; i += 8)
+		{
+			int cell = j * size + i;
+			__m256 column = _mm256_add_ps(_mm256_set1_ps((float)i), laneOffsets);
+
+			// Same operations as AdvectCell, eight cells at a time
+			__m256 x = _mm256_sub_ps(column, _mm256_mul_ps(dt0, _mm256_loadu_ps(job.u + cell)));
+			__m256 y = _mm256_sub_ps(row, _mm256_mul_ps(dt0, _mm256_loadu_ps(job.v + cell)));
+
+			if (periodic)
+			{
+				x = _mm256_sub_ps(x, _mm256_mul_ps(period, _mm256_floor_ps(_mm256_div_ps(_mm256_sub_ps(x, lower), period))));
+				y = _mm256_sub_ps(y, _mm256_mul_ps(period, _mm256_floor_ps(_mm256_div_ps(_mm256_sub_ps(y, lower), period))));
+			}
+
+			x = _mm256_min_ps(_mm256_max_ps(x, lower), upper);
+			y = _mm256_min_ps(_mm256_max_ps(y, lower), upper);
+
+			__m256i i0 = _mm256_cvttps_epi32(x);
+			__m256i j0 = _mm256_cvttps_epi32(y);
+
+			__m256 s1 = _mm256_sub_ps(x, _mm256_cvtepi32_ps(i0));
+			__m256 s0 = _mm256_sub_ps(one, s1);
+			__m256 t1 = _mm256_sub_ps(y, _mm256_cvtepi32_ps(j0));
+			__m256 t0 = _mm256_sub_ps(one, t1);
+
+			__m256i index00 = _mm256_add_epi32(_mm256_mullo_epi32(j0, rowStride), i0);
+			__m256i index01 = _mm256_add_epi32(index00, rowStride);
+			__m256i index10 = _mm256_add_epi32(index00, nextColumn);
+			__m256i index11 = _mm256_add_epi32(index01, nextColumn);
+
+			for (int c = 0; c < job.channels; c++)
+			{
+				const float* src = job.source[c];
+
+				__m256 value00 = _mm256_i32gather_ps(src, index00, 4);
+				__m256 value01 = _mm256_i32gather_ps(src, index01, 4);
+				__m256 value10 = _mm256_i32gather_ps(src, index10, 4);
+				__m256 value11 = _mm256_i32gather_ps(src, index11, 4);
+
+				__m256 left = _mm256_add_ps(_mm256_mul_ps(t0, value00), _mm256_mul_ps(t1, value01));
+				__m256 right = _mm256_add_ps(_mm256_mul_ps(t0, value10), _mm256_mul_ps(t1, value11));
+
+				_mm256_storeu_ps(job.target[c] + cell, _mm256_add_ps(_mm256_mul_ps(s0, left), _mm256_mul_ps(s1, right)));
+			}
+		}
+
+		for (; i < job.columnEnd; i++)
+			AdvectCell(job, i, j);
+	}
+}
+
+// ConfineTracer for four particles
+static inline __m256d Confine(__m256d position, __m256d lower, __m256d upper, __m256d period, bool periodic)
+{
+	if (periodic)
+		position = _mm256_sub_pd(position, _mm256_mul_pd(period, _mm256_floor_pd(_mm256_div_pd(_mm256_sub_pd(position, lower), period))));
+
+	return _mm256_min_pd(_mm256_max_pd(position, lower), upper);
+}
+
+// SampleTracerVelocity for four particles
+static inline void Sample(const TracerJob<double>& job, __m256d x, __m256d y, __m256d& u, __m256d& v)
+{
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m128i rowStride = _mm_set1_epi32(job.size);
+	const __m128i nextColumn = _mm_set1_epi32(1);
+
+	__m128i i0 = _mm256_cvttpd_epi32(x);
+	__m128i j0 = _mm256_cvttpd_epi32(y);
+
+	__m256d s1 = _mm256_sub_pd(x, _mm256_cvtepi32_pd(i0));
+	__m256d s0 = _mm256_sub_pd(one, s1);
+	__m256d t1 = _mm256_sub_pd(y, _mm256_cvtepi32_pd(j0));
+	__m256d t0 = _mm256_sub_pd(one, t1);
+
+	__m128i index00 = _mm_add_epi32(_mm_mullo_epi32(j0, rowStride), i0);
+	__m128i index01 = _mm_add_epi32(index00, rowStride);
+	__m128i index10 = _mm_add_epi32(index00, nextColumn);
+	__m128i index11 = _mm_add_epi32(index01, nextColumn);
+
+	__m256d left = _mm256_add_pd(_mm256_mul_pd(t0, _mm256_i32gather_pd(job.u, index00, 8)), _mm256_mul_pd(t1, _mm256_i32gather_pd(job.u, index01, 8)));
+	__m256d right = _mm256_add_pd(_mm256_mul_pd(t0, _mm256_i32gather_pd(job.u, index10, 8)), _mm256_mul_pd(t1, _mm256_i32gather_pd(job.u, index11, 8)));
+	u = _mm256_add_pd(_mm256_mul_pd(s0, left), _mm256_mul_pd(s1, right));
+
+	left = _mm256_add_pd(_mm256_mul_pd(t0, _mm256_i32gather_pd(job.v, index00, 8)), _mm256_mul_pd(t1, _mm256_i32gather_pd(job.v, index01, 8)));
+	right = _mm256_add_pd(_mm256_mul_pd(t0, _mm256_i32gather_pd(job.v, index10, 8)), _mm256_mul_pd(t1, _mm256_i32gather_pd(job.v, index11, 8)));
+	v = _mm256_add_pd(_mm256_mul_pd(s0, left), _mm256_mul_pd(s1, right));
+}
+
+void AdvectTracersAVX2(const TracerJob<double>& job, int begin, int end)
+{
+	const __m256d dt0 = _mm256_set1_pd(job.dt0);
+	const __m256d halfDt0 = _mm256_set1_pd(job.halfDt0);
+	const __m256d lower = _mm256_set1_pd(0.5);
+	const __m256d upper = _mm256_set1_pd((double)job.N + 0.5);
+	const __m256d period = _mm256_set1_pd((double)job.N);
+	const bool periodic = job.periodic;
+
+	int particle = begin;
+	for (; particle + 3 < end; particle += 4)
+	{
+		// Same operations as AdvectTracer, four particles at a time
+		__m256d x = _mm256_loadu_pd(job.x + particle);
+		__m256d y = _mm256_loadu_pd(job.y + particle);
+		__m256d u, v;
+
+		Sample(job, x, y, u, v);
+		__m256d midX = Confine(_mm256_add_pd(x, _mm256_mul_pd(halfDt0, u)), lower, upper, period, periodic);
+		__m256d midY = Confine(_mm256_add_pd(y, _mm256_mul_pd(halfDt0, v)), lower, upper, period, periodic);
+
+		Sample(job, midX, midY, u, v);
+		_mm256_storeu_pd(job.x + particle, Confine(_mm256_add_pd(x, _mm256_mul_pd(dt0, u)), lower, upper, period, periodic));
+		_mm256_storeu_pd(job.y + particle, Confine(_mm256_add_pd(y, _mm256_mul_pd(dt0, v)), lower, upper, period, periodic));
+	}
+
+	for (; particle < end; particle++)
+		AdvectTracer(job, particle);
+}
+
+// ConfineTracer for eight particles
+static inline __m256 Confine(__m256 position, __m256 lower, __m256 upper, __m256 period, bool periodic)
+{
+	if (periodic)
+		position = _mm256_sub_ps(position, _mm256_mul_ps(period, _mm256_floor_ps(_mm256_div_ps(_mm256_sub_ps(position, lower), period))));
+
+	return _mm256_min_ps(_mm256_max_ps(position, lower), upper);
+}
+
+// SampleTracerVelocity for eight particles
+static inline void Sample(const TracerJob<float>& job, __m256 x, __m256 y, __m256& u, __m256& v)
+{
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256i rowStride = _mm256_set1_epi32(job.size);
+	const __m256i nextColumn = _mm256_set1_epi32(1);
+
+	__m256i i0 = _mm256_cvttps_epi32(x);
+	__m256i j0 = _mm256_cvttps_epi32(y);
+
+	__m256 s1 = _mm256_sub_ps(x, _mm256_cvtepi32_ps(i0));
+	__m256 s0 = _mm256_sub_ps(one, s1);
+	__m256 t1 = _mm256_sub_ps(y, _mm256_cvtepi32_ps(j0));
+	__m256 t0 = _mm256_sub_ps(one, t1);
+
+	__m256i index00 = _mm256_add_epi32(_mm256_mullo_epi32(j0, rowStride), i0);
+	__m256i index01 = _mm256_add_epi32(index00, rowStride);
+	__m256i index10 = _mm256_add_epi32(index00, nextColumn);
+	__m256i index11 = _mm256_add_epi32(index01, nextColumn);
+
+	__m256 left = _mm256_add_ps(_mm256_mul_ps(t0, _mm256_i32gather_ps(job.u, index00, 4)), _mm256_mul_ps(t1, _mm256_i32gather_ps(job.u, index01, 4)));
+	__m256 right = _mm256_add_ps(_mm256_mul_ps(t0, _mm256_i32gather_ps(job.u, index10, 4)), _mm256_mul_ps(t1, _mm256_i32gather_ps(job.u, index11, 4)));
+	u = _mm256_add_ps(_mm256_mul_ps(s0, left), _mm256_mul_ps(s1, right));
+
+	left = _mm256_add_ps(_mm256_mul_ps(t0, _mm256_i32gather_ps(job.v, index00, 4)), _mm256_mul_ps(t1, _mm256_i32gather_ps(job.v, index01, 4)));
+	right = _mm256_add_ps(_mm256_mul_ps(t0, _mm256_i32gather_ps(job.v, index10, 4)), _mm256_mul_ps(t1, _mm256_i32gather_ps(job.v, index11, 4)));
+	v = _mm256_add_ps(_mm256_mul_ps(s0, left), _mm256_mul_ps(s1, right));
+}
+
+void AdvectTracersAVX2(const TracerJob<float>& job, int begin, int end)
+{
+	const __m256 dt0 = _mm256_set1_ps(job.dt0);
+	const __m256 halfDt0 = _mm256_set1_ps(job.halfDt0);
+	const __m256 lower = _mm256_set1_ps(0.5f);
+	const __m256 upper = _mm256_set1_ps((float)job.N + 0.5f);
+	const __m256 period = _mm256_set1_ps((float)job.N);
+	const bool periodic = job.periodic;
+
+	int particle = begin;
+	for (; particle + 7 < end; particle += 8)
+	{
+		// Same operations as AdvectTracer, eight particles at a time
+		__m256 x = _mm256_loadu_ps(job.x + particle);
+		__m256 y = _mm256_loadu_ps(job.y + particle);
+		__m256 u, v;
+
+		Sample(job, x, y, u, v);
+		__m256 midX = Confine(_mm256_add_ps(x, _mm256_mul_ps(halfDt0, u)), lower, upper, period, periodic);
+		__m256 midY = Confine(_mm256_add_ps(y, _mm256_mul_ps(halfDt0, v)), lower, upper, period, periodic);
+
+		Sample(job, midX, midY, u, v);
+		_mm256_storeu_ps(job.x + particle, Confine(_mm256_add_ps(x, _mm256_mul_ps(dt0, u)), lower, upper, period, periodic));
+		_mm256_storeu_ps(job.y + particle, Confine(_mm256_add_ps(y, _mm256_mul_ps(dt0, v)), lower, upper, period, periodic));
+	}
+
+	for (; particle < end; particle++)
+		AdvectTracer(job, particle);
+}
+
+#else
+
+void AdvectRowsAVX2(const AdvectionJob<double>& job, int rowBegin, int rowEnd)
+{
+	AdvectRowsScalar(job, rowBegin, rowEnd);
+}
+
+void AdvectRowsAVX2(const AdvectionJob<float>& job, int rowBegin, int rowEnd)
+{
+	AdvectRowsScalar(job, rowBegin, rowEnd);
+}
+
+void AdvectTracersAVX2(const TracerJob<double>& job, int begin, int end)
+{
+	AdvectTracersScalar(job, begin, end);
+}
+
+void AdvectTracersAVX2(const TracerJob<float>& job, int begin, int end)
+{
+	AdvectTracersScalar(job, begin, end);
+}
+
+#endif
@@ -0,0 +1,312 @@
+#include "AdvectionKernels.hpp"
+
+// This file is compiled with AVX-512 enabled. It must not be called unless
+// ResolveAdvectionKernel confirmed that the CPU supports it.
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+
+void AdvectRowsAVX512(const AdvectionJob<double>& job, int rowBegin, int rowEnd)
+{
+	int N = job.N;
+	int size = job.size;
+
+	const __m512d dt0 = _mm512_set1_pd(job.dt0);
+	const __m512d lower = _mm512_set1_pd(0.5);
+	const __m512d upper = _mm512_set1_pd((double)N + 0.5);
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d period = _mm512_set1_pd((double)N);
+	const bool periodic = job.periodic;
+	const __m512d laneOffsets = _mm512_set_pd(7.0, 6.0, 5.0, 4.0, 3.0, 2.0, 1.0, 0.0);
+	const __m256i rowStride = _mm256_set1_epi32(size);
+	const __m256i nextColumn = _mm256_set1_epi32(1);
+
+	for (int j = rowBegin; j < rowEnd; j++)
+	{
+		const __m512d row = _mm512_set1_pd((double)j);
+
+		int i = job.columnBegin;
+		for (; i + 7 < job.columnEnd; i += 8)
+		{
+			int cell = j * size + i;
+			__m512d column = _mm512_add_pd(_mm512_set1_pd((double)i), laneOffsets);
+
+			// Same operations as AdvectCell, eight cells at a time
+			__m512d x = _mm512_sub_pd(column, _mm512_mul_pd(dt0, _mm512_loadu_pd(job.u + cell)));
+			__m512d y = _mm512_sub_pd(row, _mm512_mul_pd(dt0, _mm512_loadu_pd(job.v + cell)));
+
+			if (periodic)
+			{
+				x = _mm512_sub_pd(x, _mm512_mul_pd(period, _mm512_roundscale_pd(_mm512_div_pd(_mm512_sub_pd(x, lower), period), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)));
+				y = _mm512_sub_pd(y, _mm512_mul_pd(period, _mm512_roundscale_pd(_mm512_div_pd(_mm512_sub_pd(y, lower), period), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)));
+			}
+
+			x = _mm512_min_pd(_mm512_max_pd(x, lower), upper);
+			y = _mm512_min_pd(_mm512_max_pd(y, lower), upper);
+
+			// Both coordinates are positive after clamping, so truncation is the floor
+			__m256i i0 = _mm512_cvttpd_epi32(x);
+			__m256i j0 = _mm512_cvttpd_epi32(y);
+
+			__m512d s1 = _mm512_sub_pd(x, _mm512_cvtepi32_pd(i0));
+			__m512d s0 = _mm512_sub_pd(one, s1);
+			__m512d t1 = _mm512_sub_pd(y, _mm512_cvtepi32_pd(j0));
+			__m512d t0 = _mm512_sub_pd(one, t1);
+
+			__m256i index00 = _mm256_add_epi32(_mm256_mullo_epi32(j0, rowStride), i0);
+			__m256i index01 = _mm256_add_epi32(index00, rowStride);
+			__m256i index10 = _mm256_add_epi32(index00, nextColumn);
+			__m256i index11 = _mm256_add_epi32(index01, nextColumn);
+
+			for (int c = 0; c < job.channels; c++)
+			{
+				const double* src = job.source[c];
+
+				__m512d value00 = _mm512_i32gather_pd(index00, src, 8);
+				__m512d value01 = _mm512_i32gather_pd(index01, src, 8);
+				__m512d value10 = _mm512_i32gather_pd(index10, src, 8);
+				__m512d value11 = _mm512_i32gather_pd(index11, src, 8);
+
+				__m512d left = _mm512_add_pd(_mm512_mul_pd(t0, value00), _mm512_mul_pd(t1, value01));
+				__m512d right = _mm512_add_pd(_mm512_mul_pd(t0, value10), _mm512_mul_pd(t1, value11));
+
+				_mm512_storeu_pd(job.target[c] + cell, _mm512_add_pd(_mm512_mul_pd(s0, left), _mm512_mul_pd(s1, right)));
+			}
+		}
+
+		for (; i < job.columnEnd; i++)
+			AdvectCell(job, i, j);
+	}
+}
+
+void AdvectRowsAVX512(const AdvectionJob<float>& job, int rowBegin, int rowEnd)
+{
+	int N = job.N;
+	int size = job.size;
+
+	const __m512 dt0 = _mm512_set1_ps(job.dt0);
+	const __m512 lower = _mm512_set1_ps(0.5f);
+	const __m512 upper = _mm512_set1_ps((float)N + 0.5f);
+	const __m512 one = _mm512_set1_ps(1.0f);
+	const __m512 period = _mm512_set1_ps((float)N);
+	const bool periodic = job.periodic;
+	const __m512 laneOffsets = _mm512_set_ps(15.0f, 14.0f, 13.0f, 12.0f, 11.0f, 10.0f, 9.0f, 8.0f, 7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+	const __m512i rowStride = _mm512_set1_epi32(size);
+	const __m512i nextColumn = _mm512_set1_epi32(1);
+
+	for (int j = rowBegin; j < rowEnd; j++)
+	{
+		const __m512 row = _mm512_set1_ps((float)j);
+
+		int i = job.columnBegin;
+		for (; i + 15 < job.columnEnd; i += 16)
+		{
+			int cell = j * size + i;
+			__m512 column = _mm512_add_ps(_mm512_set1_ps((float)i), laneOffsets);
+
+			// Same operations as AdvectCell, sixteen cells at a time
+			__m512 x = _mm512_sub_ps(column, _mm512_mul_ps(dt0, _mm512_loadu_ps(job.u + cell)));
+			__m512 y = _mm512_sub_ps(row, _mm512_mul_ps(dt0, _mm512_loadu_ps(job.v + cell)));
+
+			if (periodic)
+			{
+				x = _mm512_sub_ps(x, _mm512_mul_ps(period, _mm512_roundscale_ps(_mm512_div_ps(_mm512_sub_ps(x, lower), period), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)));
+				y = _mm512_sub_ps(y, _mm512_mul_ps(period, _mm512_roundscale_ps(_mm512_div_ps(_mm512_sub_ps(y, lower), period), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)));
+			}
+
+			x = _mm512_min_ps(_mm512_max_ps(x, lower), upper);
+			y = _mm512_min_ps(_mm512_max_ps(y, lower), upper);
+
+			__m512i i0 = _mm512_cvttps_epi32(x);
+			__m512i j0 = _mm512_cvttps_epi32(y);
+
+			__m512 s1 = _mm512_sub_ps(x, _mm512_cvtepi32_ps(i0));
+			__m512 s0 = _mm512_sub_ps(one, s1);
+			__m512 t1 = _mm512_sub_ps(y, _mm512_cvtepi32_ps(j0));
+			__m512 t0 = _mm512_sub_ps(one, t1);
+
+			__m512i index00 = _mm512_add_epi32(_mm512_mullo_epi32(j0, rowStride), i0);
+			__m512i index01 = _mm512_add_epi32(index00, rowStride);
+			__m512i index10 = _mm512_add_epi32(index00, nextColumn);
+			__m512i index11 = _mm512_add_epi32(index01, nextColumn);
+
+			for (int c = 0; c < job.channels; c++)
+			{
+				const float* src = job.source[c];
+
+				__m512 value00 = _mm512_i32gather_ps(index00, src, 4);
+				__m512 value01 = _mm512_i32gather_ps(index01, src, 4);
+				__m512 value10 = _mm512_i32gather_ps(index10, src, 4);
+				__m512 value11 = _mm512_i32gather_ps(index11, src, 4);
+
+				__m512 left = _mm512_add_ps(_mm512_mul_ps(t0, value00), _mm512_mul_ps(t1, value01));
+				__m512 right = _mm512_add_ps(_mm512_mul_ps(t0, value10), _mm512_mul_ps(t1, value11));
+
+				_mm512_storeu_ps(job.target[c] + cell, _mm512_add_ps(_mm512_mul_ps(s0, left), _mm512_mul_ps(s1, right)));
+			}
+		}
+
+		for (; i < job.columnEnd; i++)
+			AdvectCell(job, i, j);
+	}
+}
+
+// ConfineTracer for eight particles
+static inline __m512d Confine(__m512d position, __m512d lower, __m512d upper, __m512d period, bool periodic)
+{
+	if (periodic)
+		position = _mm512_sub_pd(position, _mm512_mul_pd(period, _mm512_roundscale_pd(_mm512_div_pd(_mm512_sub_pd(position, lower), period), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)));
+
+	return _mm512_min_pd(_mm512_max_pd(position, lower), upper);
+}
+
+// SampleTracerVelocity for eight particles
+static inline void Sample(const TracerJob<double>& job, __m512d x, __m512d y, __m512d& u, __m512d& v)
+{
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m256i rowStride = _mm256_set1_epi32(job.size);
+	const __m256i nextColumn = _mm256_set1_epi32(1);
+
+	__m256i i0 = _mm512_cvttpd_epi32(x);
+	__m256i j0 = _mm512_cvttpd_epi32(y);
+
+	__m512d s1 = _mm512_sub_pd(x, _mm512_cvtepi32_pd(i0));
+	__m512d s0 = _mm512_sub_pd(one, s1);
+	__m512d t1 = _mm512_sub_pd(y, _mm512_cvtepi32_pd(j0));
+	__m512d t0 = _mm512_sub_pd(one, t1);
+
+	__m256i index00 = _mm256_add_epi32(_mm256_mullo_epi32(j0, rowStride), i0);
+	__m256i index01 = _mm256_add_epi32(index00, rowStride);
+	__m256i index10 = _mm256_add_epi32(index00, nextColumn);
+	__m256i index11 = _mm256_add_epi32(index01, nextColumn);
+
+	__m512d left = _mm512_add_pd(_mm512_mul_pd(t0, _mm512_i32gather_pd(index00, job.u, 8)), _mm512_mul_pd(t1, _mm512_i32gather_pd(index01, job.u, 8)));
+	__m512d right = _mm512_add_pd(_mm512_mul_pd(t0, _mm512_i32gather_pd(index10, job.u, 8)), _mm512_mul_pd(t1, _mm512_i32gather_pd(index11, job.u, 8)));
+	u = _mm512_add_pd(_mm512_mul_pd(s0, left), _mm512_mul_pd(s1, right));
+
+	left = _mm512_add_pd(_mm512_mul_pd(t0, _mm512_i32gather_pd(index00, job.v, 8)), _mm512_mul_pd(t1, _mm512_i32gather_pd(index01, job.v, 8)));
+	right = _mm512_add_pd(_mm512_mul_pd(t0, _mm512_i32gather_pd(index10, job.v, 8)), _mm512_mul_pd(t1, _mm512_i32gather_pd(index11, job.v, 8)));
+	v = _mm512_add_pd(_mm512_mul_pd(s0, left), _mm512_mul_pd(s1, right));
+}
+
+void AdvectTracersAVX512(const TracerJob<double>& job, int begin, int end)
+{
+	const __m512d dt0 = _mm512_set1_pd(job.dt0);
+	const __m512d halfDt0 = _mm512_set1_pd(job.halfDt0);
+	const __m512d lower = _mm512_set1_pd(0.5);
+	const __m512d upper = _mm512_set1_pd((double)job.N + 0.5);
+	const __m512d period = _mm512_set1_pd((double)job.N);
+	const bool periodic = job.periodic;
+
+	int particle = begin;
+	for (; particle + 7 < end; particle += 8)
+	{
+		// Same operations as AdvectTracer, eight particles at a time
+		__m512d x = _mm512_loadu_pd(job.x + particle);
+		__m512d y = _mm512_loadu_pd(job.y + particle);
+		__m512d u, v;
+
+		Sample(job, x, y, u, v);
+		__m512d midX = Confine(_mm512_add_pd(x, _mm512_mul_pd(halfDt0, u)), lower, upper, period, periodic);
+		__m512d midY = Confine(_mm512_add_pd(y, _mm512_mul_pd(halfDt0, v)), lower, upper, period, periodic);
+
+		Sample(job, midX, midY, u, v);
+		_mm512_storeu_pd(job.x + particle, Confine(_mm512_add_pd(x, _mm512_mul_pd(dt0, u)), lower, upper, period, periodic));
+		_mm512_storeu_pd(job.y + particle, Confine(_mm512_add_pd(y, _mm512_mul_pd(dt0, v)), lower, upper, period, periodic));
+	}
+
+	for (; particle < end; particle++)
+		AdvectTracer(job, particle);
+}
+
+// ConfineTracer for sixteen particles
+static inline __m512 Confine(__m512 position, __m512 lower, __m512 upper, __m512 period, bool periodic)
+{
+	if (periodic)
+		position = _mm512_sub_ps(position, _mm512_mul_ps(period, _mm512_roundscale_ps(_mm512_div_ps(_mm512_sub_ps(position, lower), period), _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC)));
+
+	return _mm512_min_ps(_mm512_max_ps(position, lower), upper);
+}
+
+// SampleTracerVelocity for sixteen particles
+static inline void Sample(const TracerJob<float>& job, __m512 x, __m512 y, __m512& u, __m512& v)
+{
+	const __m512 one = _mm512_set1_ps(1.0f);
+	const __m512i rowStride = _mm512_set1_epi32(job.size);
+	const __m512i nextColumn = _mm512_set1_epi32(1);
+
+	__m512i i0 = _mm512_cvttps_epi32(x);
+	__m512i j0 = _mm512_cvttps_epi32(y);
+
+	__m512 s1 = _mm512_sub_ps(x, _mm512_cvtepi32_ps(i0));
+	__m512 s0 = _mm512_sub_ps(one, s1);
+	__m512 t1 = _mm512_sub_ps(y, _mm512_cvtepi32_ps(j0));
+	__m512 t0 = _mm512_sub_ps(one, t1);
+
+	__m512i index00 = _mm512_add_epi32(_mm512_mullo_epi32(j0, rowStride), i0);
+	__m512i index01 = _mm512_add_epi32(index00, rowStride);
+	__m512i index10 = _mm512_add_epi32(index00, nextColumn);
+	__m512i index11 = _mm512_add_epi32(index01, nextColumn);
+
+	__m512 left = _mm512_add_ps(_mm512_mul_ps(t0, _mm512_i32gather_ps(index00, job.u, 4)), _mm512_mul_ps(t1, _mm512_i32gather_ps(index01, job.u, 4)));
+	__m512 right = _mm512_add_ps(_mm512_mul_ps(t0, _mm512_i32gather_ps(index10, job.u, 4)), _mm512_mul_ps(t1, _mm512_i32gather_ps(index11, job.u, 4)));
+	u = _mm512_add_ps(_mm512_mul_ps(s0, left), _mm512_mul_ps(s1, right));
+
+	left = _mm512_add_ps(_mm512_mul_ps(t0, _mm512_i32gather_ps(index00, job.v, 4)), _mm512_mul_ps(t1, _mm512_i32gather_ps(index01, job.v, 4)));
+	right = _mm512_add_ps(_mm512_mul_ps(t0, _mm512_i32gather_ps(index10, job.v, 4)), _mm512_mul_ps(t1, _mm512_i32gather_ps(index11, job.v, 4)));
+	v = _mm512_add_ps(_mm512_mul_ps(s0, left), _mm512_mul_ps(s1, right));
+}
+
+void AdvectTracersAVX512(const TracerJob<float>& job, int begin, int end)
+{
+	const __m512 dt0 = _mm512_set1_ps(job.dt0);
+	const __m512 halfDt0 = _mm512_set1_ps(job.halfDt0);
+	const __m512 lower = _mm512_set1_ps(0.5f);
+	const __m512 upper = _mm512_set1_ps((float)job.N + 0.5f);
+	const __m512 period = _mm512_set1_ps((float)job.N);
+	const bool periodic = job.periodic;
+
+	int particle = begin;
+	for (; particle + 15 < end; particle += 16)
+	{
+		// Same operations as AdvectTracer, sixteen particles at a time
+		__m512 x = _mm512_loadu_ps(job.x + particle);
+		__m512 y = _mm512_loadu_ps(job.y + particle);
+		__m512 u, v;
+
+		Sample(job, x, y, u, v);
+		__m512 midX = Confine(_mm512_add_ps(x, _mm512_mul_ps(halfDt0, u)), lower, upper, period, periodic);
+		__m512 midY = Confine(_mm512_add_ps(y, _mm512_mul_ps(halfDt0, v)), lower, upper, period, periodic);
+
+		Sample(job, midX, midY, u, v);
+		_mm512_storeu_ps(job.x + particle, Confine(_mm512_add_ps(x, _mm512_mul_ps(dt0, u)), lower, upper, period, periodic));
+		_mm512_storeu_ps(job.y + particle, Confine(_mm512_add_ps(y, _mm512_mul_ps(dt0, v)), lower, upper, period, periodic));
+	}
+
+	for (; particle < end; particle++)
+		AdvectTracer(job, particle);
+}
+
+#else
+
+void AdvectRowsAVX512(const AdvectionJob<double>& job, int rowBegin, int rowEnd)
+{
+	AdvectRowsScalar(job, rowBegin, rowEnd);
+}
+
+void AdvectRowsAVX512(const AdvectionJob<float>& job, int rowBegin, int rowEnd)
+{
+	AdvectRowsScalar(job, rowBegin, rowEnd);
+}
+
+void AdvectTracersAVX512(const TracerJob<double>& job, int begin, int end)
+{
+	AdvectTracersScalar(job, begin, end);
+}
+
+void AdvectTracersAVX512(const TracerJob<float>& job, int begin, int end)
+{
+	AdvectTracersScalar(job, begin, end);
+}
+
+#endif
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cmath>
+
+#define ADVECTION_MAX_CHANNELS 4
+
+enum class AdvectionKernel
+{
+	Auto,
+	Scalar,
+	AVX2,
+	AVX512
+};
+
+/**
+ * Everything a semi-Lagrangian advection pass needs. Every cell is traced back
+ * along (u, v) once, and the resulting bilinear weights are applied to all channels.
+ */
+template<typename T>
+struct AdvectionJob
+{
+	int N;
+	int size;
+	T dt0;
+
+	// Interior columns to advect, as a half-open range
+	int columnBegin;
+	int columnEnd;
+
+	const T* u;
+	const T* v;
+
+	int channels;
+	const T* source[ADVECTION_MAX_CHANNELS];
+	T* target[ADVECTION_MAX_CHANNELS];
+
+	// Backtraces that leave the box wrap around instead of stopping at the wall.
+	// The sources need periodic ghost cells then.
+	bool periodic = false;
+};
+
+/**
+ * Everything a tracer particle pass needs. The particles are stored as separate
+ * arrays of x and y coordinates in grid units, where cell (i, j) is centered on (i, j)
+ * and the interior spans [0.5, N + 0.5]. Every particle takes one midpoint (RK2)
+ * step along the bilinearly sampled velocity (u, v).
+ */
+template<typename T>
+struct TracerJob
+{
+	int N;
+	int size;
+	T dt0;
+	T halfDt0;
+
+	const T* u;
+	const T* v;
+
+	T* x;
+	T* y;
+
+	// Particles that leave the box come back in on the other side instead of stopping at the wall
+	bool periodic = false;
+};
+
+// Advects the cells [columnBegin, columnEnd) of the rows [rowBegin, rowEnd)
+template<typename T>
+using AdvectRowsFunction = void (*)(const AdvectionJob<T>& job, int rowBegin, int rowEnd);
+
+// Moves the particles [begin, end)
+template<typename T>
+using AdvectTracersFunction = void (*)(const TracerJob<T>& job, int begin, int end);
+
+// Instantiated for float and double
+template<typename T>
+void AdvectRowsScalar(const AdvectionJob<T>& job, int rowBegin, int rowEnd);
+
+// The SIMD kernels process 4/8 doubles or 8/16 floats at a time
+void AdvectRowsAVX2(const AdvectionJob<double>& job, int rowBegin, int rowEnd);
+void AdvectRowsAVX2(const AdvectionJob<float>& job, int rowBegin, int rowEnd);
+void AdvectRowsAVX512(const AdvectionJob<double>& job, int rowBegin, int rowEnd);
+void AdvectRowsAVX512(const AdvectionJob<float>& job, int rowBegin, int rowEnd);
+
+template<typename T>
+void AdvectTracersScalar(const TracerJob<T>& job, int begin, int end);
+
+void AdvectTracersAVX2(const TracerJob<double>& job, int begin, int end);
+void AdvectTracersAVX2(const TracerJob<float>& job, int begin, int end);
+void AdvectTracersAVX512(const TracerJob<double>& job, int begin, int end);
+void AdvectTracersAVX512(const TracerJob<float>& job, int begin, int end);
+
+/**
+ * Resolves `Auto` to the widest kernel the CPU supports, and falls back to
+ * the scalar kernel if the requested one was not compiled in or the CPU lacks it
+ */
+AdvectionKernel ResolveAdvectionKernel(AdvectionKernel requested);
+template<typename T> AdvectRowsFunction<T> GetAdvectRowsFunction(AdvectionKernel kernel);
+template<typename T> AdvectTracersFunction<T> GetAdvectTracersFunction(AdvectionKernel kernel);
+const char* GetAdvectionKernelName(AdvectionKernel kernel);
+
+/**
+ * The reference implementation for a single cell. The SIMD kernels use it for the
+ * cells at the end of a row, and perform the exact same operations in the same
+ * order for all other cells, so all kernels produce bit-identical results.
+ */
+template<typename T>
+inline void AdvectCell(const AdvectionJob<T>& job, int i, int j)
+{
+	int N = job.N;
+	int size = job.size;
+
+	const T lower = (T)0.5;
+	const T upper = (T)N + (T)0.5;
+
+	T x = (T)i - job.dt0 * job.u[j * size + i];
+	T y = (T)j - job.dt0 * job.v[j * size + i];
+
+	if (job.periodic)
+	{
+		const T period = (T)N;
+		x = x - period * std::floor((x - lower) / period);
+		y = y - period * std::floor((y - lower) / period);
+	}
+
+	if (x < lower)	x = lower;
+	if (x > upper)	x = upper;
+	if (y < lower)	y = lower;
+	if (y > upper)	y = upper;
+
+	int i0 = (int)x;
+	int i1 = i0 + 1;
+	int j0 = (int)y;
+	int j1 = j0 + 1;
+
+	T s1 = x - (T)i0;
+	T s0 = 1 - s1;
+	T t1 = y - (T)j0;
+	T t0 = 1 - t1;
+
+	for (int c = 0; c < job.channels; c++)
+	{
+		const T* src = job.source[c];
+		job.target[c][j * size + i] = s0 * (t0 * src[j0 * size + i0] + t1 * src[j1 * size + i0]) +
+			s1 * (t0 * src[j0 * size + i1] + t1 * src[j1 * size + i1]);
+	}
+}
+
+// Wraps a tracer coordinate around a periodic box, then keeps it inside [0.5, N + 0.5]
+template<typename T>
+inline T ConfineTracer(const TracerJob<T>& job, T position)
+{
+	const T lower = (T)0.5;
+	const T upper = (T)job.N + (T)0.5;
+
+	if (job.periodic)
+	{
+		const T period = (T)job.N;
+		position = position - period * std::floor((position - lower) / period);
+	}
+
+	if (position < lower)	position = lower;
+	if (position > upper)	position = upper;
+
+	return position;
+}
+
+// Bilinear velocity at a confined position, with the same weights as AdvectCell
+template<typename T>
+inline void SampleTracerVelocity(const TracerJob<T>& job, T x, T y, T& u, T& v)
+{
+	int size = job.size;
+
+	int i0 = (int)x;
+	int i1 = i0 + 1;
+	int j0 = (int)y;
+	int j1 = j0 + 1;
+
+	T s1 = x - (T)i0;
+	T s0 = 1 - s1;
+	T t1 = y - (T)j0;
+	T t0 = 1 - t1;
+
+	u = s0 * (t0 * job.u[j0 * size + i0] + t1 * job.u[j1 * size + i0]) +
+		s1 * (t0 * job.u[j0 * size + i1] + t1 * job.u[j1 * size + i1]);
+	v = s0 * (t0 * job.v[j0 * size + i0] + t1 * job.v[j1 * size + i0]) +
+		s1 * (t0 * job.v[j0 * size + i1] + t1 * job.v[j1 * size + i1]);
+}
+
+/**
+ * The reference implementation for a single particle. Like AdvectCell, the SIMD
+ * kernels use it for the particles left over at the end of a range and mirror
+ * its operations exactly for all others.
+ */
+template<typename T>
+inline void AdvectTracer(const TracerJob<T>& job, int particle)
+{
+	T x = job.x[particle];
+	T y = job.y[particle];
+	T u, v;
+
+	SampleTracerVelocity(job, x, y, u, v);
+	T midX = ConfineTracer(job, x + job.halfDt0 * u);
+	T midY = ConfineTracer(job, y + job.halfDt0 * v);
+
+	SampleTracerVelocity(job, midX, midY, u, v);
+	job.x[particle] = ConfineTracer(job, x + job.dt0 * u);
+	job.y[particle] = ConfineTracer(job, y + job.dt0 * v);
+}
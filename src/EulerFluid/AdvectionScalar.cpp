@@ -0,0 +1,96 @@
+#include "AdvectionKernels.hpp"
+
+#include "CpuFeatures.hpp"
+
+// Set by the build for the kernels whose translation units were compiled with the matching instruction set
+#ifndef EULER_FLUID_AVX2_KERNELS
+#define EULER_FLUID_AVX2_KERNELS 0
+#endif
+
+#ifndef EULER_FLUID_AVX512_KERNELS
+#define EULER_FLUID_AVX512_KERNELS 0
+#endif
+
+template<typename T>
+void AdvectRowsScalar(const AdvectionJob<T>& job, int rowBegin, int rowEnd)
+{
+	for (int j = rowBegin; j < rowEnd; j++)
+		for (int i = job.columnBegin; i < job.columnEnd; i++)
+			AdvectCell(job, i, j);
+}
+
+template<typename T>
+void AdvectTracersScalar(const TracerJob<T>& job, int begin, int end)
+{
+	for (int particle = begin; particle < end; particle++)
+		AdvectTracer(job, particle);
+}
+
+AdvectionKernel ResolveAdvectionKernel(AdvectionKernel requested)
+{
+	const CpuFeatures& cpu = GetCpuFeatures();
+	bool avx512 = EULER_FLUID_AVX512_KERNELS && cpu.avx512f;
+	bool avx2 = EULER_FLUID_AVX2_KERNELS && cpu.avx2;
+
+	switch (requested)
+	{
+	case AdvectionKernel::Auto:
+		if (avx512)	return AdvectionKernel::AVX512;
+		if (avx2)	return AdvectionKernel::AVX2;
+		return AdvectionKernel::Scalar;
+
+	case AdvectionKernel::AVX512:
+		return avx512 ? AdvectionKernel::AVX512 : AdvectionKernel::Scalar;
+
+	case AdvectionKernel::AVX2:
+		return avx2 ? AdvectionKernel::AVX2 : AdvectionKernel::Scalar;
+
+	default:
+		return AdvectionKernel::Scalar;
+	}
+}
+
+template<typename T>
+AdvectRowsFunction<T> GetAdvectRowsFunction(AdvectionKernel kernel)
+{
+	switch (ResolveAdvectionKernel(kernel))
+	{
+	case AdvectionKernel::AVX512:	return &AdvectRowsAVX512;
+	case AdvectionKernel::AVX2:		return &AdvectRowsAVX2;
+	default:						return &AdvectRowsScalar<T>;
+	}
+}
+
+template<typename T>
+AdvectTracersFunction<T> GetAdvectTracersFunction(AdvectionKernel kernel)
+{
+	switch (ResolveAdvectionKernel(kernel))
+	{
+	case AdvectionKernel::AVX512:	return &AdvectTracersAVX512;
+	case AdvectionKernel::AVX2:		return &AdvectTracersAVX2;
+	default:						return &AdvectTracersScalar<T>;
+	}
+}
+
+const char* GetAdvectionKernelName(AdvectionKernel kernel)
+{
+	switch (kernel)
+	{
+	case AdvectionKernel::Auto:		return "auto";
+	case AdvectionKernel::AVX2:		return "avx2";
+	case AdvectionKernel::AVX512:	return "avx512";
+	default:						return "scalar";
+	}
+}
+
+template void AdvectRowsScalar<float>(const AdvectionJob<float>& job, int rowBegin, int rowEnd);
+template void AdvectRowsScalar<double>(const AdvectionJob<double>& job, int rowBegin, int rowEnd);
+
+template AdvectRowsFunction<float> GetAdvectRowsFunction<float>(AdvectionKernel kernel);
+template AdvectRowsFunction<double> GetAdvectRowsFunction<double>(AdvectionKernel kernel);
+
+template void AdvectTracersScalar<float>(const TracerJob<float>& job, int begin, int end);
+template void AdvectTracersScalar<double>(const TracerJob<double>& job, int begin, int end);
+
+template AdvectTracersFunction<float> GetAdvectTracersFunction<float>(AdvectionKernel kernel);
+template AdvectTracersFunction<double> GetAdvectTracersFunction<double>(AdvectionKernel kernel);
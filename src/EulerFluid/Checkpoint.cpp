@@ -0,0 +1,231 @@
+#include "Checkpoint.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
+
+#define CHECKPOINT_MAGIC "EFCHKPT"
+#define CHECKPOINT_BYTE_ORDER 0x01020304u
+
+static uint64_t AlignUp(uint64_t bytes)
+{
+	return (bytes + CHECKPOINT_ALIGNMENT - 1) / CHECKPOINT_ALIGNMENT * CHECKPOINT_ALIGNMENT;
+}
+
+CheckpointHeader MakeCheckpointHeader(int resolution, size_t scalarBytes, long long step, double maxVelocity)
+{
+	uint64_t size = (uint64_t)resolution + 2;
+
+	CheckpointHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+
+	header.version = CHECKPOINT_VERSION;
+	header.byteOrder = CHECKPOINT_BYTE_ORDER;
+	header.headerBytes = (uint32_t)AlignUp(sizeof(CheckpointHeader));
+	header.scalarBytes = (uint32_t)scalarBytes;
+	header.resolution = (uint32_t)resolution;
+	header.arrayCount = CHECKPOINT_ARRAYS;
+	header.arrayBytes = size * size * scalarBytes;
+	header.arrayStride = AlignUp(header.arrayBytes);
+	header.step = step;
+	header.maxVelocity = maxVelocity;
+
+	return header;
+}
+
+bool WriteCheckpoint(const std::string& path, const CheckpointHeader& header, const void* const* arrays)
+{
+	// Written under a temporary name and renamed, so a crash never leaves a truncated checkpoint behind
+	std::string temporary = path + ".tmp";
+	FILE* file = std::fopen(temporary.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	std::vector<unsigned char> padding(CHECKPOINT_ALIGNMENT, 0);
+	bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+		&& std::fwrite(padding.data(), header.headerBytes - sizeof(header), 1, file) == 1;
+
+	size_t tail = (size_t)(header.arrayStride - header.arrayBytes);
+	for (uint32_t i = 0; ok && i < header.arrayCount; i++)
+	{
+		ok = std::fwrite(arrays[i], 1, (size_t)header.arrayBytes, file) == header.arrayBytes
+			&& (tail == 0 || std::fwrite(padding.data(), tail, 1, file) == 1);
+	}
+
+	ok = (std::fclose(file) == 0) && ok;
+
+	// rename replaces the target atomically on POSIX, but refuses to replace existing files on Windows
+#if !defined(_WIN32)
+	ok = ok && std::rename(temporary.c_str(), path.c_str()) == 0;
+#else
+	ok = ok && MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#endif
+
+	if (!ok)
+	{
+		std::remove(temporary.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+CheckpointFile::~CheckpointFile()
+{
+	Close();
+}
+
+bool CheckpointFile::Open(const std::string& path)
+{
+	Close();
+
+#if !defined(_WIN32)
+	int descriptor = open(path.c_str(), O_RDONLY);
+	if (descriptor < 0)
+	{
+		error = "cannot open " + path;
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(descriptor, &status) != 0 || status.st_size < (off_t)sizeof(CheckpointHeader))
+	{
+		close(descriptor);
+		error = path + " is too small to be a checkpoint";
+		return false;
+	}
+
+	bytes = (size_t)status.st_size;
+	void* mapping = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, descriptor, 0);
+	close(descriptor);
+
+	if (mapping == MAP_FAILED)
+	{
+		error = "cannot map " + path;
+		return false;
+	}
+
+	// Restoring reads everything front to back. The advice values are not flags, so they are given one at a
+	// time, and a kernel that ignores them only makes the restore slower.
+	(void)madvise(mapping, bytes, MADV_SEQUENTIAL);
+	(void)madvise(mapping, bytes, MADV_WILLNEED);
+
+	data = static_cast<const unsigned char*>(mapping);
+	mapped = true;
+#else
+	FILE* file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr)
+	{
+		error = "cannot open " + path;
+		return false;
+	}
+
+	std::fseek(file, 0, SEEK_END);
+	long long length = _ftelli64(file);
+	std::fseek(file, 0, SEEK_SET);
+
+	if (length < (long long)sizeof(CheckpointHeader))
+	{
+		std::fclose(file);
+		error = path + " is too small to be a checkpoint";
+		return false;
+	}
+
+	bytes = (size_t)length;
+	unsigned char* buffer = new unsigned char[bytes];
+	bool complete = std::fread(buffer, 1, bytes, file) == bytes;
+	std::fclose(file);
+
+	data = buffer;
+	if (!complete)
+	{
+		Close();
+		error = "cannot read " + path;
+		return false;
+	}
+#endif
+
+	if (!Validate())
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void CheckpointFile::Close()
+{
+	if (data == nullptr)
+		return;
+
+#if !defined(_WIN32)
+	if (mapped)
+		munmap(const_cast<unsigned char*>(data), bytes);
+#else
+	delete[] data;
+#endif
+
+	data = nullptr;
+	bytes = 0;
+	mapped = false;
+}
+
+bool CheckpointFile::Validate()
+{
+	const CheckpointHeader& header = GetHeader();
+
+	if (std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0)
+	{
+		error = "not a checkpoint";
+		return false;
+	}
+
+	if (header.version != CHECKPOINT_VERSION)
+	{
+		error = "unsupported checkpoint version " + std::to_string(header.version);
+		return false;
+	}
+
+	if (header.byteOrder != CHECKPOINT_BYTE_ORDER)
+	{
+		error = "checkpoint was written on a machine with a different byte order";
+		return false;
+	}
+
+	// The arrays are read in place as scalars, so every offset has to keep the alignment the writer used
+	uint64_t size = (uint64_t)header.resolution + 2;
+	bool consistent = header.headerBytes >= sizeof(CheckpointHeader)
+		&& header.headerBytes % CHECKPOINT_ALIGNMENT == 0
+		&& (header.scalarBytes == 4 || header.scalarBytes == 8)
+		&& header.arrayCount == CHECKPOINT_ARRAYS
+		&& size <= UINT64_MAX / size / header.scalarBytes
+		&& header.arrayBytes == size * size * header.scalarBytes
+		&& header.arrayStride >= header.arrayBytes
+		&& header.arrayStride % CHECKPOINT_ALIGNMENT == 0;
+
+	if (!consistent)
+	{
+		error = "corrupt checkpoint header";
+		return false;
+	}
+
+	// Divides instead of multiplying, a crafted stride could make the product wrap around
+	if ((uint64_t)bytes < header.headerBytes || header.arrayStride > ((uint64_t)bytes - header.headerBytes) / header.arrayCount)
+	{
+		error = "checkpoint is truncated";
+		return false;
+	}
+
+	return true;
+}
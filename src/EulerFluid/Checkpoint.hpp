@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "ArraySpan.hpp"
+
+#define CHECKPOINT_VERSION 2
+
+// The header and every array start on a page boundary, so a mapped checkpoint can be used in place
+#define CHECKPOINT_ALIGNMENT 4096
+
+// Both generations of u, v and density, in this order, followed by the pressures of both projection passes
+#define CHECKPOINT_CHANNELS 3
+#define CHECKPOINT_PRESSURES 2
+#define CHECKPOINT_ARRAYS (2 * CHECKPOINT_CHANNELS + CHECKPOINT_PRESSURES)
+
+/**
+ * Fixed-size header at the start of every checkpoint. It is followed by
+ * CHECKPOINT_ARRAYS arrays of (N + 2)^2 scalars in native byte order, the
+ * first at offset `headerBytes` and the others `arrayStride` bytes apart.
+ */
+struct CheckpointHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;			// Reads back as CHECKPOINT_BYTE_ORDER on a machine with the same endianness
+	uint32_t headerBytes;
+	uint32_t scalarBytes;		// 4 for float, 8 for double
+	uint32_t resolution;		// N, the grid has (N + 2)^2 cells including the ghost cells
+	uint32_t arrayCount;
+	uint64_t arrayBytes;
+	uint64_t arrayStride;
+	int64_t step;
+	double maxVelocity;
+};
+
+/**
+ * Builds the header for a field of the given resolution and scalar size
+ */
+CheckpointHeader MakeCheckpointHeader(int resolution, size_t scalarBytes, long long step, double maxVelocity);
+
+/**
+ * Writes a header and its arrays to `path`, padding everything to the page alignment.
+ *
+ * @param arrays `header.arrayCount` pointers to `header.arrayBytes` bytes each
+ * @return false if the file could not be written completely
+ */
+bool WriteCheckpoint(const std::string& path, const CheckpointHeader& header, const void* const* arrays);
+
+/**
+ * A checkpoint opened for reading.
+ *
+ * The file is memory-mapped, so opening it costs nothing beyond checking the
+ * header, and several processes restoring from the same warm-start state share
+ * its pages through the page cache. Where mapping is not available (Windows),
+ * the file is read into memory instead.
+ */
+class CheckpointFile
+{
+public:
+	CheckpointFile() {}
+	~CheckpointFile();
+
+	CheckpointFile(const CheckpointFile& other) = delete;
+	CheckpointFile& operator=(const CheckpointFile& other) = delete;
+
+	/**
+	 * Maps the file and validates its header and size
+	 *
+	 * @return false if the file cannot be opened or is not a checkpoint of this version.
+	 *	GetError tells why.
+	 */
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen() const { return data != nullptr; }
+	const std::string& GetError() const { return error; }
+
+	const CheckpointHeader& GetHeader() const { return *reinterpret_cast<const CheckpointHeader*>(data); }
+
+	/**
+	 * The array at `index`, or an empty span if the checkpoint stores another scalar type
+	 */
+	template<typename T>
+	ArraySpan<const T> GetArray(int index) const
+	{
+		const CheckpointHeader& header = GetHeader();
+		if (header.scalarBytes != sizeof(T) || index < 0 || index >= (int)header.arrayCount)
+			return ArraySpan<const T>();
+
+		const unsigned char* array = data + header.headerBytes + (size_t)index * header.arrayStride;
+		return ArraySpan<const T>(reinterpret_cast<const T*>(array), header.arrayBytes / sizeof(T));
+	}
+
+private:
+	bool Validate();
+
+private:
+	const unsigned char* data = nullptr;
+	size_t bytes = 0;
+	bool mapped = false;
+
+	std::string error;
+};
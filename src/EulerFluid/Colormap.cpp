@@ -0,0 +1,30 @@
+#include "Colormap.hpp"
+
+#include <algorithm>
+
+static uint32_t Pack(double r, double g, double b)
+{
+	auto channel = [](double value) { return (uint32_t)(std::min(std::max(value, 0.0), 1.0) * 255.0 + 0.5); };
+	return 0xFF000000u | (channel(r) << 16) | (channel(g) << 8) | channel(b);
+}
+
+Colormap::Colormap(ColormapType type) :
+	type(type)
+{
+	for (int i = 0; i < COLORMAP_ENTRIES; i++)
+	{
+		double t = (double)i / (double)(COLORMAP_ENTRIES - 1);
+
+		switch (type)
+		{
+		case ColormapType::Heat:
+			// Black through red and yellow to white
+			entries[i] = Pack(3.0 * t, 3.0 * t - 1.0, 3.0 * t - 2.0);
+			break;
+
+		default:
+			entries[i] = Pack(t, t, t);
+			break;
+		}
+	}
+}
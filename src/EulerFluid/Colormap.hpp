@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+#define COLORMAP_ENTRIES 256
+
+enum class ColormapType
+{
+	Grayscale,
+	Heat
+};
+
+/**
+ * A lookup table that maps scalar values to colors. Values are clamped to [0, 1] and NaNs
+ * map to 0, so mapping a value is a clamp, a multiply and a table read.
+ *
+ * Colors are stored packed as 0xAARRGGBB, which is the native layout of
+ * 32 bit ARGB pixels. It does not depend on SDL, so headless tools can share it.
+ */
+class Colormap
+{
+public:
+	Colormap(ColormapType type = ColormapType::Grayscale);
+
+	uint32_t Map(double value) const
+	{
+		// Clamped before the conversion, which is undefined for values out of the range of int.
+		// The first test is written so that NaNs, e.g. from a run that blew up, map to 0 as well.
+		if (!(value > 0.0))	value = 0.0;
+		if (value > 1.0)	value = 1.0;
+
+		return entries[(int)(value * (COLORMAP_ENTRIES - 1) + 0.5)];
+	}
+
+	// Maps `count` consecutive values into packed pixels
+	template<typename T>
+	void MapRow(const T* values, int count, uint32_t* pixels) const
+	{
+		for (int i = 0; i < count; i++)
+			pixels[i] = Map((double)values[i]);
+	}
+
+	uint32_t GetEntry(int index) const { return entries[index]; }
+	ColormapType GetType() const { return type; }
+
+	static uint8_t Red(uint32_t color) { return (color >> 16) & 0xFF; }
+	static uint8_t Green(uint32_t color) { return (color >> 8) & 0xFF; }
+	static uint8_t Blue(uint32_t color) { return color & 0xFF; }
+
+private:
+	ColormapType type;
+	uint32_t entries[COLORMAP_ENTRIES];
+};
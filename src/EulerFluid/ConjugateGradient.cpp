@@ -0,0 +1,220 @@
+#include "ConjugateGradient.hpp"
+
+#include <cmath>
+
+#define IDX(x, y, w) ((y) * (w) + (x))
+
+template<typename T>
+ConjugateGradient<T>::ConjugateGradient(int resolution) :
+	N(resolution), size(resolution + 2)
+{
+	residual = FieldVector<T>(size * size, 0.0);
+	preconditioned = FieldVector<T>(size * size, 0.0);
+	direction = FieldVector<T>(size * size, 0.0);
+	product = FieldVector<T>(size * size, 0.0);
+}
+
+template<typename T>
+SolverStats ConjugateGradient<T>::Solve(ArraySpan<T> x, ArraySpan<const T> b, double diagonal, double offDiagonal, double tolerance, int maxIterations)
+{
+	SolverStats stats;
+
+	// Without a diagonal surplus the Neumann problem is only determined up to a constant,
+	// and only solvable for a right hand side with zero mean
+	bool singular = (diagonal - 4.0 * offDiagonal) <= 0.0;
+
+	double mean = 0.0;
+	if (singular)
+	{
+		mean = ParallelSum(threadPool, 1, N + 1, [&](int begin, int end)
+		{
+			double sum = 0.0;
+			for (int j = begin; j < end; j++)
+				for (int i = 1; i <= N; i++)
+					sum += b[IDX(i, j, size)];
+
+			return sum;
+		});
+
+		mean /= (double)N * (double)N;
+	}
+
+	// r = b - Ax
+	Apply(x, product, diagonal, offDiagonal);
+	double rhsNorm = ParallelSum(threadPool, 1, N + 1, [&](int begin, int end)
+	{
+		double sum = 0.0;
+		for (int j = begin; j < end; j++)
+		{
+			for (int i = 1; i <= N; i++)
+			{
+				double rhs = b[IDX(i, j, size)] - mean;
+				residual[IDX(i, j, size)] = (T)(rhs - product[IDX(i, j, size)]);
+				sum += rhs * rhs;
+			}
+		}
+
+		return sum;
+	});
+
+	rhsNorm = std::sqrt(rhsNorm);
+	if (rhsNorm == 0.0)
+		return stats;
+
+	stats.residual = std::sqrt(Dot(residual, residual)) / rhsNorm;
+	if (stats.residual <= tolerance)
+		return stats;
+
+	if (singular && !multigrid)
+	{
+		multigrid = std::make_unique<Multigrid<T>>(N);
+		multigrid->SetThreadPool(threadPool);
+	}
+
+	Precondition(residual, preconditioned, diagonal, offDiagonal, singular);
+	direction = preconditioned;
+	double rz = Dot(residual, preconditioned);
+
+	while (stats.iterations < maxIterations)
+	{
+		Apply(direction, product, diagonal, offDiagonal);
+
+		double curvature = Dot(direction, product);
+		if (curvature <= 0.0)
+			break;
+
+		T alpha = (T)(rz / curvature);
+		double residualNorm = ParallelSum(threadPool, 1, N + 1, [&](int begin, int end)
+		{
+			double sum = 0.0;
+			for (int j = begin; j < end; j++)
+			{
+				for (int i = 1; i <= N; i++)
+				{
+					x[IDX(i, j, size)] += alpha * direction[IDX(i, j, size)];
+					residual[IDX(i, j, size)] -= alpha * product[IDX(i, j, size)];
+					sum += (double)residual[IDX(i, j, size)] * residual[IDX(i, j, size)];
+				}
+			}
+
+			return sum;
+		});
+
+		stats.iterations++;
+		stats.residual = std::sqrt(residualNorm) / rhsNorm;
+		if (stats.residual <= tolerance)
+			break;
+
+		// Polak-Ribiere subtracts the part of the new residual along the old preconditioned one,
+		// which is zero for the symmetric Jacobi preconditioner but not for the V-cycle
+		double rzPrevious = singular ? Dot(residual, preconditioned) : 0.0;
+
+		Precondition(residual, preconditioned, diagonal, offDiagonal, singular);
+		double rzNext = Dot(residual, preconditioned);
+		T beta = (T)((rzNext - rzPrevious) / rz);
+		rz = rzNext;
+
+		ParallelFor(threadPool, 1, N + 1, [&](int begin, int end)
+		{
+			for (int j = begin; j < end; j++)
+				for (int i = 1; i <= N; i++)
+					direction[IDX(i, j, size)] = preconditioned[IDX(i, j, size)] + beta * direction[IDX(i, j, size)];
+		});
+	}
+
+	return stats;
+}
+
+template<typename T>
+void ConjugateGradient<T>::Apply(ArraySpan<T> in, FieldVector<T>& out, double diagonal, double offDiagonal)
+{
+	ApplyBoundaryConditions(in);
+
+	T center = (T)diagonal;
+	T neighbour = (T)offDiagonal;
+
+	ParallelFor(threadPool, 1, N + 1, [&](int begin, int end)
+	{
+		for (int j = begin; j < end; j++)
+		{
+			for (int i = 1; i <= N; i++)
+			{
+				out[IDX(i, j, size)] = center * in[IDX(i, j, size)] - neighbour * (in[IDX(i - 1, j, size)] + in[IDX(i + 1, j, size)] + in[IDX(i, j - 1, size)] + in[IDX(i, j + 1, size)]);
+			}
+		}
+	});
+}
+
+template<typename T>
+void ConjugateGradient<T>::SetThreadPool(ThreadPool* pool)
+{
+	threadPool = pool;
+
+	if (multigrid)
+		multigrid->SetThreadPool(pool);
+}
+
+template<typename T>
+void ConjugateGradient<T>::Precondition(const FieldVector<T>& in, FieldVector<T>& out, double diagonal, double offDiagonal, bool singular)
+{
+	// The V-cycle approximately inverts the system scaled to an off-diagonal of one, and
+	// returns a correction without a mean, which keeps the directions out of the null space
+	if (singular)
+	{
+		multigrid->Precondition(in, out);
+
+		T scale = (T)(1.0 / offDiagonal);
+		ParallelFor(threadPool, 1, N + 1, [&](int begin, int end)
+		{
+			for (int j = begin; j < end; j++)
+				for (int i = 1; i <= N; i++)
+					out[IDX(i, j, size)] *= scale;
+		});
+
+		return;
+	}
+
+	// Jacobi preconditioner. Cells next to the walls see themselves through the ghost cells,
+	// which takes one off-diagonal term off their diagonal per adjacent wall.
+	ParallelFor(threadPool, 1, N + 1, [&](int begin, int end)
+	{
+		for (int j = begin; j < end; j++)
+		{
+			int wallsY = (j == 1) + (j == N);
+			for (int i = 1; i <= N; i++)
+			{
+				int walls = wallsY + (i == 1) + (i == N);
+				out[IDX(i, j, size)] = (T)(in[IDX(i, j, size)] / (diagonal - walls * offDiagonal));
+			}
+		}
+	});
+}
+
+template<typename T>
+void ConjugateGradient<T>::ApplyBoundaryConditions(ArraySpan<T> field)
+{
+	for (int i = 1; i <= N; i++)
+	{
+		field[IDX(0, i, size)] = field[IDX(1, i, size)];
+		field[IDX(N + 1, i, size)] = field[IDX(N, i, size)];
+		field[IDX(i, 0, size)] = field[IDX(i, 1, size)];
+		field[IDX(i, N + 1, size)] = field[IDX(i, N, size)];
+	}
+}
+
+template<typename T>
+double ConjugateGradient<T>::Dot(const FieldVector<T>& a, const FieldVector<T>& b) const
+{
+	return ParallelSum(threadPool, 1, N + 1, [&](int begin, int end)
+	{
+		double sum = 0.0;
+		for (int j = begin; j < end; j++)
+			for (int i = 1; i <= N; i++)
+				sum += (double)a[IDX(i, j, size)] * b[IDX(i, j, size)];
+
+		return sum;
+	});
+}
+
+template class ConjugateGradient<float>;
+template class ConjugateGradient<double>;
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "ArraySpan.hpp"
+#include "FieldMemory.hpp"
+#include "Multigrid.hpp"
+#include "SolverStats.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ * Matrix-free preconditioned conjugate gradient solver for the systems
+ *
+ *		diagonal * x(i, j) - offDiagonal * (x(i - 1, j) + x(i + 1, j) + x(i, j - 1) + x(i, j + 1)) = b(i, j)
+ *
+ * on a (N + 2)x(N + 2) grid with continuous (Neumann) ghost cells. This covers
+ * both the implicit diffusion step (diagonal = 1 + 4a, offDiagonal = a) and the
+ * pressure Poisson equation (diagonal = 4, offDiagonal = 1) of FluidField.
+ *
+ * The diffusion systems are diagonally dominant and are preconditioned with Jacobi.
+ * On the pressure system Jacobi is almost the identity, since the diagonal is constant,
+ * so it is preconditioned with one multigrid V-cycle instead. That preconditioner is
+ * not exactly symmetric, so the directions are updated with the Polak-Ribiere formula,
+ * which keeps CG converging with it. The work vectors and the grid hierarchy are
+ * allocated once and reused by every solve. Instantiated for float and double;
+ * reductions are always accumulated in double precision.
+ */
+template<typename T>
+class ConjugateGradient
+{
+public:
+	ConjugateGradient(int resolution);
+
+	/**
+	 * Solves for `x`, using its current contents as the initial guess.
+	 * Stops as soon as the residual relative to `b` drops below `tolerance`,
+	 * or after `maxIterations` iterations. Only the interior of `x` is solved for,
+	 * applying the caller's boundary conditions afterwards is up to the caller.
+	 *
+	 * @return The number of iterations performed and the final relative residual
+	 */
+	SolverStats Solve(ArraySpan<T> x, ArraySpan<const T> b, double diagonal, double offDiagonal, double tolerance, int maxIterations);
+
+	// Splits the vector kernels across the given pool, or runs them serially if it is null
+	void SetThreadPool(ThreadPool* pool);
+
+private:
+	void Apply(ArraySpan<T> in, FieldVector<T>& out, double diagonal, double offDiagonal);
+	void Precondition(const FieldVector<T>& in, FieldVector<T>& out, double diagonal, double offDiagonal, bool singular);
+	void ApplyBoundaryConditions(ArraySpan<T> field);
+	double Dot(const FieldVector<T>& a, const FieldVector<T>& b) const;
+
+private:
+	int N, size;
+
+	FieldVector<T> residual;
+	FieldVector<T> preconditioned;
+	FieldVector<T> direction;
+	FieldVector<T> product;
+
+	// Built the first time a pressure system is solved
+	std::unique_ptr<Multigrid<T>> multigrid;
+
+	ThreadPool* threadPool = nullptr;
+};
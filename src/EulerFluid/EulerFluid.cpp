@@ -1,26 +1,164 @@
 #include "EulerFluid.hpp"
 
+#include <chrono>
+#include <cstdlib>
 #include <iostream>
 #include <SDL.h>
 
+#include "Profiler.hpp"
+
+#define SIMULATION_RATE 60.0
+#define TRACER_COUNT 20000
+
 EulerFluid::EulerFluid(int width, int height, const char* title) :
 	Window::Window(width, height, title)
 {
-	field = new FluidField(60);
+	const char* trace = std::getenv("EULER_FLUID_TRACE");
+	if (trace != nullptr && *trace != '\0')
+	{
+		tracePath = trace;
+		Profiler::SetThreadName("Window");
+		Profiler::SetEnabled(true);
+	}
+
+	field = new FluidField<float>(60);
+	field->SetStepMode(StepMode::Fused);
+
+	tracers = new TracerParticles<float>(field->GetResolution());
+	tracers->Seed(TRACER_COUNT);
+
+	FluidFrame<float> initial;
+	field->Snapshot(initial);
+	initial.tracerX.assign(tracers->GetX().begin(), tracers->GetX().end());
+	initial.tracerY.assign(tracers->GetY().begin(), tracers->GetY().end());
+	frames.Fill(initial);
+
+	simulation = std::thread(&EulerFluid::SimulationLoop, this);
 }
 
 EulerFluid::~EulerFluid()
 {
+	running.store(false, std::memory_order_relaxed);
+	simulation.join();
+
+	delete tracers;
 	delete field;
+
+	if (!tracePath.empty())
+	{
+		Profiler::SetEnabled(false);
+		Profiler::PrintSummary(std::cout);
+
+		if (!Profiler::WriteChromeTrace(tracePath))
+			std::cerr << "Failed to write the trace to " << tracePath << std::endl;
+	}
 }
 
-void EulerFluid::OnUpdate(double dt)
+void EulerFluid::OnEvent(const SDL_Event& event)
 {
-	field->VelocityStep(0.002, dt);
-	field->DensityStep(0.0005, dt);
+	InputEvent input;
+	switch (event.type)
+	{
+	case SDL_MOUSEMOTION:
+		input = { InputEvent::Type::Motion, event.motion.x, event.motion.y, 0 };
+		break;
+
+	case SDL_MOUSEBUTTONDOWN:
+		input = { InputEvent::Type::ButtonDown, event.button.x, event.button.y, event.button.button };
+		break;
+
+	case SDL_MOUSEBUTTONUP:
+		input = { InputEvent::Type::ButtonUp, event.button.x, event.button.y, event.button.button };
+		break;
+
+	default:
+		return;
+	}
+
+	// If the simulation falls this far behind, losing a mouse event is the least of its problems
+	inputs.TryPush(input);
 }
 
 void EulerFluid::OnRender(SDL_Renderer* renderer)
 {
-	field->Draw(renderer, {0, 0, 1000, 1000});
+	fieldRenderer.Draw(renderer, frames.Acquire(), {0, 0, 1000, 1000});
+}
+
+void EulerFluid::SimulationLoop()
+{
+	using Clock = std::chrono::steady_clock;
+
+	Profiler::SetThreadName("Simulation");
+
+	const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / SIMULATION_RATE));
+
+	Clock::time_point nextStep = Clock::now();
+	Clock::time_point lastFrame = nextStep;
+
+	while (running.load(std::memory_order_relaxed))
+	{
+		InputEvent input;
+		while (inputs.TryPop(input))
+			ApplyInput(input);
+
+		// The controller covers the time that actually passed, in as few stable steps as possible
+		Clock::time_point now = Clock::now();
+		timestep.Accumulate(std::chrono::duration<double>(now - lastFrame).count());
+		lastFrame = now;
+
+		double dt;
+		while ((dt = timestep.NextTimestep(field->GetMaxVelocity(), field->GetResolution())) > 0.0)
+		{
+			QueueMouseInput();
+			field->Step(0.002, 0.0005, dt);
+			tracers->Advect(field->GetVelocity(), dt);
+		}
+
+		if (timestep.GetSubsteps() > 0)
+		{
+			FluidFrame<float>& frame = frames.GetWriteBuffer();
+			field->Snapshot(frame);
+			frame.tracerX.assign(tracers->GetX().begin(), tracers->GetX().end());
+			frame.tracerY.assign(tracers->GetY().begin(), tracers->GetY().end());
+			frames.Publish();
+		}
+
+		// Don't try to catch up after a slow step, that would only make the next one late too
+		nextStep += period;
+		now = Clock::now();
+		if (nextStep < now)
+			nextStep = now;
+		else
+			std::this_thread::sleep_until(nextStep);
+	}
+}
+
+void EulerFluid::ApplyInput(const InputEvent& input)
+{
+	mouseX = input.x;
+	mouseY = input.y;
+
+	bool pressed = (input.type == InputEvent::Type::ButtonDown);
+	if (input.type != InputEvent::Type::Motion)
+	{
+		if (input.button == SDL_BUTTON_LEFT)
+			leftButton = pressed;
+		else if (input.button == SDL_BUTTON_RIGHT)
+			rightButton = pressed;
+	}
+}
+
+void EulerFluid::QueueMouseInput()
+{
+	int dx = (double)field->GetResolution() / (double)(990 - 10) * (double)(mouseX - 10);
+	int dy = (double)field->GetResolution() / (double)(990 - 10) * (double)(mouseY - 10);
+
+	if (rightButton)
+		field->QueueForce(lastMouseX, lastMouseY, (dx - lastMouseX) * 500.0, (dy - lastMouseY) * 500.0);
+
+	if (leftButton)
+		field->QueueSource(dx, dy, 100.0);
+
+	lastMouseX = dx;
+	lastMouseY = dy;
 }
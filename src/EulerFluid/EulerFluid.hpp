@@ -1,7 +1,32 @@
 #pragma once 
 
+#include <atomic>
+#include <string>
+#include <thread>
+
 #include "Window.hpp"
 #include "FluidField.hpp"
+#include "FluidFrame.hpp"
+#include "FluidRenderer.hpp"
+#include "SpscQueue.hpp"
+#include "TimestepController.hpp"
+#include "TracerParticles.hpp"
+#include "TripleBuffer.hpp"
+
+// Mouse input as it is forwarded from the window to the simulation thread
+struct InputEvent
+{
+	enum class Type
+	{
+		Motion,
+		ButtonDown,
+		ButtonUp
+	};
+
+	Type type;
+	int x, y;
+	int button;
+};
 
 class EulerFluid : public Window
 {
@@ -10,9 +35,33 @@ public:
 	~EulerFluid();
 
 private:
-	void OnUpdate(double dt) override;
+	void OnEvent(const SDL_Event& event) override;
 	void OnRender(SDL_Renderer* renderer) override;
 
+	// Wakes up at a fixed rate until the window closes and lets the timestep controller
+	// decide how many steps cover the elapsed time. Runs on its own thread.
+	void SimulationLoop();
+	void ApplyInput(const InputEvent& input);
+	void QueueMouseInput();
+
 private:
-	FluidField* field;
-};
\ No newline at end of file
+	// Single precision is plenty for an interactive preview
+	FluidField<float>* field;
+	TracerParticles<float>* tracers;
+	FluidRenderer fieldRenderer;
+
+	TripleBuffer<FluidFrame<float>> frames;
+	SpscQueue<InputEvent, 1024> inputs;
+
+	std::thread simulation;
+	std::atomic<bool> running{ true };
+
+	// Set from EULER_FLUID_TRACE, the profile is written there when the window closes
+	std::string tracePath;
+
+	// Only touched by the simulation thread
+	TimestepController timestep;
+	int mouseX = 0, mouseY = 0;
+	int lastMouseX = 0, lastMouseY = 0;
+	bool leftButton = false, rightButton = false;
+};
@@ -1,8 +1,13 @@
 #include "FluidField.hpp"
 
-#include <iostream>
-#include <SDL.h>
-
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+#include "Checkpoint.hpp"
+#include "FloatingPoint.hpp"
+#include "Profiler.hpp"
 #include "VectorField.hpp"
 
 #define VALUE(arr, x, y) ((arr)[(y) * this->size + (x)])
@@ -10,13 +15,23 @@
 
 #define IDX(x, y, w) ((y) * (w) + (x))
 
-FluidField::FluidField(int size) :
-	size(size + 2)
+#define RELAXATION_SWEEPS 20
+#define PRESSURE_CHECK_INTERVAL 5
+#define DEFAULT_MULTIGRID_CYCLES 10
+#define DEFAULT_PRESSURE_CG_ITERATIONS 500
+#define DEFAULT_DIFFUSION_CG_ITERATIONS 100
+
+template<typename T>
+FluidField<T>::FluidField(int size) :
+	size(size + 2), stencil(size), kernels(GetGridKernels<T>(size)), tiles(size)
 {
-	density = RetentiveArray<double, 1>(this->size * this->size);
+	density = RetentiveArray<T, 1>(this->size * this->size);
+	pressure[0].assign(this->size * this->size, 0);
+	pressure[1].assign(this->size * this->size, 0);
+	divergence.assign(this->size * this->size, 0);
 
-	std::vector<double> hori(this->size * this->size);
-	std::vector<double> vert(this->size * this->size);
+	FieldVector<T> hori(this->size * this->size);
+	FieldVector<T> vert(this->size * this->size);
 
 	for (int y = 1; y < this->size - 1; y++)
 	{
@@ -34,268 +49,928 @@ FluidField::FluidField(int size) :
 		}
 	}
 
-	velocity = RetentiveObject<VectorField, 1>(VectorField(this->size, this->size, hori, vert));
+	velocity = RetentiveObject<VectorField<T>, 1>(VectorField<T>(this->size, this->size, hori, vert));
+
+	SetAdvectionKernel(AdvectionKernel::Auto);
 }
 
-FluidField::~FluidField()
+template<typename T>
+FluidField<T>::~FluidField()
 {
 	// Do nothing
 }
 
-void FluidField::AddSource(int x, int y, double dens, double dt)
+template<typename T>
+template<typename Task>
+void FluidField<T>::ForEachBlock(Task&& task)
 {
-	density.Current()[IDX(x, y, size)] = dt * dens;
-	density.Current()[IDX(x, y, size)] = std::max(density[0][IDX(x, y, size)], 0.0);
+	int N = this->size - 2;
+
+	if (!IsSparse())
+	{
+		ParallelFor(threadPool.get(), 1, N + 1, [&](int begin, int end)
+		{
+			task(begin, end, 1, N + 1);
+		});
+		return;
+	}
+
+	// Rows are handed out rather than tiles, so the work is balanced over the active area
+	const std::vector<int>& rows = tiles.GetActiveRows();
+	ParallelFor(threadPool.get(), 0, (int)rows.size(), [&](int begin, int end)
+	{
+		for (int r = begin; r < end; r++)
+		{
+			int j = rows[r];
+			tiles.ForEachSpan(j, [&](int columnBegin, int columnEnd)
+			{
+				task(j, j + 1, columnBegin, columnEnd);
+			});
+		}
+	});
 }
 
-void FluidField::AddFlow(int x, int y, double dx, double dy, double dt)
+template<typename T>
+template<typename Task>
+double FluidField<T>::SumOverBlocks(Task&& task) const
 {
-	velocity.Current().horizontal[IDX(x, y, size)] += dt * dx;
-	velocity.Current().vertical[IDX(x, y, size)] += dt * dy;
+	int N = this->size - 2;
+
+	if (!IsSparse())
+	{
+		return ParallelSum(threadPool.get(), 1, N + 1, [&](int begin, int end)
+		{
+			return task(begin, end, 1, N + 1);
+		});
+	}
+
+	const std::vector<int>& rows = tiles.GetActiveRows();
+	return ParallelSum(threadPool.get(), 0, (int)rows.size(), [&](int begin, int end)
+	{
+		double sum = 0.0;
+		for (int r = begin; r < end; r++)
+		{
+			int j = rows[r];
+			tiles.ForEachSpan(j, [&](int columnBegin, int columnEnd)
+			{
+				sum += task(j, j + 1, columnBegin, columnEnd);
+			});
+		}
+
+		return sum;
+	});
 }
 
-void FluidField::ApplyBoundaryConditions(BoundaryCondition condition, std::vector<double>& field)
+template<typename T>
+template<typename Task>
+double FluidField<T>::MaxOverBlocks(Task&& task) const
 {
 	int N = this->size - 2;
-	for (int i = 1; i <= N; i++)
+
+	if (!IsSparse())
 	{
+		return ParallelMax(threadPool.get(), 1, N + 1, 0.0, [&](int begin, int end)
+		{
+			return task(begin, end, 1, N + 1);
+		});
+	}
 
-		VALUE(field, 0		, i) = (condition == BoundaryCondition::InvertHorizontal)	? -VALUE(field, 1, i) : VALUE(field, 1, i); // VALUE(field, N, i);
-		VALUE(field, N + 1	, i) = (condition == BoundaryCondition::InvertHorizontal)	? -VALUE(field, N, i) : VALUE(field, N, i);	// VALUE(field, 1, i);
-		VALUE(field, i		, 0) = (condition == BoundaryCondition::InvertVertical)		? -VALUE(field, i, 1) : VALUE(field, i, 1);	// VALUE(field, i, N);
-		VALUE(field, i	, N + 1) = (condition == BoundaryCondition::InvertVertical)		? -VALUE(field, i, N) : VALUE(field, i, N);	// VALUE(field, i, 1);
+	const std::vector<int>& rows = tiles.GetActiveRows();
+	return ParallelMax(threadPool.get(), 0, (int)rows.size(), 0.0, [&](int begin, int end)
+	{
+		double maximum = 0.0;
+		for (int r = begin; r < end; r++)
+		{
+			int j = rows[r];
+			tiles.ForEachSpan(j, [&](int columnBegin, int columnEnd)
+			{
+				maximum = std::max(maximum, task(j, j + 1, columnBegin, columnEnd));
+			});
+		}
+
+		return maximum;
+	});
+}
+
+template<typename T>
+void FluidField<T>::AddSource(int x, int y, double dens, double dt)
+{
+	density.Current()[IDX(x, y, size)] = (T)(dt * dens);
+	density.Current()[IDX(x, y, size)] = std::max(density[0][IDX(x, y, size)], (T)0);
+
+	if (IsSparse())
+		tiles.MarkCell(x, y);
+}
+
+template<typename T>
+void FluidField<T>::AddFlow(int x, int y, double dx, double dy, double dt)
+{
+	velocity.Current().horizontal[IDX(x, y, size)] += (T)(dt * dx);
+	velocity.Current().vertical[IDX(x, y, size)] += (T)(dt * dy);
+
+	if (IsSparse())
+		tiles.MarkCell(x, y);
+}
+
+template<typename T>
+void FluidField<T>::QueueSource(int x, int y, double dens)
+{
+	if (IsInterior(x, y))
+		pendingSources.push_back({ x, y, dens });
+}
+
+template<typename T>
+void FluidField<T>::QueueForce(int x, int y, double dx, double dy)
+{
+	if (IsInterior(x, y))
+		pendingForces.push_back({ x, y, dx, dy });
+}
+
+template<typename T>
+void FluidField<T>::Snapshot(FluidFrame<T>& frame) const
+{
+	frame.size = size;
+	frame.step = stepCount;
+	frame.density.assign(density.Current().begin(), density.Current().end());
+	frame.velocity = velocity.Current();
+}
+
+template<typename T>
+std::future<bool> FluidField<T>::SaveCheckpoint(const std::string& path) const
+{
+	CheckpointHeader header = MakeCheckpointHeader(size - 2, sizeof(T), stepCount, maxVelocity);
+
+	// The copy is all the caller waits for, the simulation may go on while the file is written
+	std::vector<std::vector<T>> arrays(CHECKPOINT_ARRAYS);
+	for (int generation = 0; generation < 2; generation++)
+	{
+		arrays[generation * CHECKPOINT_CHANNELS + 0].assign(velocity[generation].horizontal.begin(), velocity[generation].horizontal.end());
+		arrays[generation * CHECKPOINT_CHANNELS + 1].assign(velocity[generation].vertical.begin(), velocity[generation].vertical.end());
+		arrays[generation * CHECKPOINT_CHANNELS + 2].assign(density[generation].begin(), density[generation].end());
 	}
 
-	VALUE(field, 0		, 0		) = 0.5 * (VALUE(field, 1, 0	) + VALUE(field, 0, 1	 ));
-	VALUE(field, 0		, N + 1	) = 0.5 * (VALUE(field, 1, N + 1) + VALUE(field, 0, N	 ));
-	VALUE(field, N + 1	, 0		) = 0.5 * (VALUE(field, N, 0	) + VALUE(field, N + 1, 1));
-	VALUE(field, N + 1	, N + 1	) = 0.5 * (VALUE(field, N, N + 1) + VALUE(field, N + 1, N));
+	// The pressures are the initial guesses of the next solves, which the results depend on
+	for (int pass = 0; pass < CHECKPOINT_PRESSURES; pass++)
+		arrays[2 * CHECKPOINT_CHANNELS + pass].assign(pressure[pass].begin(), pressure[pass].end());
+
+	return std::async(std::launch::async, [header, path, arrays = std::move(arrays)]()
+	{
+		const void* pointers[CHECKPOINT_ARRAYS];
+		for (int i = 0; i < CHECKPOINT_ARRAYS; i++)
+			pointers[i] = arrays[i].data();
+
+		return WriteCheckpoint(path, header, pointers);
+	});
 }
 
-void FluidField::Diffuse(double diff, double dt)
+template<typename T>
+bool FluidField<T>::LoadCheckpoint(const CheckpointFile& checkpoint)
+{
+	if (!checkpoint.IsOpen())
+		return false;
+
+	const CheckpointHeader& header = checkpoint.GetHeader();
+	if (header.resolution != (uint32_t)(size - 2) || header.scalarBytes != sizeof(T))
+		return false;
+
+	T* targets[CHECKPOINT_ARRAYS] = {
+		velocity[0].horizontal.data(), velocity[0].vertical.data(), density[0].data(),
+		velocity[1].horizontal.data(), velocity[1].vertical.data(), density[1].data(),
+		pressure[0].data(), pressure[1].data()
+	};
+
+	for (int array = 0; array < CHECKPOINT_ARRAYS; array++)
+	{
+		const T* source = checkpoint.GetArray<T>(array).data();
+		T* target = targets[array];
+
+		// Faulting the mapped pages in is the expensive part, so it is spread over the workers
+		ParallelFor(threadPool.get(), 0, size, [&](int begin, int end)
+		{
+			std::memcpy(target + IDX(0, begin, size), source + IDX(0, begin, size), sizeof(T) * size * (end - begin));
+		});
+	}
+
+	stepCount = header.step;
+	maxVelocity = header.maxVelocity;
+	pendingSources.clear();
+	pendingForces.clear();
+
+	// The loaded state may have anything anywhere, so every tile is checked again
+	if (IsSparse())
+		tiles.ActivateAll();
+
+	return true;
+}
+
+template<typename T>
+bool FluidField<T>::IsInterior(int x, int y) const
+{
+	return (x > 0 && x < this->size - 1 && y > 0 && y < this->size - 1);
+}
+
+template<typename T>
+void FluidField<T>::ApplyBoundaryConditions(BoundaryCondition condition, ArraySpan<T> field)
 {
 	int N = this->size - 2;
-	double a = dt * diff * N * N;
 
-	for (int k = 0; k < 20; k++)
+	// Obstacles touching the box edge are solid cells the ghost cells copy from, so they go first
+	EnforceObstacles(condition, field);
+
+	if (boundaryMode == BoundaryMode::Periodic)
 	{
-		for (int i = 1; i <= N; i++)
+		ParallelFor(threadPool.get(), 1, N + 1, [&](int begin, int end)
 		{
-			for (int j = 1; j <= N; j++)
+			for (int i = begin; i < end; i++)
 			{
-				density[0][IDX(i, j, size)] = (density[1][IDX(i, j, size)] + a * (density[0][IDX(i - 1, j, size)] + density[0][IDX(i + 1, j, size)] + density[0][IDX(i, j - 1, size)] + density[0][IDX(i, j + 1, size)])) / (1 + 4 * a);
+				VALUE(field, 0		, i) = VALUE(field, N, i);
+				VALUE(field, N + 1	, i) = VALUE(field, 1, i);
+				VALUE(field, i		, 0) = VALUE(field, i, N);
+				VALUE(field, i	, N + 1) = VALUE(field, i, 1);
 			}
-		}
+		});
 
-		ApplyBoundaryConditions(BoundaryCondition::Continuous, density[0]);
+		VALUE(field, 0		, 0		) = VALUE(field, N, N);
+		VALUE(field, 0		, N + 1	) = VALUE(field, N, 1);
+		VALUE(field, N + 1	, 0		) = VALUE(field, 1, N);
+		VALUE(field, N + 1	, N + 1	) = VALUE(field, 1, 1);
+		return;
 	}
+
+	const T horizontalSign = (condition == BoundaryCondition::InvertHorizontal) ? -1 : 1;
+	const T verticalSign = (condition == BoundaryCondition::InvertVertical) ? -1 : 1;
+
+	ParallelFor(threadPool.get(), 1, N + 1, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			VALUE(field, 0		, i) = horizontalSign * VALUE(field, 1, i);
+			VALUE(field, N + 1	, i) = horizontalSign * VALUE(field, N, i);
+			VALUE(field, i		, 0) = verticalSign * VALUE(field, i, 1);
+			VALUE(field, i	, N + 1) = verticalSign * VALUE(field, i, N);
+		}
+	});
+
+	const T half = 0.5;
+	VALUE(field, 0		, 0		) = half * (VALUE(field, 1, 0	) + VALUE(field, 0, 1	 ));
+	VALUE(field, 0		, N + 1	) = half * (VALUE(field, 1, N + 1) + VALUE(field, 0, N	 ));
+	VALUE(field, N + 1	, 0		) = half * (VALUE(field, N, 0	) + VALUE(field, N + 1, 1));
+	VALUE(field, N + 1	, N + 1	) = half * (VALUE(field, N, N + 1) + VALUE(field, N + 1, N));
 }
 
-void FluidField::Advect(double dt)
+template<typename T>
+void FluidField<T>::EnforceObstacles(BoundaryCondition condition, ArraySpan<T> field)
 {
-	int N = this->size - 2;
-	double dt0 = dt * N;
+	if (!obstacles)
+		return;
+
+	const T horizontalSign = (condition == BoundaryCondition::InvertHorizontal) ? -1 : 1;
+	const T verticalSign = (condition == BoundaryCondition::InvertVertical) ? -1 : 1;
+	obstacles->Enforce(field.data(), horizontalSign, verticalSign);
+}
 
-	for (int i = 1; i <= N; i++)
+template<typename T>
+bool FluidField<T>::SetObstacles(const ObstacleMask& mask)
+{
+	if (mask.GetResolution() != this->size - 2)
+		return false;
+
+	obstacles = std::make_unique<ObstacleMask>(mask);
+	obstacles->Compile();
+
+	// Whatever was inside the new walls is gone
+	int N = this->size - 2;
+	for (int generation = 0; generation < 2; generation++)
 	{
 		for (int j = 1; j <= N; j++)
 		{
-			double x = i - dt0 * velocity.Current().horizontal[IDX(i, j, size)];
-			double y = j - dt0 * velocity.Current().vertical[IDX(i, j, size)];
-
-			if (x < 0.5)		x = 0.5;
-			if (x > N + 0.5)	x = N + 0.5;
-			if (y < 0.5)		y = 0.5;
-			if (y > N + 0.5)	y = N + 0.5;
-
-			int i0 = (int)x;
-			int i1 = i0 + 1;
-			int j0 = (int)y;
-			int j1 = j0 + 1;
-
-			double s1 = x - i0;
-			double s0 = 1 - s1;
-			double t1 = y - j0;
-			double t0 = 1 - t1;
-
-			density.Current()[IDX(i, j, size)] = s0 * (t0 * density[1][IDX(i0, j0, size)] + t1 * density[1][IDX(i0, j1, size)]) +
-									s1 * (t0 * density[1][IDX(i1, j0, size)] + t1 * density[1][IDX(i1, j1, size)]);
+			for (int i = 1; i <= N; i++)
+			{
+				if (!obstacles->IsSolid(i, j))
+					continue;
+
+				velocity[generation].horizontal[IDX(i, j, size)] = 0;
+				velocity[generation].vertical[IDX(i, j, size)] = 0;
+				density[generation][IDX(i, j, size)] = 0;
+			}
 		}
 	}
 
+	return true;
+}
+
+template<typename T>
+void FluidField<T>::Diffuse(double diff, double dt)
+{
+	PROFILE_SCOPE("Diffuse");
+
+	int N = this->size - 2;
+	double a = dt * diff * N * N;
+
+	if (diffusionMethod == DiffusionMethod::ConjugateGradient && IsPlainBox())
+	{
+		diffusionStats = SolveDiffusion(density[0], density[1], a);
+		ClearInactiveTiles(density[0]);
+		return;
+	}
+
+	if (UsesRedBlack())
+		RelaxRedBlack(density[0], density[1], a, 1 + 4 * a, RELAXATION_SWEEPS);
+	else
+		stencil.Relax(density[0], density[1], a, 1 + 4 * a, RELAXATION_SWEEPS);
+
+	diffusionStats.iterations = RELAXATION_SWEEPS;
+	diffusionStats.residual = RelativeResidual(density[0], density[1], 1 + 4 * a, a);
+}
+
+template<typename T>
+void FluidField<T>::Advect(double dt)
+{
+	PROFILE_SCOPE("Advect");
+
+	int N = this->size - 2;
+	double dt0 = dt * N;
+
+	AdvectionJob<T> job;
+	job.N = N;
+	job.size = size;
+	job.dt0 = (T)dt0;
+	job.columnBegin = 1;
+	job.columnEnd = N + 1;
+	job.periodic = (boundaryMode == BoundaryMode::Periodic);
+	job.u = velocity.Current().horizontal.data();
+	job.v = velocity.Current().vertical.data();
+	job.channels = 1;
+	job.source[0] = density[1].data();
+	job.target[0] = density[0].data();
+
+	ForEachBlock([&](int rowBegin, int rowEnd, int columnBegin, int columnEnd)
+	{
+		AdvectionJob<T> block = job;
+		block.columnBegin = columnBegin;
+		block.columnEnd = columnEnd;
+		advectRows(block, rowBegin, rowEnd);
+	});
+
 	ApplyBoundaryConditions(BoundaryCondition::Continuous, density[0]);
 }
 
-void FluidField::DiffuseVelocity(double visc, double dt)
+template<typename T>
+void FluidField<T>::DiffuseVelocity(double visc, double dt)
 {
+	PROFILE_SCOPE("DiffuseVelocity");
+
 	int N = this->size - 2;
 	double a = dt * visc * N * N;
 
-	for (int k = 0; k < 20; k++)
+	if (diffusionMethod == DiffusionMethod::ConjugateGradient && IsPlainBox())
 	{
-		for (int i = 1; i <= N; i++)
-		{
-			for (int j = 1; j <= N; j++)
-			{
-				velocity.Current().horizontal[IDX(i, j, size)] = (velocity[1].horizontal[IDX(i, j, size)] + a * (velocity[1].horizontal[IDX(i - 1, j, size)] + velocity[1].horizontal[IDX(i + 1, j, size)] + velocity[1].horizontal[IDX(i, j - 1, size)] + velocity[1].horizontal[IDX(i, j + 1, size)])) / (1 + 4 * a);
-				velocity.Current().vertical[IDX(i, j, size)] = (velocity[1].vertical[IDX(i, j, size)] + a * (velocity[1].vertical[IDX(i - 1, j, size)] + velocity[1].vertical[IDX(i + 1, j, size)] + velocity[1].vertical[IDX(i, j - 1, size)] + velocity[1].vertical[IDX(i, j + 1, size)])) / (1 + 4 * a);
-			}
-		}
+		SolverStats horizontal = SolveDiffusion(velocity.Current().horizontal, velocity[1].horizontal, a);
+		SolverStats vertical = SolveDiffusion(velocity.Current().vertical, velocity[1].vertical, a);
+		ClearInactiveTiles(velocity.Current().horizontal);
+		ClearInactiveTiles(velocity.Current().vertical);
+
+		viscosityStats.iterations = horizontal.iterations + vertical.iterations;
+		viscosityStats.residual = std::max(horizontal.residual, vertical.residual);
+		return;
+	}
 
-		ApplyBoundaryConditions(BoundaryCondition::Continuous, velocity.Current().horizontal);
-		ApplyBoundaryConditions(BoundaryCondition::Continuous, velocity.Current().vertical);
+	if (UsesRedBlack())
+	{
+		RelaxRedBlack(velocity.Current().horizontal, velocity[1].horizontal, a, 1 + 4 * a, RELAXATION_SWEEPS);
+		RelaxRedBlack(velocity.Current().vertical, velocity[1].vertical, a, 1 + 4 * a, RELAXATION_SWEEPS);
 	}
+	else
+	{
+		stencil.Relax(velocity.Current().horizontal, velocity[1].horizontal, a, 1 + 4 * a, RELAXATION_SWEEPS);
+		stencil.Relax(velocity.Current().vertical, velocity[1].vertical, a, 1 + 4 * a, RELAXATION_SWEEPS);
+	}
+
+	viscosityStats.iterations = 2 * RELAXATION_SWEEPS;
+	viscosityStats.residual = std::max(
+		RelativeResidual(velocity.Current().horizontal, velocity[1].horizontal, 1 + 4 * a, a),
+		RelativeResidual(velocity.Current().vertical, velocity[1].vertical, 1 + 4 * a, a));
 }
 
-void FluidField::AdvectVelocity(double dt)
+template<typename T>
+void FluidField<T>::AdvectVelocity(double dt)
 {
+	PROFILE_SCOPE("AdvectVelocity");
+
 	int N = this->size - 2;
 	double dt0 = dt * N;
 
-	for (int i = 1; i <= N; i++)
+	AdvectionJob<T> job;
+	job.N = N;
+	job.size = size;
+	job.dt0 = (T)dt0;
+	job.columnBegin = 1;
+	job.columnEnd = N + 1;
+	job.periodic = (boundaryMode == BoundaryMode::Periodic);
+	job.u = velocity[1].horizontal.data();
+	job.v = velocity[1].vertical.data();
+	job.channels = 2;
+	job.source[0] = velocity[1].horizontal.data();
+	job.source[1] = velocity[1].vertical.data();
+	job.target[0] = velocity.Current().horizontal.data();
+	job.target[1] = velocity.Current().vertical.data();
+
+	ForEachBlock([&](int rowBegin, int rowEnd, int columnBegin, int columnEnd)
 	{
-		for (int j = 1; j <= N; j++)
-		{
-			double x = i - dt0 * velocity[1].horizontal[IDX(i, j, size)];
-			double y = j - dt0 * velocity[1].vertical[IDX(i, j, size)];
+		AdvectionJob<T> block = job;
+		block.columnBegin = columnBegin;
+		block.columnEnd = columnEnd;
+		advectRows(block, rowBegin, rowEnd);
+	});
 
-			if (x < 0.5)		x = 0.5;
-			if (x > N + 0.5)	x = N + 0.5;
-			if (y < 0.5)		y = 0.5;
-			if (y > N + 0.5)	y = N + 0.5;
+	ApplyBoundaryConditions(BoundaryCondition::InvertHorizontal, velocity.Current().horizontal);
+	ApplyBoundaryConditions(BoundaryCondition::InvertVertical, velocity.Current().vertical);
+}
 
-			int i0 = (int)x;
-			int i1 = i0 + 1;
-			int j0 = (int)y;
-			int j1 = j0 + 1;
+template<typename T>
+void FluidField<T>::VelocityStep(double visc, double dt)
+{
+	PROFILE_SCOPE("VelocityStep");
 
-			double s1 = x - i0;
-			double s0 = 1 - s1;
-			double t1 = y - j0;
-			double t0 = 1 - t1;
+	// Decaying single precision values spend a long time as slow denormals
+	ScopedFlushDenormals flush(std::is_same<T, float>::value);
 
-			velocity.Current().horizontal[IDX(i, j, size)] = s0 * (t0 * velocity[1].horizontal[IDX(i0, j0, size)] + t1 * velocity[1].horizontal[IDX(i0, j1, size)]) +
-				s1 * (t0 * velocity[1].horizontal[IDX(i1, j0, size)] + t1 * velocity[1].horizontal[IDX(i1, j1, size)]);
+	ApplyPendingForces(dt);
 
-			velocity.Current().vertical[IDX(i, j, size)] = s0 * (t0 * velocity[1].vertical[IDX(i0, j0, size)] + t1 * velocity[1].vertical[IDX(i0, j1, size)]) +
-				s1 * (t0 * velocity[1].vertical[IDX(i1, j0, size)] + t1 * velocity[1].vertical[IDX(i1, j1, size)]);
-		}
-	}
+	velocity.Evolve([&]() { DiffuseVelocity(visc, dt); });
+	PROFILE_COUNTER("ViscosityIterations", viscosityStats.iterations);
+	PROFILE_COUNTER("ViscosityResidual", viscosityStats.residual);
+
+	Project(0);
+	velocity.Evolve([&]() { AdvectVelocity(dt); });
+	Project(1);
+
+	// vel->RecalculateMagnitude();
+}
+
+template<typename T>
+void FluidField<T>::Project(int pass)
+{
+	PROFILE_SCOPE("Project");
+
+	int N = this->size - 2;
+	T h = (T)(1.0 / (double)N);
+
+	ForEachBlock([&](int rowBegin, int rowEnd, int columnBegin, int columnEnd)
+	{
+		kernels.divergence(velocity.Current().horizontal.data(), velocity.Current().vertical.data(),
+			divergence.data(), h, size, rowBegin, rowEnd, columnBegin, columnEnd);
+	});
+
+	ApplyBoundaryConditions(BoundaryCondition::Continuous, divergence);
+
+	// The pressure of the previous step is the initial guess, except in tiles that are quiet and only hold stale values
+	if (!pressureWarmStart)
+		std::fill(pressure[pass].begin(), pressure[pass].end(), (T)0);
+	else if (IsSparse())
+		ClearInactiveTiles(pressure[pass]);
+
+	SolvePressure(pressure[pass]);
+	PROFILE_COUNTER("PressureIterations", pressureStats.iterations);
+	PROFILE_COUNTER("PressureResidual", pressureStats.residual);
+
+	// The fastest component is picked up while the velocity is written anyway, for the timestep controller
+	maxVelocity = MaxOverBlocks([&](int rowBegin, int rowEnd, int columnBegin, int columnEnd)
+	{
+		return (double)kernels.subtractGradient(velocity.Current().horizontal.data(), velocity.Current().vertical.data(),
+			pressure[pass].data(), h, size, rowBegin, rowEnd, columnBegin, columnEnd);
+	});
 
 	ApplyBoundaryConditions(BoundaryCondition::InvertHorizontal, velocity.Current().horizontal);
 	ApplyBoundaryConditions(BoundaryCondition::InvertVertical, velocity.Current().vertical);
+
+	// The walls have to be closed again before anything is advected along the new velocity.
+	// Solid cells away from the walls only ever see the gradient, so they are reset to rest.
+	if (obstacles)
+	{
+		EnforceObstacles(BoundaryCondition::InvertHorizontal, velocity.Current().horizontal);
+		EnforceObstacles(BoundaryCondition::InvertVertical, velocity.Current().vertical);
+		obstacles->ClearInterior(velocity.Current().horizontal.data());
+		obstacles->ClearInterior(velocity.Current().vertical.data());
+	}
 }
 
-void FluidField::VelocityStep(double visc, double dt)
+template<typename T>
+void FluidField<T>::SolvePressure(FieldVector<T>& pressure)
 {
-	// AddFlow(15, 30, 3000.0, 0.0, dt);
-	// AddFlow(45, 30, -3000.0, 0.0, dt);
-	// AddFlow(30, 15, 0.0, 3000.0, dt);
+	PROFILE_SCOPE("SolvePressure");
+
+	if (projectionMethod == ProjectionMethod::Spectral && spectral && boundaryMode == BoundaryMode::Periodic && !obstacles)
+	{
+		spectral->Solve(pressure, divergence);
+		ApplyBoundaryConditions(BoundaryCondition::Continuous, pressure);
+
+		pressureStats.iterations = 1;
+		pressureStats.residual = RelativeResidual(pressure, divergence, 4.0, 1.0);
+		return;
+	}
 
-	int x, y;
-	Uint32 buttons = SDL_GetMouseState(&x, &y);
-	int dx = (double)(this->size - 2) / (double)(990 - 10) * (double)(x - 10);
-	int dy = (double)(this->size - 2) / (double)(990 - 10) * (double)(y - 10);
+	if (projectionMethod == ProjectionMethod::Multigrid && IsPlainBox())
+	{
+		int cycles = (projectionMaxIterations > 0) ? projectionMaxIterations : DEFAULT_MULTIGRID_CYCLES;
+		pressureStats = multigrid->Solve(pressure, divergence, projectionTolerance, cycles, multigridCycle);
+		ClearInactiveTiles(pressure);
+		return;
+	}
 
-	if (buttons & SDL_BUTTON_RMASK)
+	if (projectionMethod == ProjectionMethod::ConjugateGradient && IsPlainBox())
 	{
-		AddFlow(lastMouseX, lastMouseY, (dx - lastMouseX) * 500.0, (dy - lastMouseY) * 500.0, dt);
+		int iterations = (projectionMaxIterations > 0) ? projectionMaxIterations : DEFAULT_PRESSURE_CG_ITERATIONS;
+		pressureStats = conjugateGradient->Solve(pressure, divergence, 4.0, 1.0, projectionTolerance, iterations);
+		ApplyBoundaryConditions(BoundaryCondition::Continuous, pressure);
+		ClearInactiveTiles(pressure);
+		return;
 	}
 
-	lastMouseX = dx;
-	lastMouseY = dy;
+	// Gauss-Seidel on 4 p(i, j) - (sum of the four neighbouring p) = divergence(i, j). The original
+	// relaxation averaged the neighbours of the divergence instead of those of the pressure, which
+	// never solved this system, so the default projection no longer matches the original solver.
+	// The residual costs about as much as a sweep, so it is only checked every few sweeps.
+	int maxSweeps = (projectionMaxIterations > 0) ? projectionMaxIterations : RELAXATION_SWEEPS;
+	pressureStats = SolverStats();
+	pressureStats.residual = RelativeResidual(pressure, divergence, 4.0, 1.0);
 
-	velocity.Evolve(std::bind(&FluidField::DiffuseVelocity, this, visc, dt));
-	Project();
-	velocity.Evolve(std::bind(&FluidField::AdvectVelocity, this, dt));
-	Project();
+	while (pressureStats.residual > projectionTolerance && pressureStats.iterations < maxSweeps)
+	{
+		int sweeps = std::min(PRESSURE_CHECK_INTERVAL, maxSweeps - pressureStats.iterations);
 
-	// vel->RecalculateMagnitude();
+		if (UsesRedBlack())
+			RelaxRedBlack(pressure, divergence, 1.0, 4.0, sweeps);
+		else
+			stencil.Relax(pressure, divergence, 1.0, 4.0, sweeps);
+
+		pressureStats.iterations += sweeps;
+		pressureStats.residual = RelativeResidual(pressure, divergence, 4.0, 1.0);
+	}
 }
 
-void FluidField::Project()
+template<typename T>
+SolverStats FluidField<T>::SolveDiffusion(ArraySpan<T> field, ArraySpan<const T> previous, double a)
 {
-	int N = this->size - 2;
-	double h = 1.0 / (double)N;
+	// The previous state is a much better initial guess than whatever the buffer held two generations ago
+	std::copy(previous.begin(), previous.end(), field.begin());
 
-	for (int i = 1; i <= N; i++)
+	int iterations = (diffusionMaxIterations > 0) ? diffusionMaxIterations : DEFAULT_DIFFUSION_CG_ITERATIONS;
+	SolverStats stats = conjugateGradient->Solve(field, previous, 1 + 4 * a, a, diffusionTolerance, iterations);
+	ApplyBoundaryConditions(BoundaryCondition::Continuous, field);
+
+	return stats;
+}
+
+template<typename T>
+double FluidField<T>::RelativeResidual(ArraySpan<const T> x, ArraySpan<const T> b, double diagonal, double offDiagonal) const
+{
+	double residualSum = SumOverBlocks([&](int rowBegin, int rowEnd, int columnBegin, int columnEnd)
 	{
-		for (int j = 1; j <= N; j++)
+		return kernels.squaredResidual(x.data(), b.data(), diagonal, offDiagonal, size, rowBegin, rowEnd, columnBegin, columnEnd);
+	});
+
+	double rhsSum = SumOverBlocks([&](int rowBegin, int rowEnd, int columnBegin, int columnEnd)
+	{
+		return kernels.squaredNorm(b.data(), size, rowBegin, rowEnd, columnBegin, columnEnd);
+	});
+
+	return (rhsSum > 0.0) ? std::sqrt(residualSum / rhsSum) : 0.0;
+}
+
+template<typename T>
+void FluidField<T>::RelaxRedBlack(ArraySpan<T> x, ArraySpan<const T> b, T a, T c, int sweeps)
+{
+	// Cells of one color only depend on cells of the other color, so each half sweep
+	// can be split across threads or tiles without changing the result
+	for (int k = 0; k < sweeps; k++)
+	{
+		for (int color = 0; color < 2; color++)
 		{
-			velocity[1].vertical[IDX(i, j, size)] = -0.5 * h * (velocity.Current().horizontal[IDX(i + 1, j, size)] - velocity.Current().horizontal[IDX(i - 1, j, size)] + velocity.Current().vertical[IDX(i, j + 1, size)] - velocity.Current().vertical[IDX(i, j - 1, size)]);
-			velocity[1].horizontal[IDX(i, j, size)] = 0;
+			ForEachBlock([&](int rowBegin, int rowEnd, int columnBegin, int columnEnd)
+			{
+				kernels.relaxColor(x.data(), b.data(), a, c, color, size, rowBegin, rowEnd, columnBegin, columnEnd);
+			});
 		}
+
+		ApplyBoundaryConditions(BoundaryCondition::Continuous, x);
+	}
+}
+
+template<typename T>
+void FluidField<T>::SetThreadCount(int threads)
+{
+	if (threads > 0)
+		threadPool = std::make_unique<ThreadPool>(threads);
+	else
+		threadPool.reset();
+
+	// Copies the fields into memory that the workers touch first, so on NUMA machines
+	// the rows every worker relaxes end up in its local memory
+	if (threadPool)
+	{
+		ScopedFirstTouch touch(threadPool.get());
+		velocity = RetentiveObject<VectorField<T>, 1>(velocity);
+		density = RetentiveArray<T, 1>(density);
+		pressure[0] = FieldVector<T>(pressure[0]);
+		pressure[1] = FieldVector<T>(pressure[1]);
+		divergence = FieldVector<T>(divergence);
+	}
+
+	if (multigrid)
+		multigrid->SetThreadPool(threadPool.get());
+
+	if (conjugateGradient)
+		conjugateGradient->SetThreadPool(threadPool.get());
+
+	if (spectral)
+		spectral->SetThreadPool(threadPool.get());
+}
+
+template<typename T>
+void FluidField<T>::SetProjectionMethod(ProjectionMethod method, MultigridCycle cycle)
+{
+	projectionMethod = method;
+	multigridCycle = cycle;
+
+	ScopedFirstTouch touch(threadPool.get());
+
+	// The grid hierarchy and work vectors are only built once, the first time they are needed
+	if (method == ProjectionMethod::Multigrid && !multigrid)
+	{
+		multigrid = std::make_unique<Multigrid<T>>(this->size - 2);
+		multigrid->SetThreadPool(threadPool.get());
+	}
+
+	if (method == ProjectionMethod::ConjugateGradient && !conjugateGradient)
+	{
+		conjugateGradient = std::make_unique<ConjugateGradient<T>>(this->size - 2);
+		conjugateGradient->SetThreadPool(threadPool.get());
+	}
+
+	if (method == ProjectionMethod::Spectral && !spectral && SpectralPoisson<T>::SupportsResolution(this->size - 2))
+	{
+		spectral = std::make_unique<SpectralPoisson<T>>(this->size - 2);
+		spectral->SetThreadPool(threadPool.get());
+	}
+}
+
+template<typename T>
+void FluidField<T>::SetAdvectionKernel(AdvectionKernel kernel)
+{
+	advectionKernel = ResolveAdvectionKernel(kernel);
+	advectRows = GetAdvectRowsFunction<T>(advectionKernel);
+}
+
+template<typename T>
+void FluidField<T>::SetDiffusionMethod(DiffusionMethod method)
+{
+	diffusionMethod = method;
+
+	if (method == DiffusionMethod::ConjugateGradient && !conjugateGradient)
+	{
+		ScopedFirstTouch touch(threadPool.get());
+		conjugateGradient = std::make_unique<ConjugateGradient<T>>(this->size - 2);
+		conjugateGradient->SetThreadPool(threadPool.get());
 	}
+}
+
+template<typename T>
+void FluidField<T>::SetProjectionTolerance(double tolerance, int maxIterations)
+{
+	projectionTolerance = tolerance;
+	projectionMaxIterations = maxIterations;
+}
+
+template<typename T>
+void FluidField<T>::SetDiffusionTolerance(double tolerance, int maxIterations)
+{
+	diffusionTolerance = tolerance;
+	diffusionMaxIterations = maxIterations;
+}
+
+template<typename T>
+void FluidField<T>::DensityStep(double diff, double dt)
+{
+	PROFILE_SCOPE("DensityStep");
+
+	ScopedFlushDenormals flush(std::is_same<T, float>::value);
+
+	ApplyPendingSources(dt);
+
+	density.Evolve([&]() { Diffuse(diff, dt); });
+	PROFILE_COUNTER("DiffusionIterations", diffusionStats.iterations);
+	PROFILE_COUNTER("DiffusionResidual", diffusionStats.residual);
+
+	density.Evolve([&]() { Advect(dt); });
+
+	// Diffusion also relaxes the cells inside of obstacles, which the fluid never sees
+	if (obstacles)
+		obstacles->ClearInterior(density.Current().data());
+}
+
+template<typename T>
+void FluidField<T>::Step(double visc, double diff, double dt)
+{
+	PROFILE_SCOPE("Step");
+
+	stepCount++;
+
+	if (IsSparse())
+		UpdateActiveTiles(dt);
+
+	if (stepMode == StepMode::Split)
+	{
+		VelocityStep(visc, dt);
+		DensityStep(diff, dt);
+		return;
+	}
+
+	ScopedFlushDenormals flush(std::is_same<T, float>::value);
+
+	ApplyPendingForces(dt);
+	ApplyPendingSources(dt);
+
+	velocity.Evolve([&]() { DiffuseVelocity(visc, dt); });
+	PROFILE_COUNTER("ViscosityIterations", viscosityStats.iterations);
+	PROFILE_COUNTER("ViscosityResidual", viscosityStats.residual);
+
+	Project(0);
+	density.Evolve([&]() { Diffuse(diff, dt); });
+	PROFILE_COUNTER("DiffusionIterations", diffusionStats.iterations);
+	PROFILE_COUNTER("DiffusionResidual", diffusionStats.residual);
+
+	// Both fields move on a generation, then get advected along the same backtrace
+	velocity.Evolve([&]() { density.Evolve([&]() { AdvectFused(dt); }); });
+	Project(1);
+
+	if (obstacles)
+		obstacles->ClearInterior(density.Current().data());
+}
+
+template<typename T>
+void FluidField<T>::AdvectFused(double dt)
+{
+	PROFILE_SCOPE("AdvectFused");
+
+	int N = this->size - 2;
+	double dt0 = dt * N;
 
-	ApplyBoundaryConditions(BoundaryCondition::Continuous, velocity[1].horizontal);
-	ApplyBoundaryConditions(BoundaryCondition::Continuous, velocity[1].vertical);
+	AdvectionJob<T> job;
+	job.N = N;
+	job.size = size;
+	job.dt0 = (T)dt0;
+	job.columnBegin = 1;
+	job.columnEnd = N + 1;
+	job.periodic = (boundaryMode == BoundaryMode::Periodic);
+	job.u = velocity[1].horizontal.data();
+	job.v = velocity[1].vertical.data();
+	job.channels = 3;
+	job.source[0] = velocity[1].horizontal.data();
+	job.source[1] = velocity[1].vertical.data();
+	job.source[2] = density[1].data();
+	job.target[0] = velocity.Current().horizontal.data();
+	job.target[1] = velocity.Current().vertical.data();
+	job.target[2] = density.Current().data();
+
+	ForEachBlock([&](int rowBegin, int rowEnd, int columnBegin, int columnEnd)
+	{
+		AdvectionJob<T> block = job;
+		block.columnBegin = columnBegin;
+		block.columnEnd = columnEnd;
+		advectRows(block, rowBegin, rowEnd);
+	});
+
+	ApplyBoundaryConditions(BoundaryCondition::InvertHorizontal, velocity.Current().horizontal);
+	ApplyBoundaryConditions(BoundaryCondition::InvertVertical, velocity.Current().vertical);
+	ApplyBoundaryConditions(BoundaryCondition::Continuous, density.Current());
+}
+
+template<typename T>
+void FluidField<T>::ApplyPendingForces(double dt)
+{
+	for (const FluidForce& force : pendingForces)
+		AddFlow(force.x, force.y, force.dx, force.dy, dt);
+
+	pendingForces.clear();
+}
+
+template<typename T>
+void FluidField<T>::SetSparseThreshold(double threshold)
+{
+	// Inactive tiles are assumed to be empty, which a dense state doesn't guarantee
+	if (threshold > 0.0 && !IsSparse())
+		tiles.ActivateAll();
+
+	sparseThreshold = std::max(threshold, 0.0);
+}
+
+template<typename T>
+void FluidField<T>::UpdateActiveTiles(double dt)
+{
+	PROFILE_SCOPE("UpdateActiveTiles");
+
+	int N = this->size - 2;
+	const T threshold = (T)sparseThreshold;
 
-	for (int k = 0; k < 20; k++)
+	// Inactive tiles are empty, so only the tiles that were active can be above the threshold.
+	// Anything else becomes active through the inputs of this step or the halo.
+	const std::vector<Tile>& active = tiles.GetActive();
+	tileBusy.assign(active.size(), 0);
+
+	ParallelFor(threadPool.get(), 0, (int)active.size(), [&](int begin, int end)
 	{
-		for (int i = 1; i <= N; i++)
+		for (int t = begin; t < end; t++)
 		{
-			for (int j = 1; j <= N; j++)
+			const Tile& tile = active[t];
+			T largest = 0;
+
+			for (int j = tile.rowBegin; j < tile.rowEnd; j++)
 			{
-				velocity[1].horizontal[IDX(i, j, size)] = (velocity[1].vertical[IDX(i, j, size)] + velocity[1].vertical[IDX(i - 1, j, size)] + velocity[1].vertical[IDX(i + 1, j, size)] + velocity[1].vertical[IDX(i, j - 1, size)] + velocity[1].vertical[IDX(i, j + 1, size)]) / 4.0;
+				for (int i = tile.columnBegin; i < tile.columnEnd; i++)
+				{
+					largest = std::max(largest, std::abs(density.Current()[IDX(i, j, size)]));
+					largest = std::max(largest, std::abs(velocity.Current().horizontal[IDX(i, j, size)]));
+					largest = std::max(largest, std::abs(velocity.Current().vertical[IDX(i, j, size)]));
+				}
 			}
+
+			tileBusy[t] = (largest > threshold);
 		}
+	});
+
+	for (size_t t = 0; t < active.size(); t++)
+		if (tileBusy[t])
+			tiles.Mark(active[t].x, active[t].y);
+
+	for (const FluidSource& source : pendingSources)
+		tiles.MarkCell(source.x, source.y);
 
-		ApplyBoundaryConditions(BoundaryCondition::Continuous, velocity[1].horizontal);
+	// The forces of this step speed the flow up before it is advected
+	double fastest = maxVelocity;
+	for (const FluidForce& force : pendingForces)
+	{
+		tiles.MarkCell(force.x, force.y);
+		fastest = std::max(fastest, maxVelocity + dt * std::max(std::abs(force.dx), std::abs(force.dy)));
 	}
 
-	for (int i = 1; i <= N; i++)
+	// A tile of halo covers diffusion and the projection, advection may need more
+	int halo = 1 + (int)(fastest * dt * N / ACTIVE_TILE_SIZE);
+	tiles.Dilate(halo);
+	tiles.Commit();
+
+	// Both generations, so the tile is empty whichever one is current when it wakes up again
+	for (const Tile& tile : tiles.GetReleased())
 	{
-		for (int j = 1; j <= N; j++)
+		for (int generation = 0; generation < 2; generation++)
 		{
-			velocity.Current().horizontal[IDX(i, j, size)] -= 0.5 * (velocity[1].horizontal[IDX(i + 1, j, size)] - velocity[1].horizontal[IDX(i - 1, j, size)]) / h;
-			velocity.Current().vertical[IDX(i, j, size)] -= 0.5 * (velocity[1].horizontal[IDX(i, j + 1, size)] - velocity[1].horizontal[IDX(i, j - 1, size)]) / h;
+			ClearTile(velocity[generation].horizontal, tile);
+			ClearTile(velocity[generation].vertical, tile);
+			ClearTile(density[generation], tile);
 		}
 	}
 
-	ApplyBoundaryConditions(BoundaryCondition::InvertHorizontal, velocity[1].horizontal);
-	ApplyBoundaryConditions(BoundaryCondition::InvertVertical, velocity[1].vertical);
+	PROFILE_COUNTER("ActiveTiles", tiles.GetActive().size());
 }
 
-void FluidField::DensityStep(double diff, double dt)
+template<typename T>
+void FluidField<T>::ClearTile(ArraySpan<T> field, const Tile& tile)
 {
-	// AddSource(50, 3, 60.0, dt);
-	// AddSource(3, 50, 60.0, dt);
-
-	int x, y;
-	Uint32 buttons = SDL_GetMouseState(&x, &y);
-	int dx = (double)(this->size - 2) / (double)(990 - 10) * (double)(x - 10);
-	int dy = (double)(this->size - 2) / (double)(990 - 10) * (double)(y - 10);
-	
+	int N = this->size - 2;
 
-	if (buttons & SDL_BUTTON_LMASK)
-		if(dx > 0 && dx < this->size - 1 && dy > 0 && dy < this->size - 1)
-			AddSource(dx, dy, 100.0, dt);
+	// Tiles on the border take their ghost cells with them
+	int columnBegin = (tile.columnBegin == 1) ? 0 : tile.columnBegin;
+	int columnEnd = (tile.columnEnd == N + 1) ? N + 2 : tile.columnEnd;
+	int rowBegin = (tile.rowBegin == 1) ? 0 : tile.rowBegin;
+	int rowEnd = (tile.rowEnd == N + 1) ? N + 2 : tile.rowEnd;
 
-	density.Evolve(std::bind(&FluidField::Diffuse, this, diff, dt));
-	density.Evolve(std::bind(&FluidField::Advect, this, dt));
+	for (int j = rowBegin; j < rowEnd; j++)
+		std::fill(field.begin() + IDX(columnBegin, j, size), field.begin() + IDX(columnEnd, j, size), (T)0);
 }
 
-void FluidField::Draw(SDL_Renderer* renderer, const SDL_Rect& target)
+template<typename T>
+void FluidField<T>::ClearInactiveTiles(ArraySpan<T> field)
 {
-	double cellWidth = (double)(target.w - target.x) / (double)this->size;
-	double cellHeight = (double)(target.h - target.y) / (double)this->size;
-
-	SDL_FRect vectorCenterSquare;
-	vectorCenterSquare.w = cellWidth;
-	vectorCenterSquare.h = cellHeight;
+	if (!IsSparse())
+		return;
 
-	for (int y = 0; y < this->size; y++)
+	// The whole-grid solvers spread their results into the quiet tiles, which have to stay empty
+	const std::vector<Tile>& inactive = tiles.GetInactive();
+	ParallelFor(threadPool.get(), 0, (int)inactive.size(), [&](int begin, int end)
 	{
-		for (int x = 0; x < this->size; x++)
-		{
-			double densityVal = std::min(density.Current()[IDX(x, y, size)], 1.0);
-			SDL_SetRenderDrawColor(renderer, densityVal * 255, densityVal * 255, densityVal * 255, 255);
+		for (int t = begin; t < end; t++)
+			ClearTile(field, inactive[t]);
+	});
+}
 
-			vectorCenterSquare.x = (double)target.x + cellWidth * x;	// cellWidth * x + cellWidth / 2 - cellWidth / 10
-			vectorCenterSquare.y = (double)target.y + cellHeight * y;
-			SDL_RenderFillRectF(renderer, &vectorCenterSquare);
-		}
-	}
+template<typename T>
+void FluidField<T>::ApplyPendingSources(double dt)
+{
+	for (const FluidSource& source : pendingSources)
+		AddSource(source.x, source.y, source.density, dt);
 
-	velocity.Current().Draw(renderer, target);
+	pendingSources.clear();
 }
+
+template class FluidField<float>;
+template class FluidField<double>;
@@ -1,13 +1,25 @@
 #pragma once
 
+#include <future>
+#include <memory>
+#include <string>
 #include <vector>
+#include "ActiveTiles.hpp"
+#include "AdvectionKernels.hpp"
+#include "ArraySpan.hpp"
+#include "ConjugateGradient.hpp"
+#include "FluidFrame.hpp"
+#include "GridKernels.hpp"
+#include "Multigrid.hpp"
+#include "ObstacleMask.hpp"
+#include "SolverStats.hpp"
+#include "SpectralPoisson.hpp"
+#include "StencilEngine.hpp"
+#include "ThreadPool.hpp"
 #include "VectorField.hpp"
 #include "RetentiveArray.hpp"
 #include "RetentiveObject.hpp"
 
-struct SDL_Renderer;
-struct SDL_Rect;
-
 enum class BoundaryCondition
 {
 	Continuous,
@@ -15,6 +27,53 @@ enum class BoundaryCondition
 	InvertHorizontal
 };
 
+enum class BoundaryMode
+{
+	Closed,
+	Periodic
+};
+
+enum class ProjectionMethod
+{
+	GaussSeidel,
+	Multigrid,
+	ConjugateGradient,
+	Spectral
+};
+
+enum class DiffusionMethod
+{
+	GaussSeidel,
+	ConjugateGradient
+};
+
+enum class StepMode
+{
+	Split,
+	Fused
+};
+
+class CheckpointFile;
+
+struct FluidSource
+{
+	int x, y;
+	double density;
+};
+
+struct FluidForce
+{
+	int x, y;
+	double dx, dy;
+};
+
+/**
+ * Stam-style stable fluid solver on a (N + 2)x(N + 2) grid with ghost cells.
+ * The fields are stored and relaxed in the scalar type T, which is instantiated
+ * for float and double. float halves the memory traffic of every sweep and
+ * doubles the SIMD width, at the cost of precision.
+ */
+template<typename T>
 class FluidField
 {
 public:
@@ -23,7 +82,11 @@ public:
 
 	void AddSource(int x, int y, double density, double dt);
 	void AddFlow(int x, int y, double dx, double dy, double dt);
-	void ApplyBoundaryConditions(BoundaryCondition condition, std::vector<double>& field);
+	void ApplyBoundaryConditions(BoundaryCondition condition, ArraySpan<T> field);
+
+	// Inputs are queued and consumed by the next Step, or DensityStep/VelocityStep respectively
+	void QueueSource(int x, int y, double density);
+	void QueueForce(int x, int y, double dx, double dy);
 
 	void Diffuse(double diff, double dt);
 	void Advect(double dt);
@@ -32,15 +95,177 @@ public:
 	void DiffuseVelocity(double visc, double dt);
 	void AdvectVelocity(double dt);
 	void VelocityStep(double visc, double dt);
-	void Project();
 
-	void Draw(SDL_Renderer* renderer, const SDL_Rect& target);
+	// A step projects twice, after diffusion (pass 0) and after advection (pass 1). The two
+	// pressures differ a lot, so each pass keeps its own as the initial guess of the next step.
+	void Project(int pass = 0);
+
+	// Advances both velocity and density by one timestep, as selected by the step mode
+	void Step(double visc, double diff, double dt);
+
+	// Split runs VelocityStep and then DensityStep. Fused diffuses both fields first, then
+	// traces every cell back once and advects u, v and density together in a single pass.
+	// The density is therefore carried by the velocity from before the final projection.
+	void SetStepMode(StepMode mode) { stepMode = mode; }
+	StepMode GetStepMode() const { return stepMode; }
+
+	// Spectral solves the pressure equation exactly with FFTs. It needs periodic boundaries
+	// and a power-of-two resolution, and falls back to Gauss-Seidel otherwise.
+	void SetProjectionMethod(ProjectionMethod method, MultigridCycle cycle = MultigridCycle::V);
+	void SetDiffusionMethod(DiffusionMethod method);
+
+	// Closed boxes have walls on all four sides. Periodic ones wrap around, so whatever
+	// leaves on one side comes back in on the other. Multigrid and conjugate gradient only
+	// know about walls, so periodic systems are relaxed with red-black Gauss-Seidel unless
+	// the spectral projection is selected. Sparse mode is off while the box is periodic.
+	void SetBoundaryMode(BoundaryMode mode) { boundaryMode = mode; }
+	BoundaryMode GetBoundaryMode() const { return boundaryMode; }
+
+	// 0 runs everything on the calling thread. Any positive count switches to the threaded
+	// mode, which uses red-black ordering for the relaxation sweeps and gives the same
+	// results for the same thread count.
+	void SetThreadCount(int threads);
+	int GetThreadCount() const { return threadPool ? threadPool->GetThreadCount() : 0; }
+	ThreadPool* GetThreadPool() const { return threadPool.get(); }
+
+	// Auto picks the widest SIMD kernel the CPU supports. All kernels give identical results.
+	void SetAdvectionKernel(AdvectionKernel kernel);
+	AdvectionKernel GetAdvectionKernel() const { return advectionKernel; }
+
+	// The projection, red-black and residual loops are compiled for a few fixed resolutions.
+	// They are picked automatically when the resolution matches; turning them off runs the
+	// runtime-size loops instead, which give the same results.
+	void SetSizeSpecialization(bool enabled) { kernels = GetGridKernels<T>(this->size - 2, enabled); }
+	bool IsSizeSpecialized() const { return kernels.resolution > 0; }
+
+	// The iteration cap counts sweeps for Gauss-Seidel, cycles for multigrid and iterations
+	// for conjugate gradient. A cap of 0 picks the default of the selected method. Every
+	// pressure solve stops as soon as its residual is below the tolerance.
+	void SetProjectionTolerance(double tolerance, int maxIterations = 0);
+	void SetDiffusionTolerance(double tolerance, int maxIterations = 0);
+
+	// The pressure of the previous step is kept as the initial guess of the next solve,
+	// which is usually close already. Turning this off starts every solve from zero.
+	void SetPressureWarmStart(bool enabled) { pressureWarmStart = enabled; }
+	bool GetPressureWarmStart() const { return pressureWarmStart; }
+
+	// Cost of the most recent solve of each system (the velocity one covers both components)
+	const SolverStats& GetPressureStats() const { return pressureStats; }
+	const SolverStats& GetViscosityStats() const { return viscosityStats; }
+	const SolverStats& GetDiffusionStats() const { return diffusionStats; }
+
+	// A positive threshold switches to sparse mode, in which the kernels only visit tiles
+	// of ACTIVE_TILE_SIZE^2 cells that hold density or velocity above the threshold, plus a
+	// halo wide enough that advection can't carry anything past it. The map is refreshed at
+	// the start of every Step, and tiles that fall quiet are cleared, so anything below the
+	// threshold is lost. Gauss-Seidel relaxes only the active tiles, in the red-black order
+	// of the threaded mode. Multigrid and conjugate gradient still solve on the whole grid,
+	// and their results are cleared outside of the active tiles afterwards.
+	// 0 turns sparse mode off again.
+	void SetSparseThreshold(double threshold);
+	double GetSparseThreshold() const { return sparseThreshold; }
+
+	// Solid cells inside the box, with free-slip walls. The mask must have the resolution of
+	// the field, otherwise it is rejected. Multigrid and conjugate gradient don't know about
+	// obstacles, so while a mask is set all systems are relaxed with red-black Gauss-Seidel.
+	bool SetObstacles(const ObstacleMask& mask);
+	void ClearObstacles() { obstacles.reset(); }
+	const ObstacleMask* GetObstacles() const { return obstacles.get(); }
+
+	// Share of the grid the kernels worked on during the most recent step
+	double GetActiveFraction() const { return IsSparse() ? tiles.GetActiveFraction() : 1.0; }
+
+	// Largest velocity component left behind by the most recent projection, in domain lengths per second
+	double GetMaxVelocity() const { return maxVelocity; }
+
+	int GetSize() const { return size; }
+	int GetResolution() const { return size - 2; }
+	ArraySpan<const T> GetDensity() const { return density.Current(); }
+	const VectorField<T>& GetVelocity() const { return velocity.Current(); }
+
+	// Copies the current state into `frame`, reusing its storage once it has the right size
+	void Snapshot(FluidFrame<T>& frame) const;
+
+	// Number of completed calls to Step
+	long long GetStepCount() const { return stepCount; }
+
+	// Copies both generations of the state and writes them to `path` in the background.
+	// The future reports whether the file was written; destroying it waits for the write.
+	std::future<bool> SaveCheckpoint(const std::string& path) const;
+
+	// Restores a checkpoint of the same resolution and scalar type. Stepping on from there
+	// gives the same results as the run that saved it. Queued inputs are discarded.
+	bool LoadCheckpoint(const CheckpointFile& checkpoint);
+
+private:
+	bool IsInterior(int x, int y) const;
+	bool IsSparse() const { return sparseThreshold > 0.0 && boundaryMode == BoundaryMode::Closed; }
+	bool IsPlainBox() const { return boundaryMode == BoundaryMode::Closed && !obstacles; }
+	bool UsesRedBlack() const { return threadPool || IsSparse() || !IsPlainBox(); }
+	void EnforceObstacles(BoundaryCondition condition, ArraySpan<T> field);
+	void UpdateActiveTiles(double dt);
+	void ClearTile(ArraySpan<T> field, const Tile& tile);
+	void ClearInactiveTiles(ArraySpan<T> field);
+
+	// Calls task(rowBegin, rowEnd, columnBegin, columnEnd) for blocks of interior cells, spread over
+	// the workers. Those are whole rows in dense mode, and the spans of active tiles in sparse mode.
+	template<typename Task> void ForEachBlock(Task&& task);
+	template<typename Task> double SumOverBlocks(Task&& task) const;
+	template<typename Task> double MaxOverBlocks(Task&& task) const;
+
+	void ApplyPendingForces(double dt);
+	void ApplyPendingSources(double dt);
+	void AdvectFused(double dt);
+	void SolvePressure(FieldVector<T>& pressure);
+	SolverStats SolveDiffusion(ArraySpan<T> field, ArraySpan<const T> previous, double a);
+	double RelativeResidual(ArraySpan<const T> x, ArraySpan<const T> b, double diagonal, double offDiagonal) const;
+	void RelaxRedBlack(ArraySpan<T> x, ArraySpan<const T> b, T a, T c, int sweeps);
 
 private:
 	int size;
+	StencilEngine<T> stencil;
+	GridKernels<T> kernels;
+
+	RetentiveObject<VectorField<T>, 1> velocity;
+	RetentiveArray<T, 1> density;
+
+	// Solutions of both projection passes and the right hand side of the pressure equation, kept between steps
+	FieldVector<T> pressure[2];
+	FieldVector<T> divergence;
+	bool pressureWarmStart = true;
+
+	std::vector<FluidSource> pendingSources;
+	std::vector<FluidForce> pendingForces;
+
+	StepMode stepMode = StepMode::Split;
+	BoundaryMode boundaryMode = BoundaryMode::Closed;
+
+	ActiveTiles tiles;
+	double sparseThreshold = 0.0;
+	std::vector<uint8_t> tileBusy;
+
+	AdvectionKernel advectionKernel = AdvectionKernel::Scalar;
+	AdvectRowsFunction<T> advectRows = &AdvectRowsScalar<T>;
+
+	ProjectionMethod projectionMethod = ProjectionMethod::GaussSeidel;
+	MultigridCycle multigridCycle = MultigridCycle::V;
+	double projectionTolerance = 1e-4;
+	int projectionMaxIterations = 0;
+
+	DiffusionMethod diffusionMethod = DiffusionMethod::GaussSeidel;
+	double diffusionTolerance = 1e-4;
+	int diffusionMaxIterations = 0;
+
+	std::unique_ptr<ThreadPool> threadPool;
+	std::unique_ptr<Multigrid<T>> multigrid;
+	std::unique_ptr<ConjugateGradient<T>> conjugateGradient;
+	std::unique_ptr<SpectralPoisson<T>> spectral;
+	std::unique_ptr<ObstacleMask> obstacles;
 
-	RetentiveObject<VectorField, 1> velocity;
-	RetentiveArray<double, 1> density;
+	double maxVelocity = 0.0;
+	long long stepCount = 0;
 
-	int lastMouseX, lastMouseY;
+	SolverStats pressureStats;
+	SolverStats viscosityStats;
+	SolverStats diffusionStats;
 };
\ No newline at end of file
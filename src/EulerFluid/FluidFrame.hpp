@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+#include "VectorField.hpp"
+
+/**
+ * A self-contained copy of the state of a FluidField at the end of a step,
+ * for consumers that must not touch the field while the solver runs.
+ */
+template<typename T>
+struct FluidFrame
+{
+	int size = 0;
+	long long step = 0;
+
+	std::vector<T> density;
+	VectorField<T> velocity;
+
+	// Tracer particle positions in grid units, empty if the producer has none
+	std::vector<T> tracerX;
+	std::vector<T> tracerY;
+};
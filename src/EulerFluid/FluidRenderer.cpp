@@ -0,0 +1,230 @@
+#include "FluidRenderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "FluidField.hpp"
+#include "Profiler.hpp"
+
+#define IDX(x, y, w) ((y) * (w) + (x))
+
+// Grids wider than this get one velocity glyph per block of cells instead of one per cell
+#define MAX_GLYPHS_PER_AXIS 64
+
+// More tracers than this only draw every few of them, a denser cloud would not look any different
+#define MAX_TRACER_POINTS 100000
+
+FluidRenderer::FluidRenderer(ColormapType colormap) :
+	colormap(colormap)
+{
+}
+
+FluidRenderer::~FluidRenderer()
+{
+	if (densityTexture != nullptr)
+		SDL_DestroyTexture(densityTexture);
+}
+
+template<typename T>
+void FluidRenderer::Draw(SDL_Renderer* renderer, const FluidField<T>& field, const SDL_Rect& target)
+{
+	PROFILE_SCOPE("Draw");
+
+	DrawDensity(renderer, field.GetDensity(), field.GetSize(), target);
+
+	if (drawVelocity)
+		DrawVelocity(renderer, field.GetVelocity(), target);
+}
+
+template<typename T>
+void FluidRenderer::Draw(SDL_Renderer* renderer, const FluidFrame<T>& frame, const SDL_Rect& target)
+{
+	PROFILE_SCOPE("Draw");
+
+	// Nothing has been published yet
+	if (frame.size == 0)
+		return;
+
+	DrawDensity<T>(renderer, frame.density, frame.size, target);
+
+	if (drawTracers && !frame.tracerX.empty())
+		DrawTracers(renderer, frame.tracerX, frame.tracerY, frame.size, target);
+
+	if (drawVelocity)
+		DrawVelocity(renderer, frame.velocity, target);
+}
+
+template<typename T>
+void FluidRenderer::DrawDensity(SDL_Renderer* renderer, ArraySpan<const T> density, int size, const SDL_Rect& target)
+{
+	// One texel per cell, recreated only if the grid or the renderer changes
+	if (densityTexture == nullptr || textureSize != size || textureOwner != renderer)
+	{
+		if (densityTexture != nullptr)
+			SDL_DestroyTexture(densityTexture);
+
+		densityTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, size, size);
+		textureOwner = renderer;
+		textureSize = size;
+
+		if (densityTexture == nullptr)
+			return;
+
+		SDL_SetTextureBlendMode(densityTexture, SDL_BLENDMODE_NONE);
+	}
+
+	void* pixels;
+	int pitch;
+	if (SDL_LockTexture(densityTexture, nullptr, &pixels, &pitch) != 0)
+		return;
+
+	for (int y = 0; y < size; y++)
+	{
+		uint32_t* row = (uint32_t*)((uint8_t*)pixels + (size_t)y * pitch);
+		colormap.MapRow(density.data() + IDX(0, y, size), size, row);
+	}
+
+	SDL_UnlockTexture(densityTexture);
+
+	SDL_Rect destination = { target.x, target.y, target.w - target.x, target.h - target.y };
+	SDL_RenderCopy(renderer, densityTexture, nullptr, &destination);
+}
+
+template<typename T>
+void FluidRenderer::DrawVelocity(SDL_Renderer* renderer, const VectorField<T>& velocity, const SDL_Rect& targetRect)
+{
+	int width = velocity.GetWidth();
+	int height = velocity.GetHeight();
+	double biggestMagnitude = velocity.GetBiggestMagnitude();
+
+	double cellWidth = (double)(targetRect.w - targetRect.x) / (double)width;
+	double cellHeight = (double)(targetRect.h - targetRect.y) / (double)height;
+
+	// Every glyph represents a block of stride x stride cells and is scaled up to match
+	int stride = std::max((std::max(width, height) + MAX_GLYPHS_PER_AXIS - 1) / MAX_GLYPHS_PER_AXIS, 1);
+	double glyphWidth = cellWidth * stride;
+	double glyphHeight = cellHeight * stride;
+
+	markers.clear();
+	lines.clear();
+
+	for (int y = stride / 2; y < height; y += stride)
+	{
+		for (int x = stride / 2; x < width; x += stride)
+		{
+			float centerX = (float)(targetRect.x + cellWidth * (x + 0.5));
+			float centerY = (float)(targetRect.y + cellHeight * (y + 0.5));
+
+			SDL_FRect marker;
+			marker.w = (float)(glyphWidth / 5.0);
+			marker.h = (float)(glyphHeight / 5.0);
+			marker.x = centerX - marker.w / 2.0f;
+			marker.y = centerY - marker.h / 2.0f;
+			markers.push_back(marker);
+
+			lines.push_back({ centerX, centerY });
+			lines.push_back({
+				centerX + (float)(velocity.horizontal[IDX(x, y, width)] / biggestMagnitude * glyphWidth * 2.5),
+				centerY + (float)(velocity.vertical[IDX(x, y, width)] / biggestMagnitude * glyphHeight * 2.5)
+			});
+		}
+	}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	vertices.clear();
+	indices.clear();
+
+	for (const SDL_FRect& marker : markers)
+	{
+		SDL_FPoint corners[4] = {
+			{ marker.x, marker.y },
+			{ marker.x + marker.w, marker.y },
+			{ marker.x + marker.w, marker.y + marker.h },
+			{ marker.x, marker.y + marker.h }
+		};
+		AddQuad(corners);
+	}
+
+	// Lines become quads one pixel wide, so the whole overlay is a single draw call
+	for (size_t i = 0; i < lines.size(); i += 2)
+	{
+		float dx = lines[i + 1].x - lines[i].x;
+		float dy = lines[i + 1].y - lines[i].y;
+		float length = std::sqrt(dx * dx + dy * dy);
+		if (length < 0.5f)
+			continue;
+
+		float nx = -dy / length * 0.5f;
+		float ny = dx / length * 0.5f;
+		SDL_FPoint corners[4] = {
+			{ lines[i].x + nx, lines[i].y + ny },
+			{ lines[i + 1].x + nx, lines[i + 1].y + ny },
+			{ lines[i + 1].x - nx, lines[i + 1].y - ny },
+			{ lines[i].x - nx, lines[i].y - ny }
+		};
+		AddQuad(corners);
+	}
+
+	if (!indices.empty())
+		SDL_RenderGeometry(renderer, nullptr, vertices.data(), (int)vertices.size(), indices.data(), (int)indices.size());
+#else
+	SDL_SetRenderDrawColor(renderer, 200, 20, 20, 100);
+	SDL_RenderFillRectsF(renderer, markers.data(), (int)markers.size());
+
+	for (size_t i = 0; i < lines.size(); i += 2)
+		SDL_RenderDrawLineF(renderer, lines[i].x, lines[i].y, lines[i + 1].x, lines[i + 1].y);
+#endif
+}
+
+template<typename T>
+void FluidRenderer::DrawTracers(SDL_Renderer* renderer, const std::vector<T>& x, const std::vector<T>& y, int size, const SDL_Rect& target)
+{
+	double cellWidth = (double)(target.w - target.x) / (double)size;
+	double cellHeight = (double)(target.h - target.y) / (double)size;
+
+	// The tracers are sorted by cell, so taking every few of them still covers the whole flow evenly
+	size_t count = std::min(x.size(), y.size());
+	size_t stride = std::max((count + MAX_TRACER_POINTS - 1) / MAX_TRACER_POINTS, (size_t)1);
+
+	points.clear();
+	for (size_t particle = 0; particle < count; particle += stride)
+	{
+		points.push_back({
+			(float)(target.x + cellWidth * (x[particle] + 0.5)),
+			(float)(target.y + cellHeight * (y[particle] + 0.5))
+		});
+	}
+
+	// The renderer is shared with the caller, so its blend mode is restored afterwards
+	SDL_BlendMode previousMode = SDL_BLENDMODE_NONE;
+	SDL_GetRenderDrawBlendMode(renderer, &previousMode);
+
+	SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+	SDL_SetRenderDrawColor(renderer, 40, 160, 255, 160);
+	SDL_RenderDrawPointsF(renderer, points.data(), (int)points.size());
+
+	SDL_SetRenderDrawBlendMode(renderer, previousMode);
+}
+
+void FluidRenderer::AddQuad(const SDL_FPoint corners[4])
+{
+	int first = (int)vertices.size();
+	for (int i = 0; i < 4; i++)
+	{
+		SDL_Vertex vertex;
+		vertex.position = corners[i];
+		vertex.color = { 200, 20, 20, 100 };
+		vertex.tex_coord = { 0.0f, 0.0f };
+		vertices.push_back(vertex);
+	}
+
+	const int triangles[6] = { 0, 1, 2, 0, 2, 3 };
+	for (int corner : triangles)
+		indices.push_back(first + corner);
+}
+
+template void FluidRenderer::Draw<float>(SDL_Renderer* renderer, const FluidField<float>& field, const SDL_Rect& target);
+template void FluidRenderer::Draw<double>(SDL_Renderer* renderer, const FluidField<double>& field, const SDL_Rect& target);
+template void FluidRenderer::Draw<float>(SDL_Renderer* renderer, const FluidFrame<float>& frame, const SDL_Rect& target);
+template void FluidRenderer::Draw<double>(SDL_Renderer* renderer, const FluidFrame<double>& frame, const SDL_Rect& target);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+#include <SDL.h>
+
+#include "ArraySpan.hpp"
+#include "Colormap.hpp"
+
+template<typename T>
+class FluidField;
+
+template<typename T>
+class VectorField;
+
+template<typename T>
+struct FluidFrame;
+
+/**
+ * Draws the density as a single scaled texture, and the velocity as an overlay
+ * of glyphs that is submitted in one batch. On large grids only every few cells
+ * get a glyph, so the overlay stays readable and cheap. Tracer particles of a
+ * frame are drawn as points in one batch, thinned out if there are very many.
+ */
+class FluidRenderer
+{
+public:
+	FluidRenderer(ColormapType colormap = ColormapType::Grayscale);
+	~FluidRenderer();
+
+	FluidRenderer(const FluidRenderer& other) = delete;
+	FluidRenderer& operator=(const FluidRenderer& other) = delete;
+
+	// Instantiated for float and double fields
+	template<typename T>
+	void Draw(SDL_Renderer* renderer, const FluidField<T>& field, const SDL_Rect& target);
+
+	template<typename T>
+	void Draw(SDL_Renderer* renderer, const FluidFrame<T>& frame, const SDL_Rect& target);
+
+	void SetColormap(ColormapType type) { colormap = Colormap(type); }
+	void SetVelocityVisible(bool visible) { drawVelocity = visible; }
+	void SetTracersVisible(bool visible) { drawTracers = visible; }
+
+private:
+	template<typename T>
+	void DrawDensity(SDL_Renderer* renderer, ArraySpan<const T> density, int size, const SDL_Rect& target);
+
+	template<typename T>
+	void DrawVelocity(SDL_Renderer* renderer, const VectorField<T>& velocity, const SDL_Rect& target);
+
+	template<typename T>
+	void DrawTracers(SDL_Renderer* renderer, const std::vector<T>& x, const std::vector<T>& y, int size, const SDL_Rect& target);
+
+	void AddQuad(const SDL_FPoint corners[4]);
+
+private:
+	Colormap colormap;
+	bool drawVelocity = true;
+	bool drawTracers = true;
+
+	SDL_Texture* densityTexture = nullptr;
+	SDL_Renderer* textureOwner = nullptr;
+	int textureSize = 0;
+
+	// Reused between frames so drawing the overlay does not allocate
+	std::vector<SDL_FRect> markers;
+	std::vector<SDL_FPoint> lines;
+	std::vector<SDL_Vertex> vertices;
+	std::vector<int> indices;
+	std::vector<SDL_FPoint> points;
+};
@@ -0,0 +1,186 @@
+#include "FourierTransform.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+// std::complex multiplication checks for infinities and NaNs, which keeps it out of the butterflies
+template<typename T>
+static inline std::complex<T> Multiply(const std::complex<T>& a, const std::complex<T>& b)
+{
+	return std::complex<T>(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+bool IsPowerOfTwo(int value)
+{
+	return value > 0 && (value & (value - 1)) == 0;
+}
+
+template<typename T>
+FFTPlan<T>::FFTPlan(int length) :
+	length(length)
+{
+	const double pi = std::acos(-1.0);
+
+	// The twiddles of every stage are stored next to each other, so the butterflies read them in order
+	twiddles.resize(std::max(length - 1, 0));
+	for (int span = 1; span < length; span *= 2)
+	{
+		for (int k = 0; k < span; k++)
+		{
+			double angle = -pi * k / span;
+			twiddles[span - 1 + k] = std::complex<T>((T)std::cos(angle), (T)std::sin(angle));
+		}
+	}
+
+	int bits = 0;
+	while ((1 << bits) < length)
+		bits++;
+
+	for (int i = 0; i < length; i++)
+	{
+		int reversed = 0;
+		for (int bit = 0; bit < bits; bit++)
+			if (i & (1 << bit))
+				reversed |= 1 << (bits - 1 - bit);
+
+		if (i < reversed)
+			swaps.emplace_back(i, reversed);
+	}
+}
+
+template<typename T>
+void FFTPlan<T>::Forward(std::complex<T>* data) const
+{
+	Transform(data, false);
+}
+
+template<typename T>
+void FFTPlan<T>::Inverse(std::complex<T>* data) const
+{
+	Transform(data, true);
+}
+
+template<typename T>
+void FFTPlan<T>::Transform(std::complex<T>* data, bool inverse) const
+{
+	for (const std::pair<int, int>& swap : swaps)
+		std::swap(data[swap.first], data[swap.second]);
+
+	// The first stage only has a twiddle of one
+	for (int start = 0; start + 1 < length; start += 2)
+	{
+		std::complex<T> a = data[start];
+		std::complex<T> b = data[start + 1];
+		data[start] = a + b;
+		data[start + 1] = a - b;
+	}
+
+	// The inverse uses the conjugate twiddles
+	const T direction = inverse ? -1 : 1;
+
+	for (int span = 2; span < length; span *= 2)
+	{
+		const std::complex<T>* stage = twiddles.data() + span - 1;
+
+		for (int start = 0; start < length; start += 2 * span)
+		{
+			std::complex<T>* lower = data + start;
+			std::complex<T>* upper = lower + span;
+
+			for (int k = 0; k < span; k++)
+			{
+				const std::complex<T>& twiddle = stage[k];
+				std::complex<T> w(twiddle.real(), direction * twiddle.imag());
+
+				std::complex<T> a = lower[k];
+				std::complex<T> b = Multiply(upper[k], w);
+				lower[k] = a + b;
+				upper[k] = a - b;
+			}
+		}
+	}
+}
+
+template<typename T>
+RealFFTPlan<T>::RealFFTPlan(int length) :
+	length(length), half(length / 2)
+{
+	const double pi = std::acos(-1.0);
+
+	twiddles.resize(length / 4 + 1);
+	for (int k = 0; k <= length / 4; k++)
+	{
+		double angle = -2.0 * pi * k / length;
+		twiddles[k] = std::complex<T>((T)std::cos(angle), (T)std::sin(angle));
+	}
+}
+
+template<typename T>
+void RealFFTPlan<T>::Forward(const T* in, std::complex<T>* out) const
+{
+	int M = length / 2;
+	const T half = 0.5;
+
+	// Even samples go into the real part, odd samples into the imaginary part
+	for (int n = 0; n < M; n++)
+		out[n] = std::complex<T>(in[2 * n], in[2 * n + 1]);
+
+	this->half.Forward(out);
+
+	std::complex<T> first = out[0];
+	out[0] = std::complex<T>(first.real() + first.imag(), 0);
+	out[M] = std::complex<T>(first.real() - first.imag(), 0);
+
+	// Frequencies k and M - k are built from the same two packed values, so they are done in pairs
+	for (int k = 1; k <= M / 2; k++)
+	{
+		std::complex<T> z = out[k];
+		std::complex<T> mirrored = std::conj(out[M - k]);
+
+		std::complex<T> even = (z + mirrored) * half;
+		std::complex<T> difference = z - mirrored;
+		std::complex<T> odd(half * difference.imag(), -half * difference.real());
+		std::complex<T> rotated = Multiply(twiddles[k], odd);
+
+		out[k] = even + rotated;
+		out[M - k] = std::conj(even - rotated);
+	}
+}
+
+template<typename T>
+void RealFFTPlan<T>::Inverse(std::complex<T>* spectrum, T* out) const
+{
+	int M = length / 2;
+
+	// The steps of Forward in reverse, leaving out the halving so the result is scaled by the length
+	T first = spectrum[0].real();
+	T last = spectrum[M].real();
+	spectrum[0] = std::complex<T>(first + last, first - last);
+
+	for (int k = 1; k <= M / 2; k++)
+	{
+		std::complex<T> x = spectrum[k];
+		std::complex<T> mirrored = std::conj(spectrum[M - k]);
+
+		std::complex<T> even = x + mirrored;
+		std::complex<T> odd = Multiply(x - mirrored, std::conj(twiddles[k]));
+
+		spectrum[k] = even + std::complex<T>(-odd.imag(), odd.real());
+		spectrum[M - k] = std::conj(even) + std::complex<T>(odd.imag(), odd.real());
+	}
+
+	half.Inverse(spectrum);
+
+	for (int n = 0; n < M; n++)
+	{
+		out[2 * n] = spectrum[n].real();
+		out[2 * n + 1] = spectrum[n].imag();
+	}
+}
+
+template class FFTPlan<float>;
+template class FFTPlan<double>;
+
+template class RealFFTPlan<float>;
+template class RealFFTPlan<double>;
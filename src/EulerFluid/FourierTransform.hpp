@@ -0,0 +1,67 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+/**
+ * Precomputed tables for in-place radix-2 complex FFTs of one power-of-two length.
+ * A plan is built once and can be used by several threads at the same time.
+ * Neither direction is normalized, so an inverse after a forward transform
+ * scales the data by the length. Instantiated for float and double.
+ */
+template<typename T>
+class FFTPlan
+{
+public:
+	FFTPlan(int length);
+
+	void Forward(std::complex<T>* data) const;
+	void Inverse(std::complex<T>* data) const;
+
+	int GetLength() const { return length; }
+
+private:
+	void Transform(std::complex<T>* data, bool inverse) const;
+
+private:
+	int length;
+
+	// Index pairs that swap places in the bit-reversal permutation
+	std::vector<std::pair<int, int>> swaps;
+
+	// exp(-pi i k / span) for k < span, for every butterfly span of the transform. The twiddles
+	// of span s start at s - 1. They are computed in double precision in either case.
+	std::vector<std::complex<T>> twiddles;
+};
+
+/**
+ * Transforms of real sequences of a power-of-two length N. The N reals are packed
+ * into N/2 complex values, transformed with a complex plan of half the length, and
+ * separated again, which is about twice as fast as a complex transform of length N.
+ * Only the N/2 + 1 non-redundant frequencies of the Hermitian spectrum are kept.
+ * Like FFTPlan, the transforms are unnormalized and plans can be shared between threads.
+ */
+template<typename T>
+class RealFFTPlan
+{
+public:
+	RealFFTPlan(int length);
+
+	// Reads N reals from `in` and writes the N/2 + 1 frequencies to `out`
+	void Forward(const T* in, std::complex<T>* out) const;
+
+	// Reads the N/2 + 1 frequencies from `spectrum`, which is used as scratch space, and writes N reals to `out`
+	void Inverse(std::complex<T>* spectrum, T* out) const;
+
+	int GetLength() const { return length; }
+
+private:
+	int length;
+	FFTPlan<T> half;
+
+	// exp(-2 pi i k / length) for k <= length / 4, for separating the packed transform
+	std::vector<std::complex<T>> twiddles;
+};
+
+// FFTPlan supports every power of two, RealFFTPlan every power of two from 4 on
+bool IsPowerOfTwo(int value);
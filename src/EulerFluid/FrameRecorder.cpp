@@ -0,0 +1,520 @@
+#include "FrameRecorder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "FluidField.hpp"
+#include "ImageWriter.hpp"
+
+#define RECORDING_MAGIC "EFREC"
+#define RECORDING_INDEX_MAGIC "EFRINDEX"
+
+// Keyframes leave this much room around the observed values, so the range holds for a while
+#define RECORDING_RANGE_HEADROOM 0.25
+
+// The writer checks for new frames at least this often, even if a wake-up gets lost
+#define RECORDER_POLL_INTERVAL std::chrono::milliseconds(5)
+
+static bool SeekTo(FILE* file, uint64_t offset)
+{
+#if defined(_WIN32)
+	return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+static void PutVarint(std::vector<uint8_t>& out, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+
+	out.push_back((uint8_t)value);
+}
+
+static bool GetVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value)
+{
+	value = 0;
+	for (int shift = 0; shift < 35 && in < end; shift += 7)
+	{
+		uint8_t byte = *in++;
+		value |= (uint32_t)(byte & 0x7F) << shift;
+		if ((byte & 0x80) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+// A nonzero zigzag code never starts with a 0 byte, which leaves 0 free to mark runs of zeros
+static void EncodeDeltas(const uint16_t* codes, const uint16_t* previous, size_t count, std::vector<uint8_t>& out)
+{
+	uint32_t zeros = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		int32_t delta = (int32_t)codes[i] - (int32_t)(previous ? previous[i] : 0);
+		if (delta == 0)
+		{
+			zeros++;
+			continue;
+		}
+
+		if (zeros > 0)
+		{
+			out.push_back(0);
+			PutVarint(out, zeros);
+			zeros = 0;
+		}
+
+		PutVarint(out, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+	}
+
+	if (zeros > 0)
+	{
+		out.push_back(0);
+		PutVarint(out, zeros);
+	}
+}
+
+static bool DecodeDeltas(const uint8_t* in, const uint8_t* end, uint16_t* codes, bool keyframe, size_t count)
+{
+	size_t i = 0;
+	while (i < count && in < end)
+	{
+		uint32_t value;
+		if (*in == 0)
+		{
+			in++;
+			if (!GetVarint(in, end, value) || value > count - i)
+				return false;
+
+			// Unchanged codes keep the previous frame's value, which is zero before a keyframe
+			if (keyframe)
+				std::fill(codes + i, codes + i + value, (uint16_t)0);
+
+			i += value;
+			continue;
+		}
+
+		if (!GetVarint(in, end, value))
+			return false;
+
+		int32_t delta = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+		codes[i] = (uint16_t)((keyframe ? 0 : (int32_t)codes[i]) + delta);
+		i++;
+	}
+
+	return i == count && in == end;
+}
+
+template<typename T>
+FrameRecorder<T>::FrameRecorder(const RecorderSettings& settings) :
+	settings(settings), colormap(settings.colormap)
+{
+	this->settings.bits = (settings.bits <= 8) ? 8 : 16;
+	this->settings.keyframeInterval = std::max(settings.keyframeInterval, 1);
+
+	int depth = std::min(std::max(settings.queueDepth, 1), RECORDER_MAX_QUEUE_DEPTH);
+	slots.resize(depth);
+	for (int slot = 0; slot < depth; slot++)
+		freeSlots.TryPush(slot);
+
+	if (!settings.containerPath.empty())
+	{
+		container = std::fopen(settings.containerPath.c_str(), "wb");
+		if (container == nullptr)
+		{
+			open = false;
+			error = "cannot create " + settings.containerPath;
+			return;
+		}
+	}
+
+	writer = std::thread(&FrameRecorder::WriterLoop, this);
+}
+
+template<typename T>
+FrameRecorder<T>::~FrameRecorder()
+{
+	Close();
+}
+
+template<typename T>
+bool FrameRecorder<T>::Submit(const FluidField<T>& field)
+{
+	int slot;
+	if (!open || HasFailed() || !freeSlots.TryPop(slot))
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	field.Snapshot(slots[slot]);
+	filledSlots.TryPush(slot);
+	wake.notify_one();
+
+	return true;
+}
+
+template<typename T>
+void FrameRecorder<T>::Close()
+{
+	if (!writer.joinable())
+		return;
+
+	stopping.store(true, std::memory_order_release);
+	wake.notify_one();
+	writer.join();
+}
+
+template<typename T>
+RecorderStats FrameRecorder<T>::GetStats() const
+{
+	RecorderStats stats;
+	stats.written = written.load(std::memory_order_relaxed);
+	stats.dropped = dropped.load(std::memory_order_relaxed);
+	stats.rawBytes = rawBytes.load(std::memory_order_relaxed);
+	stats.encodedBytes = encodedBytes.load(std::memory_order_relaxed);
+	stats.failed = HasFailed();
+
+	return stats;
+}
+
+template<typename T>
+void FrameRecorder<T>::WriterLoop()
+{
+	for (;;)
+	{
+		int slot;
+		if (filledSlots.TryPop(slot))
+		{
+			WriteFrame(slots[slot]);
+			freeSlots.TryPush(slot);
+			continue;
+		}
+
+		// Everything submitted before Close is visible once the flag is
+		if (stopping.load(std::memory_order_acquire))
+		{
+			while (filledSlots.TryPop(slot))
+				WriteFrame(slots[slot]);
+
+			break;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		wake.wait_for(lock, RECORDER_POLL_INTERVAL);
+	}
+
+	FinishContainer();
+}
+
+template<typename T>
+void FrameRecorder<T>::WriteFrame(const FluidFrame<T>& frame)
+{
+	// Frames queued before a failure are dropped like the ones submitted after it
+	if (HasFailed())
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	if (container && !WriteContainerFrame(frame))
+	{
+		Fail("cannot write " + settings.containerPath);
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	if (settings.imageFormat != ImageFormat::None && !WriteImage(frame))
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	rawBytes.fetch_add((uint64_t)RECORDING_CHANNELS * frame.density.size() * sizeof(T), std::memory_order_relaxed);
+	written.fetch_add(1, std::memory_order_relaxed);
+}
+
+template<typename T>
+void FrameRecorder<T>::Fail(const std::string& reason)
+{
+	error = reason;
+	failed.store(true, std::memory_order_release);
+}
+
+template<typename T>
+bool FrameRecorder<T>::WriteContainerFrame(const FluidFrame<T>& frame)
+{
+	size_t cells = frame.density.size();
+	const T* channels[RECORDING_CHANNELS] = { frame.density.data(), frame.velocity.horizontal.data(), frame.velocity.vertical.data() };
+
+	if (index.empty())
+	{
+		RecordingHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC));
+		header.version = RECORDING_VERSION;
+		header.resolution = (uint32_t)(frame.size - 2);
+		header.bits = (uint32_t)settings.bits;
+		header.channels = RECORDING_CHANNELS;
+
+		if (std::fwrite(&header, sizeof(header), 1, container) != 1)
+			return false;
+
+		containerBytes = sizeof(header);
+
+		codes.resize(RECORDING_CHANNELS * cells);
+		previousCodes.resize(RECORDING_CHANNELS * cells);
+	}
+
+	// A value outside the current ranges would be clipped, so it starts a new keyframe early
+	bool keyframe = index.empty() || sinceKeyframe >= settings.keyframeInterval;
+	double minimum[RECORDING_CHANNELS], maximum[RECORDING_CHANNELS];
+	for (int c = 0; c < RECORDING_CHANNELS; c++)
+	{
+		auto range = std::minmax_element(channels[c], channels[c] + cells);
+		minimum[c] = (double)*range.first;
+		maximum[c] = (double)*range.second;
+
+		keyframe = keyframe || minimum[c] < low[c] || maximum[c] > high[c];
+	}
+
+	if (keyframe)
+	{
+		for (int c = 0; c < RECORDING_CHANNELS; c++)
+		{
+			double headroom = std::max((maximum[c] - minimum[c]) * RECORDING_RANGE_HEADROOM, 1e-6);
+			low[c] = minimum[c] - headroom;
+			high[c] = maximum[c] + headroom;
+		}
+
+		sinceKeyframe = 0;
+	}
+
+	sinceKeyframe++;
+
+	double levels = (double)((1u << settings.bits) - 1);
+	for (int c = 0; c < RECORDING_CHANNELS; c++)
+	{
+		double scale = levels / (high[c] - low[c]);
+		uint16_t* target = codes.data() + c * cells;
+
+		for (size_t i = 0; i < cells; i++)
+			target[i] = (uint16_t)std::min(std::max(((double)channels[c][i] - low[c]) * scale + 0.5, 0.0), levels);
+	}
+
+	payload.clear();
+	EncodeDeltas(codes.data(), keyframe ? nullptr : previousCodes.data(), codes.size(), payload);
+	codes.swap(previousCodes);
+
+	RecordingFrameHeader frameHeader;
+	std::memset(&frameHeader, 0, sizeof(frameHeader));
+	frameHeader.step = frame.step;
+	frameHeader.flags = keyframe ? RECORDING_KEYFRAME : 0;
+	frameHeader.payloadBytes = (uint32_t)payload.size();
+	std::copy(low, low + RECORDING_CHANNELS, frameHeader.low);
+	std::copy(high, high + RECORDING_CHANNELS, frameHeader.high);
+
+	if (std::fwrite(&frameHeader, sizeof(frameHeader), 1, container) != 1
+		|| std::fwrite(payload.data(), 1, payload.size(), container) != payload.size())
+		return false;
+
+	index.push_back({ containerBytes, frameHeader.step, frameHeader.flags, frameHeader.payloadBytes });
+	containerBytes += sizeof(frameHeader) + payload.size();
+
+	encodedBytes.fetch_add(sizeof(frameHeader) + payload.size(), std::memory_order_relaxed);
+	return true;
+}
+
+template<typename T>
+bool FrameRecorder<T>::WriteImage(const FluidFrame<T>& frame)
+{
+	int N = frame.size - 2;
+	pixels.resize((size_t)N * N);
+
+	for (int j = 1; j <= N; j++)
+		colormap.MapRow(frame.density.data() + j * frame.size + 1, N, pixels.data() + (size_t)(j - 1) * N);
+
+	char step[32];
+	std::snprintf(step, sizeof(step), "_%06lld", frame.step);
+
+	std::string path = settings.imagePrefix + step + ((settings.imageFormat == ImageFormat::PNG) ? ".png" : ".ppm");
+	bool ok = (settings.imageFormat == ImageFormat::PNG)
+		? WritePng(path, N, N, pixels.data())
+		: WritePpm(path, N, N, pixels.data());
+
+	if (!ok)
+		Fail("cannot write " + path);
+
+	return ok;
+}
+
+template<typename T>
+void FrameRecorder<T>::FinishContainer()
+{
+	if (container == nullptr)
+		return;
+
+	// Without the trailer the reader rejects the file, which is better than trusting a broken one
+	if (HasFailed())
+	{
+		std::fclose(container);
+		container = nullptr;
+		return;
+	}
+
+	RecordingTrailer trailer;
+	std::memset(&trailer, 0, sizeof(trailer));
+	trailer.indexOffset = containerBytes;
+	trailer.frameCount = index.size();
+	std::memcpy(trailer.magic, RECORDING_INDEX_MAGIC, sizeof(trailer.magic));
+
+	bool ok = (index.empty() || std::fwrite(index.data(), sizeof(RecordingIndexEntry), index.size(), container) == index.size())
+		&& std::fwrite(&trailer, sizeof(trailer), 1, container) == 1;
+
+	// Buffered data only reaches the disk here, so a full disk may only show up now
+	ok = (std::fclose(container) == 0) && ok;
+	container = nullptr;
+
+	if (!ok)
+		Fail("cannot finish " + settings.containerPath);
+}
+
+RecordingReader::~RecordingReader()
+{
+	Close();
+}
+
+bool RecordingReader::Open(const std::string& path)
+{
+	Close();
+
+	file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr)
+	{
+		error = "cannot open " + path;
+		return false;
+	}
+
+	RecordingTrailer trailer;
+	bool ok = std::fread(&header, sizeof(header), 1, file) == 1
+		&& std::memcmp(header.magic, RECORDING_MAGIC, sizeof(RECORDING_MAGIC)) == 0
+		&& std::fseek(file, -(long)sizeof(trailer), SEEK_END) == 0
+		&& std::fread(&trailer, sizeof(trailer), 1, file) == 1
+		&& std::memcmp(trailer.magic, RECORDING_INDEX_MAGIC, sizeof(trailer.magic)) == 0;
+
+	if (!ok)
+	{
+		Close();
+		error = path + " is not a finished recording";
+		return false;
+	}
+
+	if (header.version != RECORDING_VERSION || header.channels != RECORDING_CHANNELS || (header.bits != 8 && header.bits != 16))
+	{
+		Close();
+		error = "unsupported recording format";
+		return false;
+	}
+
+	index.resize((size_t)trailer.frameCount);
+	if (!SeekTo(file, trailer.indexOffset) || (!index.empty() && std::fread(index.data(), sizeof(RecordingIndexEntry), index.size(), file) != index.size()))
+	{
+		Close();
+		error = "cannot read the index of " + path;
+		return false;
+	}
+
+	size_t size = (size_t)header.resolution + 2;
+	codes.assign(RECORDING_CHANNELS * size * size, 0);
+	decoded = -1;
+
+	return true;
+}
+
+void RecordingReader::Close()
+{
+	if (file)
+		std::fclose(file);
+
+	file = nullptr;
+	index.clear();
+	decoded = -1;
+}
+
+bool RecordingReader::DecodeFrame(int frame)
+{
+	if (frame == decoded)
+		return true;
+
+	// Continue from the last decoded frame if no keyframe lies in between, otherwise start at the keyframe.
+	// The first frame is always a keyframe.
+	int keyframe = frame;
+	while (keyframe > 0 && !(index[keyframe].flags & RECORDING_KEYFRAME))
+		keyframe--;
+
+	int first = (decoded >= keyframe && decoded < frame) ? decoded + 1 : keyframe;
+
+	for (int current = first; current <= frame; current++)
+	{
+		const RecordingIndexEntry& entry = index[current];
+		payload.resize(entry.payloadBytes);
+
+		bool ok = SeekTo(file, entry.offset)
+			&& std::fread(&frameHeader, sizeof(frameHeader), 1, file) == 1
+			&& (payload.empty() || std::fread(payload.data(), 1, payload.size(), file) == payload.size())
+			&& DecodeDeltas(payload.data(), payload.data() + payload.size(), codes.data(), (frameHeader.flags & RECORDING_KEYFRAME) != 0, codes.size());
+
+		if (!ok)
+		{
+			decoded = -1;
+			error = "corrupt frame " + std::to_string(current);
+			return false;
+		}
+
+		decoded = current;
+	}
+
+	return true;
+}
+
+template<typename T>
+bool RecordingReader::ReadFrame(int frame, FluidFrame<T>& out)
+{
+	if (file == nullptr || frame < 0 || frame >= (int)index.size() || !DecodeFrame(frame))
+		return false;
+
+	int size = (int)header.resolution + 2;
+	size_t cells = (size_t)size * size;
+	double levels = (double)((1u << header.bits) - 1);
+
+	out.size = size;
+	out.step = frameHeader.step;
+	out.density.resize(cells);
+	if (out.velocity.GetWidth() != size || out.velocity.GetHeight() != size)
+		out.velocity = VectorField<T>(size, size);
+
+	T* channels[RECORDING_CHANNELS] = { out.density.data(), out.velocity.horizontal.data(), out.velocity.vertical.data() };
+	for (int c = 0; c < RECORDING_CHANNELS; c++)
+	{
+		double step = (frameHeader.high[c] - frameHeader.low[c]) / levels;
+		const uint16_t* source = codes.data() + c * cells;
+
+		for (size_t i = 0; i < cells; i++)
+			channels[c][i] = (T)(frameHeader.low[c] + step * source[i]);
+	}
+
+	return true;
+}
+
+template class FrameRecorder<float>;
+template class FrameRecorder<double>;
+
+template bool RecordingReader::ReadFrame<float>(int frame, FluidFrame<float>& out);
+template bool RecordingReader::ReadFrame<double>(int frame, FluidFrame<double>& out);
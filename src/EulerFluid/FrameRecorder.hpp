@@ -0,0 +1,238 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Colormap.hpp"
+#include "FluidFrame.hpp"
+#include "SpscQueue.hpp"
+
+template<typename T>
+class FluidField;
+
+#define RECORDING_VERSION 1
+
+// Density, horizontal velocity, vertical velocity
+#define RECORDING_CHANNELS 3
+#define RECORDING_KEYFRAME 0x1
+
+#define RECORDER_MAX_QUEUE_DEPTH 64
+#define RECORDER_DEFAULT_QUEUE_DEPTH 8
+#define RECORDER_DEFAULT_KEYFRAME_INTERVAL 30
+
+enum class ImageFormat
+{
+	None,
+	PPM,
+	PNG
+};
+
+struct RecorderSettings
+{
+	// Recording container to write, nothing is recorded if it is empty
+	std::string containerPath;
+	int bits = 16;			// Quantization of every channel, 8 or 16
+	int keyframeInterval = RECORDER_DEFAULT_KEYFRAME_INTERVAL;
+
+	// Every frame's density is also written to `imagePrefix`_<step>.ppm/.png unless the format is None
+	std::string imagePrefix;
+	ImageFormat imageFormat = ImageFormat::None;
+	ColormapType colormap = ColormapType::Heat;
+
+	// Frames that may wait for the writer before new ones are dropped, at most RECORDER_MAX_QUEUE_DEPTH
+	int queueDepth = RECORDER_DEFAULT_QUEUE_DEPTH;
+};
+
+struct RecorderStats
+{
+	long long written = 0;
+	long long dropped = 0;
+	uint64_t rawBytes = 0;			// Size of the recorded fields as plain arrays
+	uint64_t encodedBytes = 0;		// Size of their frames in the container
+
+	// A write failed, e.g. on a full disk. GetError tells why, and every frame after it was dropped.
+	bool failed = false;
+};
+
+/**
+ * Layout of a recording:
+ *
+ *		RecordingHeader
+ *		RecordingFrameHeader, payload		(once per frame)
+ *		RecordingIndexEntry					(once per frame)
+ *		RecordingTrailer
+ *
+ * Every channel of a frame is quantized to `bits` bits over the value range given in
+ * its frame header, including the ghost cells. The payload holds the differences of
+ * these codes to the previous frame, or to zero for keyframes, zigzag coded as
+ * varints. Runs of unchanged codes are stored as a 0 byte followed by the run length.
+ * The trailer at the end of the file points at the index, which lists the offset of
+ * every frame, so any frame can be decoded starting from the keyframe before it.
+ */
+struct RecordingHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t resolution;
+	uint32_t bits;
+	uint32_t channels;
+};
+
+struct RecordingFrameHeader
+{
+	int64_t step;
+	uint32_t flags;
+	uint32_t payloadBytes;
+	double low[RECORDING_CHANNELS];
+	double high[RECORDING_CHANNELS];
+};
+
+struct RecordingIndexEntry
+{
+	uint64_t offset;
+	int64_t step;
+	uint32_t flags;
+	uint32_t payloadBytes;
+};
+
+struct RecordingTrailer
+{
+	uint64_t indexOffset;
+	uint64_t frameCount;
+	char magic[8];
+};
+
+/**
+ * Records frames of a running simulation without slowing it down.
+ *
+ * Submit copies the field into one of a fixed number of frame slots and hands it
+ * to a writer thread, which encodes it into the recording container and/or writes
+ * it out as an image. The solver never waits: if the writer falls behind and all
+ * slots are taken, the frame is dropped and counted instead.
+ *
+ * Submit and Close must be called from the same thread.
+ */
+template<typename T>
+class FrameRecorder
+{
+public:
+	FrameRecorder(const RecorderSettings& settings);
+	~FrameRecorder();
+
+	FrameRecorder(const FrameRecorder& other) = delete;
+	FrameRecorder& operator=(const FrameRecorder& other) = delete;
+
+	// False if the container could not be created, GetError tells why
+	bool IsOpen() const { return open; }
+
+	// True once the writer failed to write a frame, the container or an image. The writer
+	// stops encoding at the first failure and drops every frame from there on.
+	bool HasFailed() const { return failed.load(std::memory_order_acquire); }
+
+	// Why the container could not be created, or why the writer failed. The writer only
+	// sets it before HasFailed turns true, so it may be read once that is the case.
+	const std::string& GetError() const { return error; }
+
+	/**
+	 * Queues the current state of the field for writing
+	 *
+	 * @return false if the frame was dropped because the writer is behind
+	 */
+	bool Submit(const FluidField<T>& field);
+
+	// Writes all queued frames, finishes the container and stops the writer
+	void Close();
+
+	RecorderStats GetStats() const;
+
+private:
+	void WriterLoop();
+	void WriteFrame(const FluidFrame<T>& frame);
+	bool WriteContainerFrame(const FluidFrame<T>& frame);
+	bool WriteImage(const FluidFrame<T>& frame);
+	void FinishContainer();
+	void Fail(const std::string& reason);
+
+private:
+	RecorderSettings settings;
+	Colormap colormap;
+
+	std::vector<FluidFrame<T>> slots;
+	SpscQueue<int, RECORDER_MAX_QUEUE_DEPTH> freeSlots;
+	SpscQueue<int, RECORDER_MAX_QUEUE_DEPTH> filledSlots;
+
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::atomic<bool> stopping{ false };
+
+	std::atomic<long long> written{ 0 };
+	std::atomic<long long> dropped{ 0 };
+	std::atomic<uint64_t> rawBytes{ 0 };
+	std::atomic<uint64_t> encodedBytes{ 0 };
+	std::atomic<bool> failed{ false };
+
+	bool open = true;
+	std::string error;
+
+	// Only touched by the writer thread once it runs
+	FILE* container = nullptr;
+	uint64_t containerBytes = 0;
+	std::vector<RecordingIndexEntry> index;
+	std::vector<uint16_t> codes;
+	std::vector<uint16_t> previousCodes;
+	std::vector<uint8_t> payload;
+	double low[RECORDING_CHANNELS] = { 0.0 };
+	double high[RECORDING_CHANNELS] = { 0.0 };
+	int sinceKeyframe = 0;
+	std::vector<uint32_t> pixels;
+};
+
+/**
+ * Reads frames back from a recording
+ */
+class RecordingReader
+{
+public:
+	RecordingReader() {}
+	~RecordingReader();
+
+	RecordingReader(const RecordingReader& other) = delete;
+	RecordingReader& operator=(const RecordingReader& other) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+	const std::string& GetError() const { return error; }
+
+	int GetResolution() const { return (int)header.resolution; }
+	int GetFrameCount() const { return (int)index.size(); }
+	long long GetStep(int frame) const { return index[frame].step; }
+
+	/**
+	 * Decodes a frame. Reading frames in order only decodes each of them once,
+	 * jumping around decodes from the closest keyframe before the requested frame.
+	 */
+	template<typename T>
+	bool ReadFrame(int frame, FluidFrame<T>& out);
+
+private:
+	bool DecodeFrame(int frame);
+
+private:
+	FILE* file = nullptr;
+	RecordingHeader header = {};
+	std::vector<RecordingIndexEntry> index;
+
+	int decoded = -1;
+	RecordingFrameHeader frameHeader = {};
+	std::vector<uint16_t> codes;
+	std::vector<uint8_t> payload;
+
+	std::string error;
+};
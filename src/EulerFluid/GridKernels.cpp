@@ -0,0 +1,147 @@
+#include "GridKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_MSC_VER)
+#define RESTRICT __restrict
+#else
+#define RESTRICT __restrict__
+#endif
+
+#define IDX(x, y, w) ((y) * (w) + (x))
+
+// Row stride of the grid, a compile-time constant for the fixed-size kernels
+template<int Fixed>
+static inline int Stride(int size)
+{
+	return (Fixed > 0) ? Fixed + 2 : size;
+}
+
+// Calls row(j, columnBegin, columnEnd) for every row of the block. Whole rows of a fixed-size
+// grid are passed the constant column range, so that copy of the loop has a known trip count.
+template<int Fixed, typename Row>
+static inline void ForEachRow(int rowBegin, int rowEnd, int columnBegin, int columnEnd, Row&& row)
+{
+	for (int j = rowBegin; j < rowEnd; j++)
+	{
+		if (Fixed > 0 && columnBegin == 1 && columnEnd == Fixed + 1)
+			row(j, 1, Fixed + 1);
+		else
+			row(j, columnBegin, columnEnd);
+	}
+}
+
+template<typename T, int Fixed>
+static void Divergence(const T* RESTRICT u, const T* RESTRICT v, T* RESTRICT divergence, T h, int size, int rowBegin, int rowEnd, int columnBegin, int columnEnd)
+{
+	const int stride = Stride<Fixed>(size);
+	const T half = 0.5;
+
+	ForEachRow<Fixed>(rowBegin, rowEnd, columnBegin, columnEnd, [&](int j, int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			divergence[IDX(i, j, stride)] = -half * h * (u[IDX(i + 1, j, stride)] - u[IDX(i - 1, j, stride)] + v[IDX(i, j + 1, stride)] - v[IDX(i, j - 1, stride)]);
+	});
+}
+
+template<typename T, int Fixed>
+static T SubtractGradient(T* RESTRICT u, T* RESTRICT v, const T* RESTRICT pressure, T h, int size, int rowBegin, int rowEnd, int columnBegin, int columnEnd)
+{
+	const int stride = Stride<Fixed>(size);
+	const T half = 0.5;
+	T fastest = 0;
+
+	ForEachRow<Fixed>(rowBegin, rowEnd, columnBegin, columnEnd, [&](int j, int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			T& x = u[IDX(i, j, stride)];
+			T& y = v[IDX(i, j, stride)];
+
+			x -= half * (pressure[IDX(i + 1, j, stride)] - pressure[IDX(i - 1, j, stride)]) / h;
+			y -= half * (pressure[IDX(i, j + 1, stride)] - pressure[IDX(i, j - 1, stride)]) / h;
+			fastest = std::max(fastest, std::max(std::abs(x), std::abs(y)));
+		}
+	});
+
+	return fastest;
+}
+
+template<typename T, int Fixed>
+static void RelaxColor(T* RESTRICT x, const T* RESTRICT b, T a, T c, int color, int size, int rowBegin, int rowEnd, int columnBegin, int columnEnd)
+{
+	const int stride = Stride<Fixed>(size);
+
+	ForEachRow<Fixed>(rowBegin, rowEnd, columnBegin, columnEnd, [&](int j, int begin, int end)
+	{
+		for (int i = begin + (begin + j + color) % 2; i < end; i += 2)
+			x[IDX(i, j, stride)] = (b[IDX(i, j, stride)] + a * (x[IDX(i - 1, j, stride)] + x[IDX(i + 1, j, stride)] + x[IDX(i, j - 1, stride)] + x[IDX(i, j + 1, stride)])) / c;
+	});
+}
+
+template<typename T, int Fixed>
+static double SquaredResidual(const T* RESTRICT x, const T* RESTRICT b, double diagonal, double offDiagonal, int size, int rowBegin, int rowEnd, int columnBegin, int columnEnd)
+{
+	const int stride = Stride<Fixed>(size);
+	double sum = 0.0;
+
+	ForEachRow<Fixed>(rowBegin, rowEnd, columnBegin, columnEnd, [&](int j, int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			double residual = b[IDX(i, j, stride)] - (diagonal * x[IDX(i, j, stride)] - offDiagonal * (x[IDX(i - 1, j, stride)] + x[IDX(i + 1, j, stride)] + x[IDX(i, j - 1, stride)] + x[IDX(i, j + 1, stride)]));
+			sum += residual * residual;
+		}
+	});
+
+	return sum;
+}
+
+template<typename T, int Fixed>
+static double SquaredNorm(const T* RESTRICT b, int size, int rowBegin, int rowEnd, int columnBegin, int columnEnd)
+{
+	const int stride = Stride<Fixed>(size);
+	double sum = 0.0;
+
+	ForEachRow<Fixed>(rowBegin, rowEnd, columnBegin, columnEnd, [&](int j, int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+			sum += b[IDX(i, j, stride)] * b[IDX(i, j, stride)];
+	});
+
+	return sum;
+}
+
+template<typename T, int Fixed>
+static GridKernels<T> MakeKernels()
+{
+	GridKernels<T> kernels;
+	kernels.resolution = Fixed;
+	kernels.divergence = &Divergence<T, Fixed>;
+	kernels.subtractGradient = &SubtractGradient<T, Fixed>;
+	kernels.relaxColor = &RelaxColor<T, Fixed>;
+	kernels.squaredResidual = &SquaredResidual<T, Fixed>;
+	kernels.squaredNorm = &SquaredNorm<T, Fixed>;
+	return kernels;
+}
+
+template<typename T>
+GridKernels<T> GetGridKernels(int resolution, bool specialized)
+{
+	if (!specialized)
+		return MakeKernels<T, 0>();
+
+	switch (resolution)
+	{
+	case 64:	return MakeKernels<T, 64>();
+	case 128:	return MakeKernels<T, 128>();
+	case 256:	return MakeKernels<T, 256>();
+	case 512:	return MakeKernels<T, 512>();
+	case 1024:	return MakeKernels<T, 1024>();
+	default:	return MakeKernels<T, 0>();
+	}
+}
+
+template GridKernels<float> GetGridKernels<float>(int resolution, bool specialized);
+template GridKernels<double> GetGridKernels<double>(int resolution, bool specialized);
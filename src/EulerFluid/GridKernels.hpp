@@ -0,0 +1,42 @@
+#pragma once
+
+/**
+ * The stencil loops of FluidField, working on a block of interior cells
+ * [rowBegin, rowEnd) x [columnBegin, columnEnd) of a grid with `size` cells per row.
+ *
+ * Every kernel is compiled once for a runtime size and once for each of the
+ * resolutions 64, 128, 256, 512 and 1024. The fixed-size variants ignore `size` and
+ * use a constant row stride, and whole rows get constant loop bounds, which lets the
+ * compiler fold the neighbour offsets and vectorize with known trip counts. The fields
+ * are passed as __restrict pointers, so it also knows that writes to one field don't
+ * change the others. Both variants run the same operations in the same order and give
+ * bit-identical results. Instantiated for float and double.
+ */
+template<typename T>
+struct GridKernels
+{
+	// Resolution the kernels were specialized for, 0 for the runtime-size kernels
+	int resolution;
+
+	// Central-difference divergence of (u, v) scaled by -h/2
+	void (*divergence)(const T* u, const T* v, T* divergence, T h, int size, int rowBegin, int rowEnd, int columnBegin, int columnEnd);
+
+	// Subtracts the pressure gradient from (u, v) and returns the largest velocity component left
+	T (*subtractGradient)(T* u, T* v, const T* pressure, T h, int size, int rowBegin, int rowEnd, int columnBegin, int columnEnd);
+
+	// Updates the cells of one color of a red-black Gauss-Seidel sweep
+	void (*relaxColor)(T* x, const T* b, T a, T c, int color, int size, int rowBegin, int rowEnd, int columnBegin, int columnEnd);
+
+	// Sum of the squared residuals of diagonal * x - offDiagonal * neighbours = b
+	double (*squaredResidual)(const T* x, const T* b, double diagonal, double offDiagonal, int size, int rowBegin, int rowEnd, int columnBegin, int columnEnd);
+
+	// Sum of the squares of b
+	double (*squaredNorm)(const T* b, int size, int rowBegin, int rowEnd, int columnBegin, int columnEnd);
+};
+
+/**
+ * Returns the kernels specialized for `resolution` if there are any and `specialized`
+ * is set, and the runtime-size kernels otherwise
+ */
+template<typename T>
+GridKernels<T> GetGridKernels(int resolution, bool specialized = true);
@@ -0,0 +1,159 @@
+#include "ImageWriter.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <vector>
+
+#include "Colormap.hpp"
+
+// Largest payload of a single stored deflate block
+#define DEFLATE_STORED_BLOCK 65535
+
+static uint32_t Crc32(const uint8_t* data, size_t length, uint32_t crc = 0)
+{
+	// Built once on first use, which is thread safe for a function-local static
+	static const std::array<uint32_t, 256> table = []()
+	{
+		std::array<uint32_t, 256> entries = {};
+		for (uint32_t n = 0; n < 256; n++)
+		{
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+
+			entries[n] = c;
+		}
+
+		return entries;
+	}();
+
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+	return ~crc;
+}
+
+static uint32_t Adler32(const uint8_t* data, size_t length)
+{
+	uint32_t a = 1, b = 0;
+	for (size_t i = 0; i < length; i++)
+	{
+		a = (a + data[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+
+	return (b << 16) | a;
+}
+
+static void PutBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back((uint8_t)(value >> 24));
+	out.push_back((uint8_t)(value >> 16));
+	out.push_back((uint8_t)(value >> 8));
+	out.push_back((uint8_t)value);
+}
+
+static bool WriteChunk(FILE* file, const char* type, const std::vector<uint8_t>& data)
+{
+	std::vector<uint8_t> chunk;
+	chunk.reserve(data.size() + 12);
+
+	PutBigEndian(chunk, (uint32_t)data.size());
+	chunk.insert(chunk.end(), type, type + 4);
+	chunk.insert(chunk.end(), data.begin(), data.end());
+	PutBigEndian(chunk, Crc32(chunk.data() + 4, chunk.size() - 4));
+
+	return std::fwrite(chunk.data(), 1, chunk.size(), file) == chunk.size();
+}
+
+bool WritePpm(const std::string& path, int width, int height, const uint32_t* pixels)
+{
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	std::vector<uint8_t> row(3 * (size_t)width);
+	bool ok = std::fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+
+	for (int y = 0; ok && y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			uint32_t color = pixels[(size_t)y * width + x];
+			row[3 * x + 0] = Colormap::Red(color);
+			row[3 * x + 1] = Colormap::Green(color);
+			row[3 * x + 2] = Colormap::Blue(color);
+		}
+
+		ok = std::fwrite(row.data(), 1, row.size(), file) == row.size();
+	}
+
+	return (std::fclose(file) == 0) && ok;
+}
+
+bool WritePng(const std::string& path, int width, int height, const uint32_t* pixels)
+{
+	// Every row starts with its filter type, 0 means unfiltered
+	size_t stride = 1 + 3 * (size_t)width;
+	std::vector<uint8_t> raw(stride * height);
+	for (int y = 0; y < height; y++)
+	{
+		uint8_t* row = raw.data() + y * stride;
+		row[0] = 0;
+
+		for (int x = 0; x < width; x++)
+		{
+			uint32_t color = pixels[(size_t)y * width + x];
+			row[1 + 3 * x + 0] = Colormap::Red(color);
+			row[1 + 3 * x + 1] = Colormap::Green(color);
+			row[1 + 3 * x + 2] = Colormap::Blue(color);
+		}
+	}
+
+	// zlib stream made of stored deflate blocks
+	std::vector<uint8_t> compressed;
+	compressed.reserve(raw.size() + raw.size() / DEFLATE_STORED_BLOCK * 5 + 16);
+	compressed.push_back(0x78);
+	compressed.push_back(0x01);
+
+	size_t offset = 0;
+	do
+	{
+		size_t length = std::min(raw.size() - offset, (size_t)DEFLATE_STORED_BLOCK);
+		bool last = (offset + length == raw.size());
+
+		compressed.push_back(last ? 1 : 0);
+		compressed.push_back((uint8_t)length);
+		compressed.push_back((uint8_t)(length >> 8));
+		compressed.push_back((uint8_t)~length);
+		compressed.push_back((uint8_t)(~length >> 8));
+		compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + length);
+
+		offset += length;
+	} while (offset < raw.size());
+
+	PutBigEndian(compressed, Adler32(raw.data(), raw.size()));
+
+	std::vector<uint8_t> header;
+	PutBigEndian(header, (uint32_t)width);
+	PutBigEndian(header, (uint32_t)height);
+	header.push_back(8);	// Bit depth
+	header.push_back(2);	// Truecolor
+	header.push_back(0);	// Deflate
+	header.push_back(0);	// Adaptive filtering
+	header.push_back(0);	// No interlacing
+
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	bool ok = std::fwrite(signature, 1, sizeof(signature), file) == sizeof(signature)
+		&& WriteChunk(file, "IHDR", header)
+		&& WriteChunk(file, "IDAT", compressed)
+		&& WriteChunk(file, "IEND", std::vector<uint8_t>());
+
+	return (std::fclose(file) == 0) && ok;
+}
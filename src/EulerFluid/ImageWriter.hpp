@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Writers for plain image files, without any dependency on an image library.
+ * Pixels are packed 0xAARRGGBB like the entries of a Colormap, rows from top
+ * to bottom. Alpha is dropped.
+ */
+
+// Binary portable pixmap (P6)
+bool WritePpm(const std::string& path, int width, int height, const uint32_t* pixels);
+
+// 8 bit RGB PNG. The image data goes into stored (uncompressed) deflate blocks, which keeps
+// the writer trivial and fast; the files are about as large as the equivalent PPM.
+bool WritePng(const std::string& path, int width, int height, const uint32_t* pixels);
@@ -0,0 +1,325 @@
+#include "Multigrid.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#define IDX(x, y, w) ((y) * (w) + (x))
+
+// Levels are coarsened until the interior is at most this wide
+#define COARSEST_RESOLUTION 4
+
+#define PRE_SMOOTHING_SWEEPS 2
+#define POST_SMOOTHING_SWEEPS 2
+#define COARSEST_SWEEPS 40
+
+// Below this resolution waking up the pool costs more than the level's kernels
+#define MIN_PARALLEL_RESOLUTION 64
+
+template<typename T>
+Multigrid<T>::Multigrid(int resolution)
+{
+	int N = resolution;
+	while (true)
+	{
+		Level level;
+		level.N = N;
+		level.size = N + 2;
+		level.pressure = FieldVector<T>(level.size * level.size, 0);
+		level.rhs = FieldVector<T>(level.size * level.size, 0);
+		level.residual = FieldVector<T>(level.size * level.size, 0);
+		levels.push_back(std::move(level));
+
+		if (N <= COARSEST_RESOLUTION)
+			break;
+
+		N = (N + 1) / 2;
+	}
+}
+
+template<typename T>
+SolverStats Multigrid<T>::Solve(FieldVector<T>& pressure, const FieldVector<T>& rhs, double tolerance, int maxCycles, MultigridCycle cycle)
+{
+	Level& finest = levels[0];
+
+	// Borrow the caller's buffer as the finest level's solution instead of copying it around
+	finest.pressure.swap(pressure);
+	finest.rhs = rhs;
+
+	// With pure Neumann boundaries the system is only solvable for a right hand side with zero mean
+	RemoveMean(finest, finest.rhs);
+
+	double rhsNorm = Norm(finest, finest.rhs);
+	SolverStats stats;
+
+	if (rhsNorm > 0.0)
+	{
+		ApplyBoundaryConditions(finest);
+		ComputeResidual(finest);
+		stats.residual = Norm(finest, finest.residual) / rhsNorm;
+
+		while (stats.residual > tolerance && stats.iterations < maxCycles)
+		{
+			if (cycle == MultigridCycle::F)
+				FCycle(0);
+			else
+				VCycle(0);
+
+			ComputeResidual(finest);
+			stats.residual = Norm(finest, finest.residual) / rhsNorm;
+			stats.iterations++;
+		}
+	}
+
+	finest.pressure.swap(pressure);
+	return stats;
+}
+
+template<typename T>
+void Multigrid<T>::Precondition(const FieldVector<T>& rhs, FieldVector<T>& correction)
+{
+	Level& finest = levels[0];
+
+	finest.rhs = rhs;
+	RemoveMean(finest, finest.rhs);
+	std::fill(finest.pressure.begin(), finest.pressure.end(), (T)0);
+
+	VCycle(0);
+
+	RemoveMean(finest, finest.pressure);
+	correction = finest.pressure;
+}
+
+template<typename T>
+void Multigrid<T>::VCycle(int level)
+{
+	if (level == (int)levels.size() - 1)
+	{
+		SolveCoarsest();
+		return;
+	}
+
+	Level& fine = levels[level];
+	Level& coarse = levels[level + 1];
+
+	Smooth(fine, PRE_SMOOTHING_SWEEPS);
+	ComputeResidual(fine);
+	Restrict(fine, coarse);
+
+	std::fill(coarse.pressure.begin(), coarse.pressure.end(), (T)0);
+	VCycle(level + 1);
+
+	ProlongateAndCorrect(coarse, fine);
+	Smooth(fine, POST_SMOOTHING_SWEEPS);
+}
+
+template<typename T>
+void Multigrid<T>::FCycle(int level)
+{
+	if (level == (int)levels.size() - 1)
+	{
+		SolveCoarsest();
+		return;
+	}
+
+	Level& fine = levels[level];
+	Level& coarse = levels[level + 1];
+
+	Smooth(fine, PRE_SMOOTHING_SWEEPS);
+	ComputeResidual(fine);
+	Restrict(fine, coarse);
+
+	// An F-cycle revisits the coarse grid once more with a V-cycle before returning
+	std::fill(coarse.pressure.begin(), coarse.pressure.end(), (T)0);
+	FCycle(level + 1);
+	VCycle(level + 1);
+
+	ProlongateAndCorrect(coarse, fine);
+	Smooth(fine, POST_SMOOTHING_SWEEPS);
+}
+
+template<typename T>
+void Multigrid<T>::SolveCoarsest()
+{
+	Level& coarsest = levels.back();
+
+	RemoveMean(coarsest, coarsest.rhs);
+	Smooth(coarsest, COARSEST_SWEEPS);
+}
+
+template<typename T>
+void Multigrid<T>::Smooth(Level& level, int sweeps)
+{
+	int N = level.N;
+	int size = level.size;
+	FieldVector<T>& p = level.pressure;
+	const FieldVector<T>& b = level.rhs;
+
+	// Red-black ordering, so every half sweep only reads values from the other color
+	for (int k = 0; k < sweeps; k++)
+	{
+		for (int color = 0; color < 2; color++)
+		{
+			ParallelFor(PoolFor(level), 1, N + 1, [&](int begin, int end)
+			{
+				for (int j = begin; j < end; j++)
+				{
+					for (int i = 1 + (j + color + 1) % 2; i <= N; i += 2)
+					{
+						p[IDX(i, j, size)] = (b[IDX(i, j, size)] + p[IDX(i - 1, j, size)] + p[IDX(i + 1, j, size)] + p[IDX(i, j - 1, size)] + p[IDX(i, j + 1, size)]) / (T)4;
+					}
+				}
+			});
+
+			ApplyBoundaryConditions(level);
+		}
+	}
+}
+
+template<typename T>
+void Multigrid<T>::ComputeResidual(Level& level)
+{
+	int N = level.N;
+	int size = level.size;
+	const FieldVector<T>& p = level.pressure;
+
+	ParallelFor(PoolFor(level), 1, N + 1, [&](int begin, int end)
+	{
+		for (int j = begin; j < end; j++)
+		{
+			for (int i = 1; i <= N; i++)
+			{
+				level.residual[IDX(i, j, size)] = level.rhs[IDX(i, j, size)] - ((T)4 * p[IDX(i, j, size)] - p[IDX(i - 1, j, size)] - p[IDX(i + 1, j, size)] - p[IDX(i, j - 1, size)] - p[IDX(i, j + 1, size)]);
+			}
+		}
+	});
+}
+
+template<typename T>
+void Multigrid<T>::Restrict(const Level& fine, Level& coarse)
+{
+	// The equations are scaled by h^2, and the coarse cells are twice as wide,
+	// so the coarse right hand side is 4x the average, i.e. the sum of the fine residuals.
+	// Fine cells beyond the edge of an odd-sized grid simply don't contribute.
+	ParallelFor(PoolFor(coarse), 1, coarse.N + 1, [&](int begin, int end)
+	{
+		for (int J = begin; J < end; J++)
+		{
+			for (int I = 1; I <= coarse.N; I++)
+			{
+				T sum = 0;
+				for (int j = 2 * J - 1; j <= std::min(2 * J, fine.N); j++)
+				{
+					for (int i = 2 * I - 1; i <= std::min(2 * I, fine.N); i++)
+					{
+						sum += fine.residual[IDX(i, j, fine.size)];
+					}
+				}
+
+				coarse.rhs[IDX(I, J, coarse.size)] = sum;
+			}
+		}
+	});
+}
+
+template<typename T>
+void Multigrid<T>::ProlongateAndCorrect(Level& coarse, Level& fine)
+{
+	// Bilinear interpolation between coarse cell centers. Each fine cell sits a quarter
+	// coarse cell away from its parent's center, towards one of the neighbours.
+	// The coarse ghost cells hold the boundary values, so no special cases are needed.
+	ApplyBoundaryConditions(coarse);
+
+	ParallelFor(PoolFor(fine), 1, fine.N + 1, [&](int begin, int end)
+	{
+		for (int j = begin; j < end; j++)
+		{
+			int J = (j + 1) / 2;
+			int J2 = (j % 2 == 1) ? J - 1 : J + 1;
+
+			for (int i = 1; i <= fine.N; i++)
+			{
+				int I = (i + 1) / 2;
+				int I2 = (i % 2 == 1) ? I - 1 : I + 1;
+
+				fine.pressure[IDX(i, j, fine.size)] +=
+					(T)0.5625 * coarse.pressure[IDX(I, J, coarse.size)] +
+					(T)0.1875 * (coarse.pressure[IDX(I2, J, coarse.size)] + coarse.pressure[IDX(I, J2, coarse.size)]) +
+					(T)0.0625 * coarse.pressure[IDX(I2, J2, coarse.size)];
+			}
+		}
+	});
+
+	ApplyBoundaryConditions(fine);
+}
+
+template<typename T>
+void Multigrid<T>::ApplyBoundaryConditions(Level& level)
+{
+	int N = level.N;
+	int size = level.size;
+	FieldVector<T>& p = level.pressure;
+	const T half = 0.5;
+
+	for (int i = 1; i <= N; i++)
+	{
+		p[IDX(0, i, size)] = p[IDX(1, i, size)];
+		p[IDX(N + 1, i, size)] = p[IDX(N, i, size)];
+		p[IDX(i, 0, size)] = p[IDX(i, 1, size)];
+		p[IDX(i, N + 1, size)] = p[IDX(i, N, size)];
+	}
+
+	p[IDX(0, 0, size)] = half * (p[IDX(1, 0, size)] + p[IDX(0, 1, size)]);
+	p[IDX(0, N + 1, size)] = half * (p[IDX(1, N + 1, size)] + p[IDX(0, N, size)]);
+	p[IDX(N + 1, 0, size)] = half * (p[IDX(N, 0, size)] + p[IDX(N + 1, 1, size)]);
+	p[IDX(N + 1, N + 1, size)] = half * (p[IDX(N, N + 1, size)] + p[IDX(N + 1, N, size)]);
+}
+
+template<typename T>
+void Multigrid<T>::RemoveMean(Level& level, FieldVector<T>& field)
+{
+	int N = level.N;
+	int size = level.size;
+
+	double sum = ParallelSum(PoolFor(level), 1, N + 1, [&](int begin, int end)
+	{
+		double partial = 0.0;
+		for (int j = begin; j < end; j++)
+			for (int i = 1; i <= N; i++)
+				partial += field[IDX(i, j, size)];
+
+		return partial;
+	});
+
+	double mean = sum / ((double)N * (double)N);
+	ParallelFor(PoolFor(level), 1, N + 1, [&](int begin, int end)
+	{
+		for (int j = begin; j < end; j++)
+			for (int i = 1; i <= N; i++)
+				field[IDX(i, j, size)] -= (T)mean;
+	});
+}
+
+template<typename T>
+double Multigrid<T>::Norm(const Level& level, const FieldVector<T>& field) const
+{
+	double sum = ParallelSum(PoolFor(level), 1, level.N + 1, [&](int begin, int end)
+	{
+		double partial = 0.0;
+		for (int j = begin; j < end; j++)
+			for (int i = 1; i <= level.N; i++)
+				partial += (double)field[IDX(i, j, level.size)] * field[IDX(i, j, level.size)];
+
+		return partial;
+	});
+
+	return std::sqrt(sum);
+}
+
+template<typename T>
+ThreadPool* Multigrid<T>::PoolFor(const Level& level) const
+{
+	return (level.N >= MIN_PARALLEL_RESOLUTION) ? threadPool : nullptr;
+}
+
+template class Multigrid<float>;
+template class Multigrid<double>;
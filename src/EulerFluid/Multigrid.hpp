@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+
+#include "FieldMemory.hpp"
+#include "SolverStats.hpp"
+#include "ThreadPool.hpp"
+
+enum class MultigridCycle
+{
+	V,
+	F
+};
+
+/**
+ * Cell-centered geometric multigrid solver for the pressure Poisson equation
+ *
+ *		4 * p(i, j) - p(i - 1, j) - p(i + 1, j) - p(i, j - 1) - p(i, j + 1) = rhs(i, j)
+ *
+ * on a (N + 2)x(N + 2) grid with continuous (Neumann) ghost cells, which is the
+ * system FluidField::Project relaxes. The grid hierarchy is allocated once
+ * when the solver is constructed and reused by every solve. Instantiated for
+ * float and double; reductions are always accumulated in double precision.
+ */
+template<typename T>
+class Multigrid
+{
+public:
+	Multigrid(int resolution);
+
+	/**
+	 * Solves for `pressure`, using its current contents as the initial guess.
+	 * Stops as soon as the residual relative to the right hand side drops below
+	 * `tolerance`, or after `maxCycles` cycles.
+	 *
+	 * @return The number of cycles performed and the final relative residual
+	 */
+	SolverStats Solve(FieldVector<T>& pressure, const FieldVector<T>& rhs, double tolerance, int maxCycles, MultigridCycle cycle);
+
+	// One V-cycle from a zero guess, which approximates the inverse of the system for
+	// preconditioning. `correction` gets the result with its mean removed.
+	void Precondition(const FieldVector<T>& rhs, FieldVector<T>& correction);
+
+	// Splits the per-level kernels across the given pool, or runs them serially if it is null
+	void SetThreadPool(ThreadPool* pool) { threadPool = pool; }
+
+private:
+	struct Level
+	{
+		int N;
+		int size;
+
+		FieldVector<T> pressure;
+		FieldVector<T> rhs;
+		FieldVector<T> residual;
+	};
+
+	void VCycle(int level);
+	void FCycle(int level);
+	void SolveCoarsest();
+
+	void Smooth(Level& level, int sweeps);
+	void ComputeResidual(Level& level);
+	void Restrict(const Level& fine, Level& coarse);
+	void ProlongateAndCorrect(Level& coarse, Level& fine);
+	void ApplyBoundaryConditions(Level& level);
+	void RemoveMean(Level& level, FieldVector<T>& field);
+
+	double Norm(const Level& level, const FieldVector<T>& field) const;
+	ThreadPool* PoolFor(const Level& level) const;
+
+private:
+	std::vector<Level> levels;
+	ThreadPool* threadPool = nullptr;
+};
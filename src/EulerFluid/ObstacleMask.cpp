@@ -0,0 +1,244 @@
+#include "ObstacleMask.hpp"
+
+#include <cctype>
+#include <cstdio>
+
+#define IDX(x, y, w) ((y) * (w) + (x))
+
+ObstacleMask::ObstacleMask(int resolution) :
+	size(resolution + 2), wordsPerRow((resolution + 2 + 63) / 64)
+{
+	bits.resize((size_t)size * wordsPerRow, 0);
+}
+
+void ObstacleMask::SetSolid(int x, int y, bool solid)
+{
+	if (x < 1 || x > size - 2 || y < 1 || y > size - 2 || IsSolid(x, y) == solid)
+		return;
+
+	bits[(size_t)y * wordsPerRow + (x >> 6)] ^= (uint64_t)1 << (x & 63);
+	solidCount += solid ? 1 : -1;
+}
+
+void ObstacleMask::Compile()
+{
+	int N = size - 2;
+
+	horizontalFaces.clear();
+	verticalFaces.clear();
+	corners.clear();
+	interior.clear();
+
+	for (int y = 1; y <= N; y++)
+	{
+		for (int x = 1; x <= N; x++)
+		{
+			if (!IsSolid(x, y))
+				continue;
+
+			int32_t cell = IDX(x, y, size);
+
+			// The ghost cells around the box count as fluid, they are set from the interior and never solid
+			int32_t neighbors[4] = { IDX(x - 1, y, size), IDX(x + 1, y, size), IDX(x, y - 1, size), IDX(x, y + 1, size) };
+			bool fluid[4] = { !IsSolid(x - 1, y), !IsSolid(x + 1, y), !IsSolid(x, y - 1), !IsSolid(x, y + 1) };
+
+			int count = fluid[0] + fluid[1] + fluid[2] + fluid[3];
+			if (count == 0)
+			{
+				interior.push_back(cell);
+				continue;
+			}
+
+			if (count == 1)
+			{
+				for (int k = 0; k < 4; k++)
+				{
+					if (!fluid[k])
+						continue;
+
+					if (k < 2)
+						horizontalFaces.push_back({ cell, neighbors[k] });
+					else
+						verticalFaces.push_back({ cell, neighbors[k] });
+				}
+
+				continue;
+			}
+
+			CornerLink corner;
+			corner.cell = cell;
+			for (int k = 0; k < 4; k++)
+			{
+				corner.neighbor[k] = fluid[k] ? neighbors[k] : cell;
+				corner.weight[k] = fluid[k] ? 1.0f / (float)count : 0.0f;
+			}
+
+			corners.push_back(corner);
+		}
+	}
+}
+
+bool ObstacleMask::Load(const std::string& path)
+{
+	FILE* file = std::fopen(path.c_str(), "rb");
+	if (file == nullptr)
+	{
+		error = "cannot open " + path;
+		return false;
+	}
+
+	std::vector<unsigned char> contents;
+	unsigned char buffer[65536];
+	size_t read;
+	while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+		contents.insert(contents.end(), buffer, buffer + read);
+
+	std::fclose(file);
+
+	int width, height;
+	std::vector<uint8_t> solid;
+	if (!ParseImage(contents, width, height, solid))
+	{
+		error = path + ": " + error;
+		return false;
+	}
+
+	// Nearest neighbour, with the first image row at the top of the box (y = 1)
+	int N = size - 2;
+	for (int y = 1; y <= N; y++)
+	{
+		int row = (int)((long long)(y - 1) * height / N);
+		for (int x = 1; x <= N; x++)
+		{
+			int column = (int)((long long)(x - 1) * width / N);
+			SetSolid(x, y, solid[(size_t)row * width + column] != 0);
+		}
+	}
+
+	Compile();
+	return true;
+}
+
+bool ObstacleMask::ParseImage(const std::vector<unsigned char>& file, int& width, int& height, std::vector<uint8_t>& solid)
+{
+	size_t position = 0;
+
+	auto skipSpace = [&]()
+	{
+		while (position < file.size())
+		{
+			if (file[position] == '#')
+			{
+				while (position < file.size() && file[position] != '\n')
+					position++;
+			}
+			else if (std::isspace(file[position]))
+			{
+				position++;
+			}
+			else
+			{
+				break;
+			}
+		}
+	};
+
+	auto readNumber = [&](int& value)
+	{
+		skipSpace();
+		if (position >= file.size() || !std::isdigit(file[position]))
+			return false;
+
+		long long number = 0;
+		while (position < file.size() && std::isdigit(file[position]) && number < (1 << 24))
+			number = number * 10 + (file[position++] - '0');
+
+		value = (int)number;
+		return true;
+	};
+
+	if (file.size() < 2 || file[0] != 'P' || file[1] < '1' || file[1] > '5' || file[1] == '3')
+	{
+		error = "not a PBM or PGM image";
+		return false;
+	}
+
+	char format = (char)file[1];
+	position = 2;
+
+	bool bitmap = (format == '1' || format == '4');
+	int maximum = 1;
+	if (!readNumber(width) || !readNumber(height) || (!bitmap && !readNumber(maximum)) || width <= 0 || height <= 0 || maximum <= 0 || maximum > 65535)
+	{
+		error = "corrupt image header";
+		return false;
+	}
+
+	size_t pixels = (size_t)width * height;
+	solid.assign(pixels, 0);
+
+	// Binary data starts after exactly one whitespace character
+	if (format == '4' || format == '5')
+		position++;
+
+	if (format == '1')
+	{
+		// Plain bitmaps don't need whitespace between the digits
+		for (size_t pixel = 0; pixel < pixels; pixel++)
+		{
+			skipSpace();
+			if (position >= file.size() || (file[position] != '0' && file[position] != '1'))
+			{
+				error = "truncated image";
+				return false;
+			}
+
+			solid[pixel] = (file[position++] == '1');
+		}
+	}
+	else if (format == '4')
+	{
+		size_t rowBytes = ((size_t)width + 7) / 8;
+		if (position + rowBytes * height > file.size())
+		{
+			error = "truncated image";
+			return false;
+		}
+
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				solid[(size_t)y * width + x] = (file[position + y * rowBytes + x / 8] >> (7 - x % 8)) & 1;
+	}
+	else if (format == '2')
+	{
+		for (size_t pixel = 0; pixel < pixels; pixel++)
+		{
+			int value;
+			if (!readNumber(value))
+			{
+				error = "truncated image";
+				return false;
+			}
+
+			solid[pixel] = (2 * value < maximum);
+		}
+	}
+	else
+	{
+		size_t sampleBytes = (maximum < 256) ? 1 : 2;
+		if (position + sampleBytes * pixels > file.size())
+		{
+			error = "truncated image";
+			return false;
+		}
+
+		for (size_t pixel = 0; pixel < pixels; pixel++)
+		{
+			const unsigned char* sample = file.data() + position + pixel * sampleBytes;
+			int value = (sampleBytes == 1) ? sample[0] : (sample[0] << 8 | sample[1]);
+			solid[pixel] = (2 * value < maximum);
+		}
+	}
+
+	return true;
+}
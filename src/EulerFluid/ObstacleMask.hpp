@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Solid cells inside the interior of a (N + 2)x(N + 2) grid, one bit per cell.
+ *
+ * Compile turns the mask into lists of the solid cells that border fluid, sorted
+ * by how their value is derived from their fluid neighbours:
+ *
+ *		- faces have fluid on one side only and mirror that neighbour,
+ *		  with the sign flipped for the velocity component normal to the wall
+ *		- corners have fluid on several sides and average them, each with
+ *		  the sign of its direction
+ *
+ * Enforce then only walks these lists, so the interior kernels can update solid
+ * cells like any other and stay free of branches. Solid cells without fluid
+ * neighbours are never read by a fluid cell's stencil and are listed separately,
+ * so fields can be cleared there now and then.
+ */
+class ObstacleMask
+{
+public:
+	ObstacleMask(int resolution = 0);
+
+	/**
+	 * Reads a PBM (P1, P4) or PGM (P2, P5) image and scales it onto the interior.
+	 * Black pixels, or grey ones darker than half the maximum, are solid.
+	 *
+	 * @return false if the file cannot be read. GetError tells why.
+	 */
+	bool Load(const std::string& path);
+	const std::string& GetError() const { return error; }
+
+	void SetSolid(int x, int y, bool solid);
+	bool IsSolid(int x, int y) const
+	{
+		return (bits[(size_t)y * wordsPerRow + (x >> 6)] >> (x & 63)) & 1;
+	}
+
+	// Rebuilds the boundary lists, must be called after the mask changed
+	void Compile();
+
+	/**
+	 * Sets every solid boundary cell from its fluid neighbours.
+	 *
+	 * @param field Cell (x, y) is at field[((y * size) + x) * stride], so one channel of an interleaved field can be passed
+	 * @param horizontalSign Factor for neighbours in x direction, -1 for the horizontal velocity
+	 * @param verticalSign Factor for neighbours in y direction, -1 for the vertical velocity
+	 */
+	template<typename T>
+	void Enforce(T* field, T horizontalSign, T verticalSign, int stride = 1) const
+	{
+		for (const FaceLink& face : horizontalFaces)
+			field[(size_t)face.cell * stride] = horizontalSign * field[(size_t)face.neighbor * stride];
+
+		for (const FaceLink& face : verticalFaces)
+			field[(size_t)face.cell * stride] = verticalSign * field[(size_t)face.neighbor * stride];
+
+		for (const CornerLink& corner : corners)
+		{
+			T horizontal = (T)corner.weight[0] * field[(size_t)corner.neighbor[0] * stride] + (T)corner.weight[1] * field[(size_t)corner.neighbor[1] * stride];
+			T vertical = (T)corner.weight[2] * field[(size_t)corner.neighbor[2] * stride] + (T)corner.weight[3] * field[(size_t)corner.neighbor[3] * stride];
+			field[(size_t)corner.cell * stride] = horizontalSign * horizontal + verticalSign * vertical;
+		}
+	}
+
+	// Zeroes the solid cells that don't border fluid
+	template<typename T>
+	void ClearInterior(T* field, int stride = 1) const
+	{
+		for (int32_t cell : interior)
+			field[(size_t)cell * stride] = (T)0;
+	}
+
+	int GetResolution() const { return size - 2; }
+	bool IsEmpty() const { return solidCount == 0; }
+	long long GetSolidCount() const { return solidCount; }
+	size_t GetBoundaryCount() const { return horizontalFaces.size() + verticalFaces.size() + corners.size(); }
+
+private:
+	struct FaceLink
+	{
+		int32_t cell;
+		int32_t neighbor;
+	};
+
+	// Neighbours left, right, below and above. Missing ones point at the cell itself with a weight of 0.
+	struct CornerLink
+	{
+		int32_t cell;
+		int32_t neighbor[4];
+		float weight[4];
+	};
+
+	bool ParseImage(const std::vector<unsigned char>& file, int& width, int& height, std::vector<uint8_t>& solid);
+
+private:
+	int size;
+	int wordsPerRow;
+	std::vector<uint64_t> bits;
+	long long solidCount = 0;
+
+	std::vector<FaceLink> horizontalFaces;
+	std::vector<FaceLink> verticalFaces;
+	std::vector<CornerLink> corners;
+	std::vector<int32_t> interior;
+
+	std::string error;
+};
@@ -0,0 +1,298 @@
+#include "ScalarTransport.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#include "FloatingPoint.hpp"
+#include "Profiler.hpp"
+
+#define IDX(x, y, w) ((y) * (w) + (x))
+
+#define RELAXATION_SWEEPS 20
+
+template<typename T, int K>
+ScalarTransport<T, K>::ScalarTransport(int resolution) :
+	size(resolution + 2)
+{
+	values = RetentiveArray<T, 1>((size_t)size * size * K);
+}
+
+template<typename T, int K>
+void ScalarTransport<T, K>::AddSource(int x, int y, const std::array<double, K>& amounts, double dt)
+{
+	T* cell = values.Current().data() + (size_t)IDX(x, y, size) * K;
+	for (int c = 0; c < K; c++)
+		cell[c] = std::max((T)(dt * amounts[c]), (T)0);
+}
+
+template<typename T, int K>
+void ScalarTransport<T, K>::QueueSource(int x, int y, const std::array<double, K>& amounts)
+{
+	if (x >= 1 && x <= size - 2 && y >= 1 && y <= size - 2)
+		pendingSources.push_back({ x, y, amounts });
+}
+
+template<typename T, int K>
+void ScalarTransport<T, K>::Diffuse(double diff, double dt)
+{
+	int N = size - 2;
+	double a = dt * diff * N * N;
+
+	if (threadPool || obstacles || periodic)
+		RelaxRedBlack(values[0], values[1], a, 1 + 4 * a, RELAXATION_SWEEPS);
+	else
+		RelaxLexicographic(values[0], values[1], a, 1 + 4 * a, RELAXATION_SWEEPS);
+}
+
+template<typename T, int K>
+void ScalarTransport<T, K>::Advect(const VectorField<T>& velocity, double dt)
+{
+	int N = size - 2;
+	const T dt0 = (T)(dt * N);
+	const T lower = (T)0.5;
+	const T upper = (T)N + (T)0.5;
+	const T period = (T)N;
+
+	const T* u = velocity.horizontal.data();
+	const T* v = velocity.vertical.data();
+	const T* source = values[1].data();
+	T* target = values[0].data();
+
+	ParallelFor(threadPool, 1, N + 1, [&](int begin, int end)
+	{
+		for (int j = begin; j < end; j++)
+		{
+			for (int i = 1; i <= N; i++)
+			{
+				// The same backtrace as AdvectCell, done once for all channels
+				T x = (T)i - dt0 * u[IDX(i, j, size)];
+				T y = (T)j - dt0 * v[IDX(i, j, size)];
+
+				if (periodic)
+				{
+					x = x - period * std::floor((x - lower) / period);
+					y = y - period * std::floor((y - lower) / period);
+				}
+
+				if (x < lower)	x = lower;
+				if (x > upper)	x = upper;
+				if (y < lower)	y = lower;
+				if (y > upper)	y = upper;
+
+				int i0 = (int)x;
+				int j0 = (int)y;
+
+				T s1 = x - (T)i0;
+				T s0 = 1 - s1;
+				T t1 = y - (T)j0;
+				T t0 = 1 - t1;
+
+				const T* corner00 = source + (size_t)IDX(i0, j0, size) * K;
+				const T* corner01 = corner00 + (size_t)size * K;
+				const T* corner10 = corner00 + K;
+				const T* corner11 = corner01 + K;
+				T* cell = target + (size_t)IDX(i, j, size) * K;
+
+				for (int c = 0; c < K; c++)
+					cell[c] = s0 * (t0 * corner00[c] + t1 * corner01[c]) + s1 * (t0 * corner10[c] + t1 * corner11[c]);
+			}
+		}
+	});
+
+	ApplyBoundaryConditions(values[0]);
+}
+
+template<typename T, int K>
+void ScalarTransport<T, K>::Step(const VectorField<T>& velocity, double diff, double dt)
+{
+	PROFILE_SCOPE("ScalarTransport");
+
+	ScopedFlushDenormals flush(std::is_same<T, float>::value);
+
+	for (const Source& source : pendingSources)
+		AddSource(source.x, source.y, source.amounts, dt);
+
+	pendingSources.clear();
+
+	values.Evolve([&]() { Diffuse(diff, dt); });
+	values.Evolve([&]() { Advect(velocity, dt); });
+
+	if (obstacles)
+		for (int c = 0; c < K; c++)
+			obstacles->ClearInterior(values.Current().data() + c, K);
+}
+
+template<typename T, int K>
+void ScalarTransport<T, K>::ExtractChannel(int channel, std::vector<T>& target) const
+{
+	ArraySpan<const T> current = values.Current();
+
+	target.resize((size_t)size * size);
+	for (size_t cell = 0; cell < target.size(); cell++)
+		target[cell] = current[cell * K + channel];
+}
+
+template<typename T, int K>
+void ScalarTransport<T, K>::ApplyBoundaryConditions(ArraySpan<T> field)
+{
+	int N = size - 2;
+	const T half = 0.5;
+	T* x = field.data();
+
+	if (obstacles)
+		for (int c = 0; c < K; c++)
+			obstacles->Enforce(x + c, (T)1, (T)1, K);
+
+	if (periodic)
+	{
+		for (int k = 1; k <= N; k++)
+		{
+			for (int c = 0; c < K; c++)
+			{
+				x[IDX(0, k, size) * K + c] = x[IDX(N, k, size) * K + c];
+				x[IDX(N + 1, k, size) * K + c] = x[IDX(1, k, size) * K + c];
+				x[IDX(k, 0, size) * K + c] = x[IDX(k, N, size) * K + c];
+				x[IDX(k, N + 1, size) * K + c] = x[IDX(k, 1, size) * K + c];
+			}
+		}
+
+		for (int c = 0; c < K; c++)
+		{
+			x[IDX(0, 0, size) * K + c] = x[IDX(N, N, size) * K + c];
+			x[IDX(0, N + 1, size) * K + c] = x[IDX(N, 1, size) * K + c];
+			x[IDX(N + 1, 0, size) * K + c] = x[IDX(1, N, size) * K + c];
+			x[IDX(N + 1, N + 1, size) * K + c] = x[IDX(1, 1, size) * K + c];
+		}
+
+		return;
+	}
+
+	for (int k = 1; k <= N; k++)
+	{
+		for (int c = 0; c < K; c++)
+		{
+			x[IDX(0, k, size) * K + c] = x[IDX(1, k, size) * K + c];
+			x[IDX(N + 1, k, size) * K + c] = x[IDX(N, k, size) * K + c];
+			x[IDX(k, 0, size) * K + c] = x[IDX(k, 1, size) * K + c];
+			x[IDX(k, N + 1, size) * K + c] = x[IDX(k, N, size) * K + c];
+		}
+	}
+
+	for (int c = 0; c < K; c++)
+	{
+		x[IDX(0, 0, size) * K + c] = half * (x[IDX(1, 0, size) * K + c] + x[IDX(0, 1, size) * K + c]);
+		x[IDX(0, N + 1, size) * K + c] = half * (x[IDX(1, N + 1, size) * K + c] + x[IDX(0, N, size) * K + c]);
+		x[IDX(N + 1, 0, size) * K + c] = half * (x[IDX(N, 0, size) * K + c] + x[IDX(N + 1, 1, size) * K + c]);
+		x[IDX(N + 1, N + 1, size) * K + c] = half * (x[IDX(N, N + 1, size) * K + c] + x[IDX(N + 1, N, size) * K + c]);
+	}
+}
+
+template<typename T, int K>
+void ScalarTransport<T, K>::RelaxLexicographic(ArraySpan<T> x, ArraySpan<const T> b, T a, T c, int sweeps)
+{
+	int N = size - 2;
+
+	// Pipelines the sweeps in a wavefront like StencilEngine::Relax, with rows K times as wide
+	size_t rowBytes = 2 * sizeof(T) * (size_t)size * K;
+	int sweepsPerPass = std::max((int)std::min(STENCIL_DEFAULT_CACHE_BYTES / rowBytes, (size_t)size) - 2, 1);
+
+	for (int done = 0; done < sweeps; done += sweepsPerPass)
+	{
+		int depth = std::min(sweepsPerPass, sweeps - done);
+
+		for (int t = 1; t < N + depth; t++)
+		{
+			int first = std::max(0, t - N);
+			int last = std::min(depth - 1, t - 1);
+
+			for (int k = first; k <= last; k++)
+			{
+				int j = t - k;
+
+				RelaxRow(x.data(), b.data(), a, c, j);
+				RefreshGhosts(x.data(), j);
+			}
+		}
+	}
+
+	ApplyBoundaryConditions(x);
+}
+
+template<typename T, int K>
+void ScalarTransport<T, K>::RelaxRow(T* x, const T* b, T a, T c, int j) const
+{
+	int N = size - 2;
+	int stride = size * K;
+
+	T* row = x + (size_t)IDX(0, j, size) * K;
+	const T* above = row - stride;
+	const T* below = row + stride;
+	const T* source = b + (size_t)IDX(0, j, size) * K;
+
+	// Same operation order as StencilEngine::RelaxRow. The channels are independent
+	// chains through the left neighbour, so they overlap instead of waiting on each other.
+	T scale = 1 / c;
+	T left = a * scale;
+
+	for (int i = K; i <= N * K; i += K)
+		for (int channel = i; channel < i + K; channel++)
+			row[channel] = (source[channel] + a * (row[channel + K] + above[channel] + below[channel])) * scale + left * row[channel - K];
+}
+
+template<typename T, int K>
+void ScalarTransport<T, K>::RefreshGhosts(T* x, int j) const
+{
+	int N = size - 2;
+
+	for (int channel = 0; channel < K; channel++)
+	{
+		x[IDX(0, j, size) * K + channel] = x[IDX(1, j, size) * K + channel];
+		x[IDX(N + 1, j, size) * K + channel] = x[IDX(N, j, size) * K + channel];
+	}
+
+	if (j == 1)
+		std::copy(x + IDX(1, 1, size) * K, x + IDX(N + 1, 1, size) * K, x + IDX(1, 0, size) * K);
+
+	if (j == N)
+		std::copy(x + IDX(1, N, size) * K, x + IDX(N + 1, N, size) * K, x + IDX(1, N + 1, size) * K);
+}
+
+template<typename T, int K>
+void ScalarTransport<T, K>::RelaxRedBlack(ArraySpan<T> x, ArraySpan<const T> b, T a, T c, int sweeps)
+{
+	int N = size - 2;
+	int stride = size * K;
+
+	for (int k = 0; k < sweeps; k++)
+	{
+		for (int color = 0; color < 2; color++)
+		{
+			ParallelFor(threadPool, 1, N + 1, [&](int begin, int end)
+			{
+				for (int j = begin; j < end; j++)
+				{
+					for (int i = 1 + (j + color + 1) % 2; i <= N; i += 2)
+					{
+						T* cell = x.data() + (size_t)IDX(i, j, size) * K;
+						const T* rhs = b.data() + (size_t)IDX(i, j, size) * K;
+
+						for (int channel = 0; channel < K; channel++)
+							cell[channel] = (rhs[channel] + a * (cell[channel - K] + cell[channel + K] + cell[channel - stride] + cell[channel + stride])) / c;
+					}
+				}
+			});
+		}
+
+		ApplyBoundaryConditions(x);
+	}
+}
+
+template class ScalarTransport<float, 1>;
+template class ScalarTransport<float, 2>;
+template class ScalarTransport<float, 3>;
+template class ScalarTransport<float, 4>;
+template class ScalarTransport<double, 1>;
+template class ScalarTransport<double, 2>;
+template class ScalarTransport<double, 3>;
+template class ScalarTransport<double, 4>;
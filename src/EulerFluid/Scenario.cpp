@@ -0,0 +1,56 @@
+#include "Scenario.hpp"
+
+#include <algorithm>
+
+#include "FluidField.hpp"
+#include "ScalarTransport.hpp"
+
+template<typename T>
+void QueueStandardScenario(FluidField<T>& field)
+{
+	int N = field.GetResolution();
+	int emitterX = N / 2;
+	int emitterY = N - N / 8;
+	int radius = std::max(N / 64, 1);
+
+	for (int y = emitterY - radius; y <= emitterY + radius; y++)
+	{
+		for (int x = emitterX - radius; x <= emitterX + radius; x++)
+		{
+			field.QueueSource(x, y, 100.0);
+			field.QueueForce(x, y, 0.0, -200.0);
+		}
+	}
+
+	field.QueueForce(N / 4, N / 2, 150.0, 0.0);
+	field.QueueForce(N - N / 4, N / 2, -150.0, 0.0);
+}
+
+template<typename T, int K>
+void QueueStandardScenario(ScalarTransport<T, K>& transport)
+{
+	int N = transport.GetResolution();
+	int emitterX = N / 2;
+	int emitterY = N - N / 8;
+	int radius = std::max(N / 64, 1);
+
+	std::array<double, K> amounts;
+	for (int c = 0; c < K; c++)
+		amounts[c] = 100.0 / (c + 1);
+
+	for (int y = emitterY - radius; y <= emitterY + radius; y++)
+		for (int x = emitterX - radius; x <= emitterX + radius; x++)
+			transport.QueueSource(x, y, amounts);
+}
+
+template void QueueStandardScenario<float>(FluidField<float>& field);
+template void QueueStandardScenario<double>(FluidField<double>& field);
+
+template void QueueStandardScenario<float, 1>(ScalarTransport<float, 1>& transport);
+template void QueueStandardScenario<float, 2>(ScalarTransport<float, 2>& transport);
+template void QueueStandardScenario<float, 3>(ScalarTransport<float, 3>& transport);
+template void QueueStandardScenario<float, 4>(ScalarTransport<float, 4>& transport);
+template void QueueStandardScenario<double, 1>(ScalarTransport<double, 1>& transport);
+template void QueueStandardScenario<double, 2>(ScalarTransport<double, 2>& transport);
+template void QueueStandardScenario<double, 3>(ScalarTransport<double, 3>& transport);
+template void QueueStandardScenario<double, 4>(ScalarTransport<double, 4>& transport);
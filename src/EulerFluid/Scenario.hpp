@@ -0,0 +1,24 @@
+#pragma once
+
+template<typename T>
+class FluidField;
+
+template<typename T, int K>
+class ScalarTransport;
+
+/**
+ * Queues the inputs of the reference scenario used by the headless tools:
+ * a dye emitter near the bottom of the box pushing fluid upwards, and two
+ * opposing side jets that make it roll up into vortices.
+ * Positions scale with the grid, so runs of different sizes are comparable.
+ */
+template<typename T>
+void QueueStandardScenario(FluidField<T>& field);
+
+/**
+ * Queues the dye emitter of the reference scenario for every channel of a
+ * scalar transport. Channel c emits 100 / (c + 1), so channel 0 follows the
+ * density of the field.
+ */
+template<typename T, int K>
+void QueueStandardScenario(ScalarTransport<T, K>& transport);
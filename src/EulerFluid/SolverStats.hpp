@@ -0,0 +1,10 @@
+#pragma once
+
+/**
+ * What a linear solve cost and how far it got
+ */
+struct SolverStats
+{
+	int iterations = 0;		// Sweeps, cycles or iterations, depending on the solver
+	double residual = 0.0;	// Final residual norm relative to the norm of the right hand side
+};
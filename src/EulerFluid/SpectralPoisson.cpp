@@ -0,0 +1,94 @@
+#include "SpectralPoisson.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#define IDX(x, y, w) ((y) * (w) + (x))
+
+// A block of 16x16 complex doubles is 4 KiB, so the source and target blocks stay in L1
+#define TRANSPOSE_BLOCK 16
+
+template<typename T>
+SpectralPoisson<T>::SpectralPoisson(int resolution) :
+	N(resolution), size(resolution + 2), frequencies(resolution / 2 + 1), rowPlan(resolution), columnPlan(resolution)
+{
+	spectrum.resize((size_t)N * frequencies);
+	transposed.resize((size_t)N * frequencies);
+	inverseEigenvalues.resize((size_t)N * frequencies);
+
+	const double pi = std::acos(-1.0);
+	double scale = 1.0 / ((double)N * (double)N);
+
+	for (int kx = 0; kx < frequencies; kx++)
+	{
+		for (int ky = 0; ky < N; ky++)
+		{
+			double eigenvalue = 4.0 - 2.0 * std::cos(2.0 * pi * kx / N) - 2.0 * std::cos(2.0 * pi * ky / N);
+			inverseEigenvalues[IDX(ky, kx, N)] = (kx == 0 && ky == 0) ? (T)0 : (T)(scale / eigenvalue);
+		}
+	}
+}
+
+template<typename T>
+void SpectralPoisson<T>::Solve(ArraySpan<T> x, ArraySpan<const T> b)
+{
+	const T* rhs = b.data();
+	T* solution = x.data();
+
+	ParallelFor(threadPool, 0, N, [&](int begin, int end)
+	{
+		for (int j = begin; j < end; j++)
+			rowPlan.Forward(rhs + IDX(1, j + 1, size), spectrum.data() + IDX(0, j, frequencies));
+	});
+
+	Transpose(spectrum.data(), transposed.data(), N, frequencies);
+
+	// Each column goes forward, gets divided by the eigenvalues and goes back while it is still in cache
+	ParallelFor(threadPool, 0, frequencies, [&](int begin, int end)
+	{
+		for (int kx = begin; kx < end; kx++)
+		{
+			std::complex<T>* column = transposed.data() + IDX(0, kx, N);
+			const T* scale = inverseEigenvalues.data() + IDX(0, kx, N);
+
+			columnPlan.Forward(column);
+			for (int ky = 0; ky < N; ky++)
+				column[ky] *= scale[ky];
+			columnPlan.Inverse(column);
+		}
+	});
+
+	Transpose(transposed.data(), spectrum.data(), frequencies, N);
+
+	ParallelFor(threadPool, 0, N, [&](int begin, int end)
+	{
+		for (int j = begin; j < end; j++)
+			rowPlan.Inverse(spectrum.data() + IDX(0, j, frequencies), solution + IDX(1, j + 1, size));
+	});
+}
+
+template<typename T>
+void SpectralPoisson<T>::Transpose(const std::complex<T>* in, std::complex<T>* out, int rows, int columns)
+{
+	int blocks = (rows + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK;
+
+	ParallelFor(threadPool, 0, blocks, [&](int begin, int end)
+	{
+		for (int rowBlock = begin * TRANSPOSE_BLOCK; rowBlock < std::min(end * TRANSPOSE_BLOCK, rows); rowBlock += TRANSPOSE_BLOCK)
+		{
+			int rowEnd = std::min(rowBlock + TRANSPOSE_BLOCK, rows);
+
+			for (int columnBlock = 0; columnBlock < columns; columnBlock += TRANSPOSE_BLOCK)
+			{
+				int columnEnd = std::min(columnBlock + TRANSPOSE_BLOCK, columns);
+
+				for (int row = rowBlock; row < rowEnd; row++)
+					for (int column = columnBlock; column < columnEnd; column++)
+						out[IDX(row, column, rows)] = in[IDX(column, row, columns)];
+			}
+		}
+	});
+}
+
+template class SpectralPoisson<float>;
+template class SpectralPoisson<double>;
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+#include "ArraySpan.hpp"
+#include "FieldMemory.hpp"
+#include "FourierTransform.hpp"
+#include "ThreadPool.hpp"
+
+/**
+ * Direct solver for the pressure Poisson equation
+ *
+ *		4 * x(i, j) - (x(i - 1, j) + x(i + 1, j) + x(i, j - 1) + x(i, j + 1)) = b(i, j)
+ *
+ * on a periodic N x N grid, where N is a power of two. The five point Laplacian
+ * is diagonal in Fourier space, so the system is solved exactly by a forward 2D
+ * FFT of b, a division by the eigenvalues, and an inverse FFT, in O(N^2 log N).
+ * The constant mode is left at zero, which picks the zero-mean solution.
+ *
+ * Rows are transformed as real sequences, and the half spectrum is transposed in
+ * cache-sized blocks so the column transforms also run over contiguous memory.
+ * Plans, eigenvalues and the spectrum buffers are set up once and reused by every
+ * solve. Instantiated for float and double.
+ */
+template<typename T>
+class SpectralPoisson
+{
+public:
+	SpectralPoisson(int resolution);
+
+	/**
+	 * Writes the solution to the interior of `x`. The ghost cells of `x` and `b`
+	 * are neither read nor written, wrapping them around is up to the caller.
+	 */
+	void Solve(ArraySpan<T> x, ArraySpan<const T> b);
+
+	// Splits the row and column transforms across the given pool, or runs them serially if it is null
+	void SetThreadPool(ThreadPool* pool) { threadPool = pool; }
+
+	static bool SupportsResolution(int resolution) { return resolution >= 4 && IsPowerOfTwo(resolution); }
+
+private:
+	void Transpose(const std::complex<T>* in, std::complex<T>* out, int rows, int columns);
+
+private:
+	int N, size;
+	int frequencies;
+
+	RealFFTPlan<T> rowPlan;
+	FFTPlan<T> columnPlan;
+
+	// Row-major N x (N/2 + 1) half spectrum, and its (N/2 + 1) x N transpose
+	FieldVector<std::complex<T>> spectrum;
+	FieldVector<std::complex<T>> transposed;
+
+	// 1 / (eigenvalue * N^2) in the transposed layout, which also undoes the scaling of both transforms
+	FieldVector<T> inverseEigenvalues;
+
+	ThreadPool* threadPool = nullptr;
+};
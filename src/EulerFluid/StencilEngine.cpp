@@ -0,0 +1,97 @@
+#include "StencilEngine.hpp"
+
+#include <algorithm>
+
+#define IDX(x, y, w) ((y) * (w) + (x))
+
+template<typename T>
+StencilEngine<T>::StencilEngine(int resolution, size_t cacheBytes) :
+	N(resolution), size(resolution + 2), sweepsPerPass(1)
+{
+	SetCacheBytes(cacheBytes);
+}
+
+template<typename T>
+void StencilEngine<T>::SetCacheBytes(size_t bytes)
+{
+	// A pass with K pipelined sweeps touches K + 2 rows of x and the matching rows of b
+	size_t rowBytes = 2 * sizeof(T) * (size_t)size;
+	int rows = (int)std::min(bytes / rowBytes, (size_t)size);
+
+	sweepsPerPass = std::max(rows - 2, 1);
+}
+
+template<typename T>
+void StencilEngine<T>::Relax(ArraySpan<T> x, ArraySpan<const T> b, T a, T c, int sweeps) const
+{
+	T* field = x.data();
+	const T* rhs = b.data();
+
+	for (int done = 0; done < sweeps; done += sweepsPerPass)
+	{
+		int depth = std::min(sweepsPerPass, sweeps - done);
+
+		// At time t, sweep k is on row t - k. Sweeps are advanced in increasing order,
+		// so every row sees its upper neighbour from the same sweep and its lower
+		// neighbour from the previous one, just like in a plain sweep.
+		for (int t = 1; t < N + depth; t++)
+		{
+			int first = std::max(0, t - N);
+			int last = std::min(depth - 1, t - 1);
+
+			for (int k = first; k <= last; k++)
+			{
+				int j = t - k;
+
+				RelaxRow(field, rhs, a, c, j);
+				RefreshGhosts(field, j);
+			}
+		}
+	}
+
+	RefreshCorners(field);
+}
+
+template<typename T>
+void StencilEngine<T>::RelaxRow(T* x, const T* b, T a, T c, int j) const
+{
+	T* row = x + IDX(0, j, size);
+	const T* above = row - size;
+	const T* below = row + size;
+	const T* source = b + IDX(0, j, size);
+
+	// Only the left neighbour depends on the previous iteration, so everything else is
+	// gathered first to keep the divide out of the loop-carried dependency
+	T scale = 1 / c;
+	T left = a * scale;
+
+	for (int i = 1; i <= N; i++)
+		row[i] = (source[i] + a * (row[i + 1] + above[i] + below[i])) * scale + left * row[i - 1];
+}
+
+template<typename T>
+void StencilEngine<T>::RefreshGhosts(T* x, int j) const
+{
+	x[IDX(0, j, size)] = x[IDX(1, j, size)];
+	x[IDX(N + 1, j, size)] = x[IDX(N, j, size)];
+
+	if (j == 1)
+		std::copy(x + IDX(1, 1, size), x + IDX(N + 1, 1, size), x + IDX(1, 0, size));
+
+	if (j == N)
+		std::copy(x + IDX(1, N, size), x + IDX(N + 1, N, size), x + IDX(1, N + 1, size));
+}
+
+template<typename T>
+void StencilEngine<T>::RefreshCorners(T* x) const
+{
+	const T half = 0.5;
+
+	x[IDX(0, 0, size)] = half * (x[IDX(1, 0, size)] + x[IDX(0, 1, size)]);
+	x[IDX(0, N + 1, size)] = half * (x[IDX(1, N + 1, size)] + x[IDX(0, N, size)]);
+	x[IDX(N + 1, 0, size)] = half * (x[IDX(N, 0, size)] + x[IDX(N + 1, 1, size)]);
+	x[IDX(N + 1, N + 1, size)] = half * (x[IDX(N, N + 1, size)] + x[IDX(N + 1, N, size)]);
+}
+
+template class StencilEngine<float>;
+template class StencilEngine<double>;
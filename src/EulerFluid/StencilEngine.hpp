@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include "ArraySpan.hpp"
+
+// Default amount of cache a relaxation pass may keep hot, roughly half of a typical L2
+#define STENCIL_DEFAULT_CACHE_BYTES (512 * 1024)
+
+/**
+ * Runs lexicographic Gauss-Seidel sweeps of the five point system
+ *
+ *		x(i, j) = (b(i, j) + a * (x(i - 1, j) + x(i + 1, j) + x(i, j - 1) + x(i, j + 1))) / c
+ *
+ * on a (N + 2)x(N + 2) grid with continuous ghost cells, which is the system
+ * that both the diffusion and the pressure relaxation solve.
+ *
+ * The grid is traversed row by row, and several sweeps are pipelined in a
+ * wavefront: sweep k works on row j while sweep k + 1 trails behind on row j - 1.
+ * A pass therefore only keeps a band of rows as deep as the number of pipelined
+ * sweeps in cache, and streams the field from memory once per pass instead of
+ * once per sweep. The ghost cells of a row are refreshed as soon as a sweep is
+ * done with it, so the result is bit-identical to running the sweeps one after
+ * the other and applying the boundary conditions after each of them.
+ * Instantiated for float and double.
+ */
+template<typename T>
+class StencilEngine
+{
+public:
+	StencilEngine(int resolution, size_t cacheBytes = STENCIL_DEFAULT_CACHE_BYTES);
+
+	/**
+	 * Performs `sweeps` relaxation sweeps on `x`, using its current contents as the
+	 * initial guess. The ghost cells, including the corners, are up to date afterwards.
+	 */
+	void Relax(ArraySpan<T> x, ArraySpan<const T> b, T a, T c, int sweeps) const;
+
+	// The cache budget decides how many sweeps share one pass over the field
+	void SetCacheBytes(size_t bytes);
+	int GetSweepsPerPass() const { return sweepsPerPass; }
+
+private:
+	void RelaxRow(T* x, const T* b, T a, T c, int j) const;
+	void RefreshGhosts(T* x, int j) const;
+	void RefreshCorners(T* x) const;
+
+private:
+	int N;
+	int size;
+	int sweepsPerPass;
+};
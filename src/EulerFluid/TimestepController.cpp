@@ -0,0 +1,53 @@
+#include "TimestepController.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// A remainder this close to a full step is taken right away instead of waiting a frame for a rounding error
+#define TIMESTEP_SLACK 1e-6
+
+TimestepController::TimestepController(double cfl) :
+	cfl(cfl)
+{
+}
+
+void TimestepController::Accumulate(double frameTime)
+{
+	pending += std::max(frameTime, 0.0);
+	substeps = 0;
+}
+
+double TimestepController::NextTimestep(double maxVelocity, int resolution)
+{
+	double dt = GetStableTimestep(maxVelocity, resolution);
+	if (pending < dt * (1.0 - TIMESTEP_SLACK))
+		return 0.0;
+
+	if (substeps >= maxSubsteps)
+	{
+		// Out of budget for this frame, keep only the part that would not have made a full step anyway
+		pending = std::fmod(pending, dt);
+		return 0.0;
+	}
+
+	dt = std::min(dt, pending);
+	pending -= dt;
+	substeps++;
+
+	return dt;
+}
+
+double TimestepController::GetStableTimestep(double maxVelocity, int resolution) const
+{
+	// The advection traces back dt * N * velocity cells
+	double cellsPerSecond = maxVelocity * (double)resolution;
+	double dt = (cellsPerSecond > 0.0) ? cfl / cellsPerSecond : maxTimestep;
+
+	return std::min(std::max(dt, minTimestep), maxTimestep);
+}
+
+void TimestepController::SetTimestepLimits(double minTimestep, double maxTimestep)
+{
+	this->minTimestep = minTimestep;
+	this->maxTimestep = std::max(maxTimestep, minTimestep);
+}
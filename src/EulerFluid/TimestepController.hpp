@@ -0,0 +1,65 @@
+#pragma once
+
+// Cells the fastest flow may travel per step. The semi-Lagrangian advection stays stable
+// beyond that, but its backtrace gets increasingly inaccurate.
+#define DEFAULT_CFL_NUMBER 1.0
+#define DEFAULT_MIN_TIMESTEP 1e-4
+#define DEFAULT_MAX_TIMESTEP (1.0 / 30.0)
+#define DEFAULT_MAX_SUBSTEPS 8
+
+/**
+ * Chooses the solver timestep from the CFL condition instead of the wall clock.
+ *
+ * Time is handed in once per frame with Accumulate, and taken out again in steps
+ * as large as the flow allows, dt = cfl / (N * maxVelocity), clamped to the
+ * timestep limits. A frame longer than one such step is split into substeps.
+ * A remainder shorter than one step is kept for the next frame, so quiet phases
+ * coalesce several frames into a single step. After a hitch, at most maxSubsteps
+ * steps are taken and the rest of the frame is dropped, so the simulation slows
+ * down for a moment instead of taking a huge step or falling further behind.
+ *
+ *		controller.Accumulate(frameTime);
+ *		while ((dt = controller.NextTimestep(field.GetMaxVelocity(), field.GetResolution())) > 0.0)
+ *			field.Step(visc, diff, dt);
+ */
+class TimestepController
+{
+public:
+	TimestepController(double cfl = DEFAULT_CFL_NUMBER);
+
+	// Adds the wall-clock (or fixed) duration of a frame to the time that still has to be simulated
+	void Accumulate(double frameTime);
+
+	/**
+	 * The next step to take for a flow whose fastest velocity component is `maxVelocity`,
+	 * on a grid with `resolution` interior cells per side. The velocity changes with
+	 * every step, so it should be read again before every call.
+	 *
+	 * @return The timestep, or 0 if nothing more should be simulated this frame
+	 */
+	double NextTimestep(double maxVelocity, int resolution);
+
+	// Largest timestep within the CFL number and the timestep limits
+	double GetStableTimestep(double maxVelocity, int resolution) const;
+
+	void SetCflNumber(double cfl) { this->cfl = cfl; }
+	double GetCflNumber() const { return cfl; }
+
+	void SetTimestepLimits(double minTimestep, double maxTimestep);
+	void SetMaxSubsteps(int substeps) { maxSubsteps = substeps; }
+
+	// Simulated time that has been accumulated but not stepped yet
+	double GetPendingTime() const { return pending; }
+
+	// Steps handed out since the last call to Accumulate
+	int GetSubsteps() const { return substeps; }
+
+private:
+	double cfl;
+	double minTimestep = DEFAULT_MIN_TIMESTEP;
+	double maxTimestep = DEFAULT_MAX_TIMESTEP;
+	int maxSubsteps = DEFAULT_MAX_SUBSTEPS;
+
+	double pending = 0.0;
+	int substeps = 0;
+};
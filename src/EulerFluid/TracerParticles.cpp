@@ -0,0 +1,148 @@
+#include "TracerParticles.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include "Profiler.hpp"
+
+#define IDX(x, y, w) ((y) * (w) + (x))
+
+template<typename T>
+TracerParticles<T>::TracerParticles(int resolution) :
+	N(resolution)
+{
+	SetAdvectionKernel(AdvectionKernel::Auto);
+}
+
+template<typename T>
+void TracerParticles<T>::Seed(int count, unsigned int seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<double> distribution(0.5, N + 0.5);
+
+	x.resize(std::max(count, 0));
+	y.resize(x.size());
+	for (size_t particle = 0; particle < x.size(); particle++)
+	{
+		x[particle] = (T)distribution(generator);
+		y[particle] = (T)distribution(generator);
+	}
+
+	Sort();
+}
+
+template<typename T>
+void TracerParticles<T>::Add(T px, T py)
+{
+	const T lower = (T)0.5;
+	const T upper = (T)N + (T)0.5;
+
+	x.push_back(std::min(std::max(px, lower), upper));
+	y.push_back(std::min(std::max(py, lower), upper));
+}
+
+template<typename T>
+void TracerParticles<T>::Clear()
+{
+	x.clear();
+	y.clear();
+}
+
+template<typename T>
+void TracerParticles<T>::SetAdvectionKernel(AdvectionKernel kernel)
+{
+	advectionKernel = ResolveAdvectionKernel(kernel);
+	advectTracers = GetAdvectTracersFunction<T>(advectionKernel);
+}
+
+template<typename T>
+void TracerParticles<T>::Advect(const VectorField<T>& velocity, double dt)
+{
+	PROFILE_SCOPE("TracerParticles");
+	PROFILE_COUNTER("TracerCount", x.size());
+
+	TracerJob<T> job;
+	job.N = N;
+	job.size = N + 2;
+	job.dt0 = (T)(dt * N);
+	job.halfDt0 = (T)(0.5 * dt * N);
+	job.u = velocity.horizontal.data();
+	job.v = velocity.vertical.data();
+	job.x = x.data();
+	job.y = y.data();
+	job.periodic = periodic;
+
+	ParallelFor(threadPool, 0, GetCount(), [&](int begin, int end)
+	{
+		advectTracers(job, begin, end);
+	});
+
+	steps++;
+	if (sortInterval > 0 && steps % sortInterval == 0)
+		Sort();
+}
+
+template<typename T>
+void TracerParticles<T>::Sort()
+{
+	PROFILE_SCOPE("TracerSort");
+
+	int size = N + 2;
+	int count = GetCount();
+
+	// A counting sort by the cell that holds the lower left corner of the bilinear lookup.
+	// It is stable, so particles that share a cell keep their relative order.
+	cellStarts.assign((size_t)size * size + 1, 0);
+	for (int particle = 0; particle < count; particle++)
+		cellStarts[IDX((int)x[particle], (int)y[particle], size) + 1]++;
+
+	for (size_t cell = 1; cell < cellStarts.size(); cell++)
+		cellStarts[cell] += cellStarts[cell - 1];
+
+	sortedX.resize(x.size());
+	sortedY.resize(y.size());
+	for (int particle = 0; particle < count; particle++)
+	{
+		int target = cellStarts[IDX((int)x[particle], (int)y[particle], size)]++;
+		sortedX[target] = x[particle];
+		sortedY[target] = y[particle];
+	}
+
+	x.swap(sortedX);
+	y.swap(sortedY);
+}
+
+template<typename T>
+bool TracerParticles<T>::Dump(const std::string& path)
+{
+	TracerDumpHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, TRACER_DUMP_MAGIC, sizeof(header.magic));
+	header.version = TRACER_DUMP_VERSION;
+	header.scalarBytes = sizeof(T);
+	header.resolution = (uint32_t)N;
+	header.count = x.size();
+	header.step = steps;
+
+	FILE* file = std::fopen(path.c_str(), "wb");
+	if (file == nullptr)
+	{
+		error = "cannot open " + path;
+		return false;
+	}
+
+	bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1
+		&& std::fwrite(x.data(), sizeof(T), x.size(), file) == x.size()
+		&& std::fwrite(y.data(), sizeof(T), y.size(), file) == y.size();
+
+	ok = (std::fclose(file) == 0) && ok;
+	if (!ok)
+		error = "cannot write " + path;
+
+	return ok;
+}
+
+template class TracerParticles<float>;
+template class TracerParticles<double>;
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "AdvectionKernels.hpp"
+#include "ThreadPool.hpp"
+#include "VectorField.hpp"
+
+/**
+ * Massless particles carried along by the velocity of a FluidField.
+ *
+ * The positions are kept as two separate arrays of x and y coordinates in grid
+ * units, so the advection kernels load and store a whole SIMD register of particles
+ * at a time and only the velocity lookups need gathers. Each step splits the
+ * particles into one contiguous chunk per thread.
+ *
+ * Particles seeded at random scatter their velocity lookups over the whole grid.
+ * Every few steps they are therefore sorted by the cell they are in, so neighbouring
+ * particles read neighbouring velocities. Sorting only changes the order of the
+ * particles, not where they are. Instantiated for float and double.
+ */
+template<typename T>
+class TracerParticles
+{
+public:
+	TracerParticles(int resolution);
+
+	// Replaces all particles with `count` ones spread uniformly over the interior
+	void Seed(int count, unsigned int seed = 1);
+
+	// Adds a particle at (x, y) in grid units, kept inside the interior
+	void Add(T x, T y);
+	void Clear();
+
+	// Moves every particle one midpoint step along `velocity`, and sorts them if it is time to
+	void Advect(const VectorField<T>& velocity, double dt);
+
+	// Sorts the particles by cell
+	void Sort();
+
+	// Sorts every `steps` steps, or never if it is 0
+	void SetSortInterval(int steps) { sortInterval = steps; }
+
+	void SetThreadPool(ThreadPool* pool) { threadPool = pool; }
+
+	// Wraps the particles around the edges, to go with a FluidField in periodic boundary mode
+	void SetPeriodic(bool wrap) { periodic = wrap; }
+
+	void SetAdvectionKernel(AdvectionKernel kernel);
+	AdvectionKernel GetAdvectionKernel() const { return advectionKernel; }
+
+	/**
+	 * Writes the particles to a binary file: a TracerDumpHeader, then `count` x
+	 * coordinates and `count` y coordinates of `scalarBytes` bytes each.
+	 *
+	 * @return false if the file cannot be written. GetError tells why.
+	 */
+	bool Dump(const std::string& path);
+	const std::string& GetError() const { return error; }
+
+	int GetResolution() const { return N; }
+	int GetCount() const { return (int)x.size(); }
+	long long GetStepCount() const { return steps; }
+
+	const FieldVector<T>& GetX() const { return x; }
+	const FieldVector<T>& GetY() const { return y; }
+
+private:
+	int N;
+	FieldVector<T> x;
+	FieldVector<T> y;
+
+	// Scratch space for Sort
+	FieldVector<T> sortedX;
+	FieldVector<T> sortedY;
+	std::vector<int> cellStarts;
+
+	long long steps = 0;
+	int sortInterval = 32;
+
+	ThreadPool* threadPool = nullptr;
+	bool periodic = false;
+
+	AdvectionKernel advectionKernel = AdvectionKernel::Auto;
+	AdvectTracersFunction<T> advectTracers;
+
+	std::string error;
+};
+
+#define TRACER_DUMP_MAGIC "EFTRACE"
+#define TRACER_DUMP_VERSION 1
+
+// Little-endian, as written on the machine that produced the dump
+struct TracerDumpHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t scalarBytes;
+	uint32_t resolution;
+	uint32_t reserved;
+	uint64_t count;
+	int64_t step;
+};
@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "FluidField.hpp"
+#include "ScalarTransport.hpp"
+#include "Scenario.hpp"
+#include "ThreadPool.hpp"
+
+// Times the individual solver kernels over a range of grid sizes and relates them to the
+// memory bandwidth of the machine, so regressions show up as a diff of the JSON output.
+//
+// Bandwidth is reported for the compulsory traffic of a kernel: every array it touches is
+// counted once per read and once per write, as if the whole kernel were a single streaming
+// pass. Iterative kernels move more than that, so their figure says how close the kernel
+// gets to the cost of touching its data once, not how busy the memory bus is.
+
+#define STREAM_ELEMENTS (16 * 1024 * 1024)
+#define STREAM_REPETITIONS 5
+#define WARMUP_STEPS 5
+
+struct BenchOptions
+{
+	std::vector<int> sizes = { 64, 128, 256, 512, 1024, 2048, 4096 };
+	int threads = 0;
+	bool singlePrecision = false;
+	ProjectionMethod projection = ProjectionMethod::GaussSeidel;
+	double minTime = 0.25;
+	int minRepetitions = 3;
+	std::string jsonPath;
+};
+
+struct KernelResult
+{
+	std::string kernel;
+	int N = 0;
+	int repetitions = 0;
+	double seconds = 0.0;		// Median time of one call
+	double nsPerCell = 0.0;
+	double bandwidth = 0.0;		// GB/s of compulsory traffic
+};
+
+static void PrintUsage(const char* program)
+{
+	std::cout << "Usage: " << program << " [options]" << std::endl
+		<< "  --sizes LIST    Comma separated interior resolutions (default 64,128,...,4096)" << std::endl
+		<< "  --threads N     Worker threads, 0 runs the serial solver (default 0)" << std::endl
+		<< "  --precision P   Scalar type of the fields: float, double (default double)" << std::endl
+		<< "  --projection P  Pressure solver: gs, multigrid, cg, spectral (default gs). Spectral runs in a periodic box" << std::endl
+		<< "  --min-time T    Minimum seconds spent on every kernel and size (default 0.25)" << std::endl
+		<< "  --min-reps N    Minimum calls of every kernel and size (default 3)" << std::endl
+		<< "  --json PATH     Also write the results as JSON" << std::endl;
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h" || i + 1 >= argc)
+			return false;
+
+		const char* value = argv[++i];
+		if (arg == "--threads")			options.threads = std::atoi(value);
+		else if (arg == "--min-time")	options.minTime = std::atof(value);
+		else if (arg == "--min-reps")	options.minRepetitions = std::max(std::atoi(value), 1);
+		else if (arg == "--json")		options.jsonPath = value;
+		else if (arg == "--sizes")
+		{
+			options.sizes.clear();
+			std::stringstream list(value);
+			std::string size;
+			while (std::getline(list, size, ','))
+			{
+				if (std::atoi(size.c_str()) >= 4)
+					options.sizes.push_back(std::atoi(size.c_str()));
+			}
+
+			if (options.sizes.empty())
+				return false;
+		}
+		else if (arg == "--precision")
+		{
+			std::string precision = value;
+			if (precision == "float")		options.singlePrecision = true;
+			else if (precision == "double")	options.singlePrecision = false;
+			else
+				return false;
+		}
+		else if (arg == "--projection")
+		{
+			std::string method = value;
+			if (method == "gs")				options.projection = ProjectionMethod::GaussSeidel;
+			else if (method == "multigrid")	options.projection = ProjectionMethod::Multigrid;
+			else if (method == "cg")		options.projection = ProjectionMethod::ConjugateGradient;
+			else if (method == "spectral")	options.projection = ProjectionMethod::Spectral;
+			else
+				return false;
+		}
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<double>(end - start).count();
+}
+
+// Median time of one call, after calling the kernel until both minimums are met
+static double Measure(const std::function<void()>& kernel, const BenchOptions& options, int& repetitions)
+{
+	std::vector<double> samples;
+	double total = 0.0;
+
+	while ((int)samples.size() < options.minRepetitions || total < options.minTime)
+	{
+		auto start = std::chrono::steady_clock::now();
+		kernel();
+		samples.push_back(Seconds(start, std::chrono::steady_clock::now()));
+		total += samples.back();
+	}
+
+	repetitions = (int)samples.size();
+	std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+	return samples[samples.size() / 2];
+}
+
+// Best-of bandwidth of a[i] = b[i] + s * c[i], counting two reads and one write like STREAM does
+template<typename T>
+static double StreamTriad(ThreadPool* pool)
+{
+	std::vector<T> a(STREAM_ELEMENTS), b(STREAM_ELEMENTS, (T)1), c(STREAM_ELEMENTS, (T)2);
+	const T scale = (T)3;
+
+	// Touch the pages on the threads that will use them
+	ParallelFor(pool, 0, STREAM_ELEMENTS, [&](int begin, int end)
+	{
+		std::fill(a.begin() + begin, a.begin() + end, (T)0);
+	});
+
+	double best = 0.0;
+	for (int repetition = 0; repetition < STREAM_REPETITIONS; repetition++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		ParallelFor(pool, 0, STREAM_ELEMENTS, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+				a[i] = b[i] + scale * c[i];
+		});
+
+		double seconds = Seconds(start, std::chrono::steady_clock::now());
+		best = std::max(best, 3.0 * sizeof(T) * STREAM_ELEMENTS / seconds * 1e-9);
+	}
+
+	// Keeps the triad from being optimized away
+	if (a[STREAM_ELEMENTS / 2] != (T)7)
+		std::cerr << "STREAM triad gave a wrong result" << std::endl;
+
+	return best;
+}
+
+template<typename T>
+static void BenchSize(int N, const BenchOptions& options, std::vector<KernelResult>& results)
+{
+	const double dt = 1.0 / 60.0, visc = 0.002, diff = 0.0005;
+
+	FluidField<T> field(N);
+	field.SetThreadCount(options.threads);
+	field.SetProjectionMethod(options.projection);
+
+	// The FFT solver only exists for periodic boxes
+	bool periodic = (options.projection == ProjectionMethod::Spectral);
+	if (periodic)
+		field.SetBoundaryMode(BoundaryMode::Periodic);
+
+	// Give the kernels a flow to work on instead of an empty box
+	for (int step = 0; step < WARMUP_STEPS; step++)
+	{
+		QueueStandardScenario(field);
+		field.Step(visc, diff, dt);
+	}
+
+	// Four dye channels in one transport, to compare against four density steps
+	ScalarTransport<T, 4> scalars(N);
+	scalars.SetThreadPool(field.GetThreadPool());
+	scalars.SetPeriodic(periodic);
+	for (int step = 0; step < WARMUP_STEPS; step++)
+	{
+		QueueStandardScenario(scalars);
+		scalars.Step(field.GetVelocity(), diff, dt);
+	}
+
+	// Boundary conditions work on any field of the right size, so they get one of their own
+	std::vector<T> scratch((size_t)(N + 2) * (N + 2), (T)1);
+
+	double cells = (double)N * (double)N;
+	double arrayBytes = (double)(N + 2) * (double)(N + 2) * sizeof(T);
+
+	// Name, work, cells it updates, compulsory array streams, whether it runs size-specialized loops
+	struct Kernel
+	{
+		const char* name;
+		std::function<void()> run;
+		double cells;
+		double streams;
+		bool specialized;
+	};
+
+	std::vector<Kernel> kernels = {
+		{ "ApplyBoundaryConditions", [&]() { field.ApplyBoundaryConditions(BoundaryCondition::InvertHorizontal, scratch); }, 4.0 * N, 0.0, false },
+		{ "Diffuse", [&]() { field.Diffuse(diff, dt); }, cells, 3.0, true },
+		{ "DiffuseVelocity", [&]() { field.DiffuseVelocity(visc, dt); }, cells, 6.0, true },
+		{ "Advect", [&]() { field.Advect(dt); }, cells, 4.0, false },
+		{ "AdvectVelocity", [&]() { field.AdvectVelocity(dt); }, cells, 4.0, false },
+		{ "Project", [&]() { field.Project(); }, cells, 6.0, true },
+		{ "DensityStep", [&]() { field.DensityStep(diff, dt); }, cells, 7.0, true },
+		{ "ScalarTransport4", [&]() { scalars.Step(field.GetVelocity(), diff, dt); }, cells, 22.0, false },
+		{ "VelocityStep+DensityStep", [&]() { field.VelocityStep(visc, dt); field.DensityStep(diff, dt); }, cells, 12.0, true }
+	};
+
+	auto measure = [&](const Kernel& kernel, const std::string& name)
+	{
+		KernelResult result;
+		result.kernel = name;
+		result.N = N;
+		result.seconds = Measure(kernel.run, options, result.repetitions);
+		result.nsPerCell = result.seconds * 1e9 / kernel.cells;
+
+		// The boundary only touches two cells per updated cell, not whole arrays
+		double bytes = (kernel.streams > 0.0) ? kernel.streams * arrayBytes : 2.0 * kernel.cells * sizeof(T);
+		result.bandwidth = bytes / result.seconds * 1e-9;
+
+		results.push_back(result);
+	};
+
+	for (const Kernel& kernel : kernels)
+		measure(kernel, kernel.name);
+
+	// Sizes with specialized loops are measured again with the runtime-size loops, to see what the constants buy
+	if (field.IsSizeSpecialized())
+	{
+		field.SetSizeSpecialization(false);
+
+		for (const Kernel& kernel : kernels)
+			if (kernel.specialized)
+				measure(kernel, std::string(kernel.name) + "/generic");
+
+		field.SetSizeSpecialization(true);
+	}
+}
+
+static std::string ProjectionName(ProjectionMethod method)
+{
+	switch (method)
+	{
+	case ProjectionMethod::Multigrid:			return "multigrid";
+	case ProjectionMethod::ConjugateGradient:	return "cg";
+	case ProjectionMethod::Spectral:			return "spectral";
+	default:									return "gs";
+	}
+}
+
+static void WriteJson(std::ostream& out, const BenchOptions& options, double stream, const std::vector<KernelResult>& results)
+{
+	out << std::setprecision(6);
+	out << "{" << std::endl
+		<< "  \"precision\": \"" << (options.singlePrecision ? "float" : "double") << "\"," << std::endl
+		<< "  \"threads\": " << options.threads << "," << std::endl
+		<< "  \"projection\": \"" << ProjectionName(options.projection) << "\"," << std::endl
+		<< "  \"stream_triad_gbs\": " << stream << "," << std::endl
+		<< "  \"results\": [" << std::endl;
+
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const KernelResult& result = results[i];
+		out << "    { \"kernel\": \"" << result.kernel << "\", \"N\": " << result.N
+			<< ", \"seconds\": " << result.seconds << ", \"repetitions\": " << result.repetitions
+			<< ", \"ns_per_cell\": " << result.nsPerCell << ", \"gbs\": " << result.bandwidth
+			<< ", \"stream_fraction\": " << result.bandwidth / stream << " }"
+			<< (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+
+	out << "  ]" << std::endl << "}" << std::endl;
+}
+
+template<typename T>
+static int Run(const BenchOptions& options)
+{
+	std::unique_ptr<ThreadPool> pool;
+	if (options.threads > 0)
+		pool = std::make_unique<ThreadPool>(options.threads);
+
+	double stream = StreamTriad<T>(pool.get());
+	pool.reset();
+
+	std::cout << "STREAM triad:  " << std::fixed << std::setprecision(2) << stream << " GB/s" << std::endl << std::endl
+		<< std::left << std::setw(34) << "Kernel" << std::right << std::setw(7) << "N"
+		<< std::setw(14) << "ms/call" << std::setw(12) << "ns/cell" << std::setw(10) << "GB/s" << std::setw(10) << "STREAM" << std::endl;
+
+	std::vector<KernelResult> results;
+	for (int N : options.sizes)
+	{
+		size_t first = results.size();
+		BenchSize<T>(N, options, results);
+
+		for (size_t i = first; i < results.size(); i++)
+		{
+			const KernelResult& result = results[i];
+			std::cout << std::left << std::setw(34) << result.kernel << std::right << std::setw(7) << result.N
+				<< std::setprecision(3) << std::setw(14) << result.seconds * 1e3 << std::setw(12) << result.nsPerCell
+				<< std::setprecision(2) << std::setw(10) << result.bandwidth << std::setw(9) << 100.0 * result.bandwidth / stream << "%" << std::endl;
+		}
+	}
+
+	if (!options.jsonPath.empty())
+	{
+		std::ofstream json(options.jsonPath);
+		WriteJson(json, options, stream, results);
+		if (!json)
+		{
+			std::cerr << "Cannot write " << options.jsonPath << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	if (options.singlePrecision)
+		return Run<float>(options);
+
+	return Run<double>(options);
+}
@@ -0,0 +1,516 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FieldMemory.hpp"
+#include "FluidField.hpp"
+#include "Scenario.hpp"
+#include "WorkStealingPool.hpp"
+
+// Runs every combination of a parameter sweep as an independent simulation inside one process.
+// Each run is a serial FluidField on one worker of a work-stealing pool, so small grids keep all
+// cores busy without paying for a process, and one line of metrics is written as soon as a run ends.
+//
+// The sweep is a text file of "key = value, value, ..." lines, with # starting a comment:
+//
+//		size = 64, 128
+//		steps = 500
+//		viscosity = 0.001, 0.002, 0.004
+//		diffusion = 0.0001, 0.0005
+//
+// Keys that are left out keep the defaults of the headless runner.
+
+struct EnsembleOptions
+{
+	std::string configPath;
+	std::string outputPath;
+	int threads = 0;
+	bool json = false;
+
+	// Negative keeps the default limit of the field memory pool
+	long long poolLimitMiB = -1;
+};
+
+struct SweepConfig
+{
+	std::vector<int> sizes = { 64 };
+	std::vector<int> steps = { 500 };
+	std::vector<double> timesteps = { 1.0 / 60.0 };
+	std::vector<double> viscosities = { 0.002 };
+	std::vector<double> diffusionRates = { 0.0005 };
+	std::vector<ProjectionMethod> projections = { ProjectionMethod::GaussSeidel };
+	std::vector<StepMode> stepModes = { StepMode::Split };
+	std::vector<BoundaryMode> boundaries = { BoundaryMode::Closed };
+	std::vector<bool> singlePrecision = { false };
+};
+
+struct RunSpec
+{
+	int id;
+	int size;
+	int steps;
+	double dt;
+	double viscosity;
+	double diffusionRate;
+	ProjectionMethod projection;
+	StepMode stepMode;
+	BoundaryMode boundary;
+	bool singlePrecision;
+};
+
+struct RunMetrics
+{
+	double seconds = 0.0;
+	double mass = 0.0;
+	double kineticEnergy = 0.0;
+	double maxVelocity = 0.0;
+	double pressureIterations = 0.0;
+	double pressureResidual = 0.0;
+	int worker = 0;
+};
+
+static void PrintUsage(const char* program)
+{
+	std::cout << "Usage: " << program << " --config PATH [options]" << std::endl
+		<< "  --config PATH   Parameter sweep to run, every combination of the listed values is one run" << std::endl
+		<< "  --threads N     Runs executed at the same time (default: one per hardware thread)" << std::endl
+		<< "  --output PATH   Write the per-run metrics there instead of to stdout" << std::endl
+		<< "  --format F      Metrics format: csv, json (one object per line) (default csv)" << std::endl
+		<< "  --pool-limit M  MiB of freed field memory kept for the next runs (default 1024)" << std::endl
+		<< std::endl
+		<< "Sweep keys: size, steps, dt, viscosity, diffusion, projection (gs, multigrid, cg, spectral)," << std::endl
+		<< "            step (split, fused), boundary (closed, periodic), precision (float, double)" << std::endl;
+}
+
+static bool ParseOptions(int argc, char** argv, EnsembleOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h" || i + 1 >= argc)
+			return false;
+
+		const char* value = argv[++i];
+		if (arg == "--config")			options.configPath = value;
+		else if (arg == "--output")		options.outputPath = value;
+		else if (arg == "--threads")	options.threads = std::atoi(value);
+		else if (arg == "--pool-limit")	options.poolLimitMiB = std::atoll(value);
+		else if (arg == "--format")
+		{
+			std::string format = value;
+			if (format == "csv")		options.json = false;
+			else if (format == "json")	options.json = true;
+			else
+			{
+				std::cerr << "Unknown metrics format " << format << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return false;
+		}
+	}
+
+	if (options.configPath.empty())
+	{
+		std::cerr << "No sweep given" << std::endl;
+		return false;
+	}
+
+	if (options.threads <= 0)
+		options.threads = std::max((int)std::thread::hardware_concurrency(), 1);
+
+	return true;
+}
+
+static std::string Trim(const std::string& text)
+{
+	size_t first = text.find_first_not_of(" \t\r");
+	if (first == std::string::npos)
+		return std::string();
+
+	return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+// Parses every comma separated value with `parse`, which returns false for values it doesn't understand
+template<typename Value, typename Parse>
+static bool ParseList(const std::string& values, std::vector<Value>& list, Parse&& parse)
+{
+	list.clear();
+
+	std::stringstream stream(values);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		Value value;
+		if (!parse(Trim(item), value))
+			return false;
+
+		list.push_back(value);
+	}
+
+	return !list.empty();
+}
+
+static bool ParseInteger(const std::string& text, int& value)
+{
+	char* end;
+	value = (int)std::strtol(text.c_str(), &end, 10);
+	return !text.empty() && *end == '\0' && value > 0;
+}
+
+static bool ParseNumber(const std::string& text, double& value)
+{
+	char* end;
+	value = std::strtod(text.c_str(), &end);
+	return !text.empty() && *end == '\0' && value >= 0.0;
+}
+
+static bool ParseProjection(const std::string& text, ProjectionMethod& method)
+{
+	if (text == "gs")				method = ProjectionMethod::GaussSeidel;
+	else if (text == "multigrid")	method = ProjectionMethod::Multigrid;
+	else if (text == "cg")			method = ProjectionMethod::ConjugateGradient;
+	else if (text == "spectral")	method = ProjectionMethod::Spectral;
+	else							return false;
+
+	return true;
+}
+
+static bool ParseStepMode(const std::string& text, StepMode& mode)
+{
+	if (text == "split")		mode = StepMode::Split;
+	else if (text == "fused")	mode = StepMode::Fused;
+	else						return false;
+
+	return true;
+}
+
+static bool ParseBoundary(const std::string& text, BoundaryMode& mode)
+{
+	if (text == "closed")			mode = BoundaryMode::Closed;
+	else if (text == "periodic")	mode = BoundaryMode::Periodic;
+	else							return false;
+
+	return true;
+}
+
+static bool ParsePrecision(const std::string& text, bool& single)
+{
+	if (text == "float")		single = true;
+	else if (text == "double")	single = false;
+	else						return false;
+
+	return true;
+}
+
+static bool LoadSweep(const std::string& path, SweepConfig& config, std::string& error)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		error = "cannot open " + path;
+		return false;
+	}
+
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+
+		line = Trim(line.substr(0, line.find('#')));
+		if (line.empty())
+			continue;
+
+		size_t equals = line.find('=');
+		if (equals == std::string::npos)
+		{
+			error = path + ":" + std::to_string(lineNumber) + ": expected key = values";
+			return false;
+		}
+
+		std::string key = Trim(line.substr(0, equals));
+		std::string values = line.substr(equals + 1);
+
+		bool ok;
+		if (key == "size")				ok = ParseList(values, config.sizes, ParseInteger);
+		else if (key == "steps")		ok = ParseList(values, config.steps, ParseInteger);
+		else if (key == "dt")			ok = ParseList(values, config.timesteps, ParseNumber);
+		else if (key == "viscosity")	ok = ParseList(values, config.viscosities, ParseNumber);
+		else if (key == "diffusion")	ok = ParseList(values, config.diffusionRates, ParseNumber);
+		else if (key == "projection")	ok = ParseList(values, config.projections, ParseProjection);
+		else if (key == "step")			ok = ParseList(values, config.stepModes, ParseStepMode);
+		else if (key == "boundary")		ok = ParseList(values, config.boundaries, ParseBoundary);
+		else if (key == "precision")
+		{
+			// std::vector<bool> has no references to parse into
+			std::vector<int> single;
+			ok = ParseList(values, single, [](const std::string& text, int& value)
+			{
+				bool flag;
+				if (!ParsePrecision(text, flag))
+					return false;
+
+				value = flag;
+				return true;
+			});
+			config.singlePrecision.assign(single.begin(), single.end());
+		}
+		else
+		{
+			error = path + ":" + std::to_string(lineNumber) + ": unknown key " + key;
+			return false;
+		}
+
+		if (!ok)
+		{
+			error = path + ":" + std::to_string(lineNumber) + ": invalid value for " + key;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Every combination of the sweep, numbered in the order of the config
+static bool ExpandSweep(const SweepConfig& config, std::vector<RunSpec>& runs, std::string& error)
+{
+	for (int size : config.sizes)
+	for (int steps : config.steps)
+	for (double dt : config.timesteps)
+	for (double viscosity : config.viscosities)
+	for (double diffusionRate : config.diffusionRates)
+	for (ProjectionMethod projection : config.projections)
+	for (StepMode stepMode : config.stepModes)
+	for (BoundaryMode boundary : config.boundaries)
+	for (bool singlePrecision : config.singlePrecision)
+	{
+		if (size < 4 || dt <= 0.0)
+		{
+			error = "invalid grid size or timestep";
+			return false;
+		}
+
+		if (projection == ProjectionMethod::Spectral && (boundary != BoundaryMode::Periodic || !SpectralPoisson<double>::SupportsResolution(size)))
+		{
+			error = "the spectral projection needs a periodic boundary and a power-of-two size";
+			return false;
+		}
+
+		runs.push_back({ (int)runs.size(), size, steps, dt, viscosity, diffusionRate, projection, stepMode, boundary, singlePrecision });
+	}
+
+	return true;
+}
+
+static const char* ProjectionName(ProjectionMethod method)
+{
+	switch (method)
+	{
+	case ProjectionMethod::Multigrid:			return "multigrid";
+	case ProjectionMethod::ConjugateGradient:	return "cg";
+	case ProjectionMethod::Spectral:			return "spectral";
+	default:									return "gs";
+	}
+}
+
+template<typename T>
+static RunMetrics Simulate(const RunSpec& run)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	// Serial, the ensemble gets its parallelism from running many fields at once
+	FluidField<T> field(run.size);
+	field.SetStepMode(run.stepMode);
+	field.SetBoundaryMode(run.boundary);
+	field.SetProjectionMethod(run.projection);
+
+	long long pressureIterations = 0;
+	for (int step = 0; step < run.steps; step++)
+	{
+		QueueStandardScenario(field);
+		field.Step(run.viscosity, run.diffusionRate, run.dt);
+		pressureIterations += field.GetPressureStats().iterations;
+	}
+
+	int N = run.size;
+	int size = field.GetSize();
+	ArraySpan<const T> density = field.GetDensity();
+	const VectorField<T>& velocity = field.GetVelocity();
+
+	double mass = 0.0, energy = 0.0;
+	for (int j = 1; j <= N; j++)
+	{
+		for (int i = 1; i <= N; i++)
+		{
+			double u = velocity.horizontal[j * size + i];
+			double v = velocity.vertical[j * size + i];
+			mass += density[j * size + i];
+			energy += u * u + v * v;
+		}
+	}
+
+	// Integrals over the unit square, so runs of different sizes are comparable
+	double cellArea = 1.0 / ((double)N * (double)N);
+
+	RunMetrics metrics;
+	metrics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	metrics.mass = mass * cellArea;
+	metrics.kineticEnergy = 0.5 * energy * cellArea;
+	metrics.maxVelocity = field.GetMaxVelocity();
+	metrics.pressureIterations = (double)pressureIterations / run.steps;
+	metrics.pressureResidual = field.GetPressureStats().residual;
+	metrics.worker = WorkStealingPool::GetWorkerIndex();
+	return metrics;
+}
+
+/**
+ * Writes one line per finished run. Runs finish in any order, so every
+ * line carries the run id, and lines are flushed right away so a sweep
+ * can be watched or cut short without losing the finished runs.
+ */
+class MetricsWriter
+{
+public:
+	MetricsWriter(std::ostream& stream, bool json) :
+		stream(stream), json(json)
+	{
+		if (!json)
+		{
+			stream << "run,size,precision,steps,dt,viscosity,diffusion,projection,step,boundary,"
+				"seconds,steps_per_sec,mass,kinetic_energy,max_velocity,pressure_iterations,pressure_residual,worker" << std::endl;
+		}
+	}
+
+	void Write(const RunSpec& run, const RunMetrics& metrics)
+	{
+		std::ostringstream line;
+		line << std::setprecision(9);
+
+		const char* precision = run.singlePrecision ? "float" : "double";
+		const char* step = (run.stepMode == StepMode::Fused) ? "fused" : "split";
+		const char* boundary = (run.boundary == BoundaryMode::Periodic) ? "periodic" : "closed";
+		double stepsPerSecond = run.steps / std::max(metrics.seconds, 1e-9);
+
+		if (json)
+		{
+			line << "{\"run\": " << run.id << ", \"size\": " << run.size << ", \"precision\": \"" << precision << "\""
+				<< ", \"steps\": " << run.steps << ", \"dt\": " << run.dt << ", \"viscosity\": " << run.viscosity
+				<< ", \"diffusion\": " << run.diffusionRate << ", \"projection\": \"" << ProjectionName(run.projection) << "\""
+				<< ", \"step\": \"" << step << "\", \"boundary\": \"" << boundary << "\""
+				<< ", \"seconds\": " << metrics.seconds << ", \"steps_per_sec\": " << stepsPerSecond
+				<< ", \"mass\": " << metrics.mass << ", \"kinetic_energy\": " << metrics.kineticEnergy
+				<< ", \"max_velocity\": " << metrics.maxVelocity << ", \"pressure_iterations\": " << metrics.pressureIterations
+				<< ", \"pressure_residual\": " << metrics.pressureResidual << ", \"worker\": " << metrics.worker << "}";
+		}
+		else
+		{
+			line << run.id << "," << run.size << "," << precision << "," << run.steps << "," << run.dt << ","
+				<< run.viscosity << "," << run.diffusionRate << "," << ProjectionName(run.projection) << "," << step << "," << boundary << ","
+				<< metrics.seconds << "," << stepsPerSecond << "," << metrics.mass << "," << metrics.kineticEnergy << ","
+				<< metrics.maxVelocity << "," << metrics.pressureIterations << "," << metrics.pressureResidual << "," << metrics.worker;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		stream << line.str() << std::endl;
+	}
+
+private:
+	std::ostream& stream;
+	bool json;
+	std::mutex mutex;
+};
+
+int main(int argc, char** argv)
+{
+	EnsembleOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	SweepConfig config;
+	std::vector<RunSpec> runs;
+	std::string error;
+	if (!LoadSweep(options.configPath, config, error) || !ExpandSweep(config, runs, error))
+	{
+		std::cerr << "Invalid sweep: " << error << std::endl;
+		return 1;
+	}
+
+	std::ofstream file;
+	if (!options.outputPath.empty())
+	{
+		file.open(options.outputPath);
+		if (!file)
+		{
+			std::cerr << "Cannot write " << options.outputPath << std::endl;
+			return 1;
+		}
+	}
+
+	MetricsWriter writer(options.outputPath.empty() ? std::cout : file, options.json);
+
+	// Runs of one size free blocks that the next run of that size picks up again. Once the
+	// sweep moves on to other sizes, the pool pushes the stale ones out to stay below the limit.
+	if (options.poolLimitMiB >= 0)
+		SetFieldPoolLimit((size_t)options.poolLimitMiB * 1024 * 1024);
+
+	// The most expensive runs go first, so the cheap ones fill up the gaps at the end
+	std::vector<RunSpec> schedule = runs;
+	std::stable_sort(schedule.begin(), schedule.end(), [](const RunSpec& a, const RunSpec& b)
+	{
+		return (double)a.size * a.size * a.steps > (double)b.size * b.size * b.steps;
+	});
+
+	std::vector<RunMetrics> results(runs.size());
+	long long steals;
+
+	auto start = std::chrono::steady_clock::now();
+	{
+		WorkStealingPool pool(std::min(options.threads, (int)runs.size()));
+
+		for (const RunSpec& run : schedule)
+		{
+			pool.Submit([&writer, &results, run]()
+			{
+				RunMetrics metrics = run.singlePrecision ? Simulate<float>(run) : Simulate<double>(run);
+				results[run.id] = metrics;
+				writer.Write(run, metrics);
+			});
+		}
+
+		pool.Wait();
+		steals = pool.GetStealCount();
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	double busy = 0.0, cellUpdates = 0.0;
+	for (const RunSpec& run : runs)
+	{
+		busy += results[run.id].seconds;
+		cellUpdates += (double)run.size * run.size * run.steps;
+	}
+
+	// The metrics may go to stdout, so the summary goes to stderr
+	int threads = std::min(options.threads, (int)runs.size());
+	std::cerr << "Runs:              " << runs.size() << " on " << threads << " threads, " << steals << " stolen" << std::endl
+		<< "Elapsed:           " << elapsed << " s (" << busy << " s of runs, " << 100.0 * busy / (elapsed * threads) << "% utilization)" << std::endl
+		<< "Runs/sec:          " << runs.size() / elapsed << std::endl
+		<< "Cell updates/sec:  " << cellUpdates / elapsed << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,747 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "Checkpoint.hpp"
+#include "FluidField.hpp"
+#include "FrameRecorder.hpp"
+#include "Profiler.hpp"
+#include "ScalarTransport.hpp"
+#include "Scenario.hpp"
+#include "TimestepController.hpp"
+#include "TracerParticles.hpp"
+
+struct HeadlessOptions
+{
+	int size = 256;
+	int steps = 1000;
+	double dt = 1.0 / 60.0;
+	double viscosity = 0.002;
+	double diffusionRate = 0.0005;
+
+	ProjectionMethod projection = ProjectionMethod::GaussSeidel;
+	MultigridCycle cycle = MultigridCycle::V;
+	double tolerance = 1e-4;
+	int maxIterations = 0;
+	bool pressureWarmStart = true;
+
+	DiffusionMethod diffusionMethod = DiffusionMethod::GaussSeidel;
+	double diffusionTolerance = 1e-4;
+	int diffusionMaxIterations = 0;
+
+	int threads = 0;
+	AdvectionKernel advection = AdvectionKernel::Auto;
+	HugePageMode hugePages = HugePageMode::Advise;
+
+	StepMode stepMode = StepMode::Split;
+	BoundaryMode boundary = BoundaryMode::Closed;
+
+	// A positive threshold only simulates the tiles with anything above it
+	double sparseThreshold = 0.0;
+
+	// Extra dye channels carried along with the density
+	int channels = 0;
+
+	std::string obstaclePath;
+
+	// Particles advected through the velocity after every step
+	int tracers = 0;
+	int tracerSortInterval = 32;
+	std::string tracerDumpPath;
+
+	// A positive CFL number lets the timestep controller cover every frame of length dt
+	double cfl = 0.0;
+	double maxTimestep = DEFAULT_MAX_TIMESTEP;
+
+	bool singlePrecision = false;
+	bool compare = false;
+
+	std::string loadPath;
+	std::string savePath;
+	std::string profilePath;
+
+	RecorderSettings recording;
+};
+
+static void PrintUsage(const char* program)
+{
+	std::cout << "Usage: " << program << " [options]" << std::endl
+		<< "  --size N        Interior grid resolution (default 256)" << std::endl
+		<< "  --steps N       Number of simulation steps (default 1000)" << std::endl
+		<< "  --dt T          Fixed timestep in seconds, or frame interval with --cfl (default 1/60)" << std::endl
+		<< "  --visc V        Viscosity (default 0.002)" << std::endl
+		<< "  --diff D        Density diffusion (default 0.0005)" << std::endl
+		<< "  --projection P  Pressure solver: gs, multigrid, cg, spectral (default gs)" << std::endl
+		<< "  --cycle C       Multigrid cycle: v, f (default v)" << std::endl
+		<< "  --tol T         Relative residual tolerance of the pressure solve (default 1e-4)" << std::endl
+		<< "  --max-iter N    Sweep/cycle/iteration cap of the pressure solve (default: per solver)" << std::endl
+		<< "  --pressure-guess G  Initial guess of the pressure solve: warm, zero (default warm)" << std::endl
+		<< "  --diffusion S   Diffusion solver: gs, cg (default gs)" << std::endl
+		<< "  --diff-tol T    Relative residual tolerance of the diffusion solves (default 1e-4)" << std::endl
+		<< "  --diff-max-iter N  Iteration cap of the diffusion solves (default: per solver)" << std::endl
+		<< "  --threads N     Worker threads, 0 runs the serial solver (default 0)" << std::endl
+		<< "  --advection K   Advection kernel: auto, scalar, avx2, avx512 (default auto)" << std::endl
+		<< "  --huge-pages M  Backing of large fields: off, advise, explicit (default advise)" << std::endl
+		<< "  --step S        Step mode: split, fused (default split)" << std::endl
+		<< "  --boundary B    Edges of the box: closed, periodic (default closed)" << std::endl
+		<< "  --sparse T      Skip tiles where density and velocity stay below T (default off)" << std::endl
+		<< "  --channels K    Also carry K dye channels (1 to 4) through a shared scalar transport (default 0)" << std::endl
+		<< "  --obstacles PATH  Solid cells from a PBM or PGM image, black is solid" << std::endl
+		<< "  --tracers N     Advect N tracer particles through the flow (default 0)" << std::endl
+		<< "  --tracer-sort N Sort the tracers by cell every N steps, 0 never (default 32)" << std::endl
+		<< "  --tracer-dump PATH  Write the final tracer positions to a binary file" << std::endl
+		<< "  --cfl C         Pick timesteps for this CFL number, substepping or coalescing frames (default off)" << std::endl
+		<< "  --max-dt T      Largest timestep the CFL controller may take (default 1/30)" << std::endl
+		<< "  --precision P   Scalar type of the fields: float, double (default double)" << std::endl
+		<< "  --compare       Run float and double side by side and report how far float drifts" << std::endl
+		<< "  --load PATH     Start from a checkpoint instead of an empty box" << std::endl
+		<< "  --save PATH     Write a checkpoint of the final state" << std::endl
+		<< "  --record PATH   Record every step into a compressed recording" << std::endl
+		<< "  --record-bits B Quantization of the recorded fields: 8, 16 (default 16)" << std::endl
+		<< "  --record-queue N  Steps that may wait for the writer before steps are dropped (default 8)" << std::endl
+		<< "  --images PREFIX Write the density of every step to PREFIX_<step>.png" << std::endl
+		<< "  --image-format F  Image format: png, ppm (default png)" << std::endl
+		<< "  --profile PATH  Write a Chrome trace of the solver phases and print their timings" << std::endl;
+}
+
+static bool ParseOptions(int argc, char** argv, HeadlessOptions& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h")
+			return false;
+
+		if (arg == "--compare")
+		{
+			options.compare = true;
+			continue;
+		}
+
+		if (i + 1 >= argc)
+		{
+			std::cerr << "Missing value for " << arg << std::endl;
+			return false;
+		}
+
+		const char* value = argv[++i];
+		if (arg == "--size")		options.size = std::atoi(value);
+		else if (arg == "--steps")	options.steps = std::atoi(value);
+		else if (arg == "--dt")		options.dt = std::atof(value);
+		else if (arg == "--visc")	options.viscosity = std::atof(value);
+		else if (arg == "--diff")	options.diffusionRate = std::atof(value);
+		else if (arg == "--tol")	options.tolerance = std::atof(value);
+		else if (arg == "--max-iter")	options.maxIterations = std::atoi(value);
+		else if (arg == "--diff-tol")	options.diffusionTolerance = std::atof(value);
+		else if (arg == "--diff-max-iter")	options.diffusionMaxIterations = std::atoi(value);
+		else if (arg == "--threads")	options.threads = std::atoi(value);
+		else if (arg == "--cfl")	options.cfl = std::atof(value);
+		else if (arg == "--max-dt")	options.maxTimestep = std::atof(value);
+		else if (arg == "--sparse")	options.sparseThreshold = std::atof(value);
+		else if (arg == "--channels")	options.channels = std::atoi(value);
+		else if (arg == "--obstacles")	options.obstaclePath = value;
+		else if (arg == "--tracers")	options.tracers = std::atoi(value);
+		else if (arg == "--tracer-sort")	options.tracerSortInterval = std::atoi(value);
+		else if (arg == "--tracer-dump")	options.tracerDumpPath = value;
+		else if (arg == "--load")	options.loadPath = value;
+		else if (arg == "--save")	options.savePath = value;
+		else if (arg == "--profile")	options.profilePath = value;
+		else if (arg == "--record")	options.recording.containerPath = value;
+		else if (arg == "--record-bits")	options.recording.bits = std::atoi(value);
+		else if (arg == "--record-queue")	options.recording.queueDepth = std::atoi(value);
+		else if (arg == "--images")
+		{
+			options.recording.imagePrefix = value;
+			if (options.recording.imageFormat == ImageFormat::None)
+				options.recording.imageFormat = ImageFormat::PNG;
+		}
+		else if (arg == "--image-format")
+		{
+			std::string format = value;
+			if (format == "png")		options.recording.imageFormat = ImageFormat::PNG;
+			else if (format == "ppm")	options.recording.imageFormat = ImageFormat::PPM;
+			else
+			{
+				std::cerr << "Unknown image format " << format << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--projection")
+		{
+			std::string method = value;
+			if (method == "gs")				options.projection = ProjectionMethod::GaussSeidel;
+			else if (method == "multigrid")	options.projection = ProjectionMethod::Multigrid;
+			else if (method == "cg")		options.projection = ProjectionMethod::ConjugateGradient;
+			else if (method == "spectral")	options.projection = ProjectionMethod::Spectral;
+			else
+			{
+				std::cerr << "Unknown projection method " << method << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--pressure-guess")
+		{
+			std::string guess = value;
+			if (guess == "warm")		options.pressureWarmStart = true;
+			else if (guess == "zero")	options.pressureWarmStart = false;
+			else
+			{
+				std::cerr << "Unknown pressure guess " << guess << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--boundary")
+		{
+			std::string mode = value;
+			if (mode == "closed")			options.boundary = BoundaryMode::Closed;
+			else if (mode == "periodic")	options.boundary = BoundaryMode::Periodic;
+			else
+			{
+				std::cerr << "Unknown boundary mode " << mode << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--advection")
+		{
+			std::string kernel = value;
+			if (kernel == "auto")			options.advection = AdvectionKernel::Auto;
+			else if (kernel == "scalar")	options.advection = AdvectionKernel::Scalar;
+			else if (kernel == "avx2")		options.advection = AdvectionKernel::AVX2;
+			else if (kernel == "avx512")	options.advection = AdvectionKernel::AVX512;
+			else
+			{
+				std::cerr << "Unknown advection kernel " << kernel << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--huge-pages")
+		{
+			std::string mode = value;
+			if (mode == "off")				options.hugePages = HugePageMode::Off;
+			else if (mode == "advise")		options.hugePages = HugePageMode::Advise;
+			else if (mode == "explicit")	options.hugePages = HugePageMode::Explicit;
+			else
+			{
+				std::cerr << "Unknown huge page mode " << mode << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--step")
+		{
+			std::string mode = value;
+			if (mode == "split")		options.stepMode = StepMode::Split;
+			else if (mode == "fused")	options.stepMode = StepMode::Fused;
+			else
+			{
+				std::cerr << "Unknown step mode " << mode << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--precision")
+		{
+			std::string precision = value;
+			if (precision == "float")		options.singlePrecision = true;
+			else if (precision == "double")	options.singlePrecision = false;
+			else
+			{
+				std::cerr << "Unknown precision " << precision << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--diffusion")
+		{
+			std::string method = value;
+			if (method == "gs")			options.diffusionMethod = DiffusionMethod::GaussSeidel;
+			else if (method == "cg")	options.diffusionMethod = DiffusionMethod::ConjugateGradient;
+			else
+			{
+				std::cerr << "Unknown diffusion method " << method << std::endl;
+				return false;
+			}
+		}
+		else if (arg == "--cycle")
+		{
+			std::string cycle = value;
+			if (cycle == "v")		options.cycle = MultigridCycle::V;
+			else if (cycle == "f")	options.cycle = MultigridCycle::F;
+			else
+			{
+				std::cerr << "Unknown multigrid cycle " << cycle << std::endl;
+				return false;
+			}
+		}
+		else
+		{
+			std::cerr << "Unknown option " << arg << std::endl;
+			return false;
+		}
+	}
+
+	if (options.size < 4 || options.steps < 1 || options.dt <= 0.0 || options.maxTimestep <= 0.0)
+	{
+		std::cerr << "Invalid grid size, step count or timestep" << std::endl;
+		return false;
+	}
+
+	if (options.channels < 0 || options.channels > 4)
+	{
+		std::cerr << "The scalar transport supports 1 to 4 channels" << std::endl;
+		return false;
+	}
+
+	if (options.tracers < 0 || options.tracerSortInterval < 0)
+	{
+		std::cerr << "Invalid tracer count or sort interval" << std::endl;
+		return false;
+	}
+
+	if (options.projection == ProjectionMethod::Spectral &&
+		(options.boundary != BoundaryMode::Periodic || !SpectralPoisson<double>::SupportsResolution(options.size)))
+	{
+		std::cerr << "The spectral projection needs --boundary periodic and a power-of-two size" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Project runs twice per velocity step, only the last solve is visible afterwards
+struct IterationCounts
+{
+	long long steps = 0;
+	double simulatedTime = 0.0;
+	long long pressure = 0;
+	long long viscosity = 0;
+	long long diffusion = 0;
+	double activeFraction = 0.0;
+	double transportSeconds = 0.0;
+	double tracerSeconds = 0.0;
+};
+
+// Advances the extra scalars along the velocity the field just produced
+template<typename T>
+using ScalarStepper = std::function<void(const FluidField<T>& field, double dt)>;
+
+struct FieldError
+{
+	double relative = 0.0;
+	double maximum = 0.0;
+};
+
+template<typename T>
+static void Configure(FluidField<T>& field, const HeadlessOptions& options)
+{
+	field.SetThreadCount(options.threads);
+	field.SetStepMode(options.stepMode);
+	field.SetBoundaryMode(options.boundary);
+	field.SetAdvectionKernel(options.advection);
+	field.SetProjectionMethod(options.projection, options.cycle);
+	field.SetProjectionTolerance(options.tolerance, options.maxIterations);
+	field.SetPressureWarmStart(options.pressureWarmStart);
+	field.SetDiffusionMethod(options.diffusionMethod);
+	field.SetDiffusionTolerance(options.diffusionTolerance, options.diffusionMaxIterations);
+	field.SetSparseThreshold(options.sparseThreshold);
+}
+
+template<typename T>
+static bool LoadObstacles(FluidField<T>& field, const HeadlessOptions& options)
+{
+	if (options.obstaclePath.empty())
+		return true;
+
+	ObstacleMask mask(field.GetResolution());
+	if (!mask.Load(options.obstaclePath))
+	{
+		std::cerr << "Cannot load obstacles: " << mask.GetError() << std::endl;
+		return false;
+	}
+
+	field.SetObstacles(mask);
+	return true;
+}
+
+template<typename T>
+static void Step(FluidField<T>& field, const HeadlessOptions& options, double dt, IterationCounts& counts, const ScalarStepper<T>& scalars, TracerParticles<T>* tracers)
+{
+	QueueStandardScenario(field);
+	field.Step(options.viscosity, options.diffusionRate, dt);
+
+	if (scalars)
+	{
+		auto start = std::chrono::steady_clock::now();
+		scalars(field, dt);
+		counts.transportSeconds += std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	if (tracers)
+	{
+		auto start = std::chrono::steady_clock::now();
+		tracers->Advect(field.GetVelocity(), dt);
+		counts.tracerSeconds += std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	counts.steps++;
+	counts.simulatedTime += dt;
+	counts.pressure += field.GetPressureStats().iterations;
+	counts.viscosity += field.GetViscosityStats().iterations;
+	counts.diffusion += field.GetDiffusionStats().iterations;
+	counts.activeFraction += field.GetActiveFraction();
+}
+
+// One step of length dt, or as many steps as the controller picks to cover dt
+template<typename T>
+static void Frame(FluidField<T>& field, TimestepController& controller, const HeadlessOptions& options, IterationCounts& counts, const ScalarStepper<T>& scalars = ScalarStepper<T>(), TracerParticles<T>* tracers = nullptr)
+{
+	if (options.cfl <= 0.0)
+	{
+		Step(field, options, options.dt, counts, scalars, tracers);
+		return;
+	}
+
+	controller.Accumulate(options.dt);
+
+	double dt;
+	while ((dt = controller.NextTimestep(field.GetMaxVelocity(), field.GetResolution())) > 0.0)
+		Step(field, options, dt, counts, scalars, tracers);
+}
+
+template<typename T, int K>
+static ScalarStepper<T> MakeScalarStepper(const FluidField<T>& field, const HeadlessOptions& options)
+{
+	std::shared_ptr<ScalarTransport<T, K>> transport = std::make_shared<ScalarTransport<T, K>>(field.GetResolution());
+	transport->SetThreadPool(field.GetThreadPool());
+	transport->SetObstacles(field.GetObstacles());
+	transport->SetPeriodic(field.GetBoundaryMode() == BoundaryMode::Periodic);
+
+	double diffusionRate = options.diffusionRate;
+	return [transport, diffusionRate](const FluidField<T>& field, double dt)
+	{
+		QueueStandardScenario(*transport);
+		transport->Step(field.GetVelocity(), diffusionRate, dt);
+	};
+}
+
+// The channel count is a template parameter of the transport, so it is picked here once
+template<typename T>
+static ScalarStepper<T> MakeScalarStepper(const FluidField<T>& field, const HeadlessOptions& options)
+{
+	switch (options.channels)
+	{
+	case 1:		return MakeScalarStepper<T, 1>(field, options);
+	case 2:		return MakeScalarStepper<T, 2>(field, options);
+	case 3:		return MakeScalarStepper<T, 3>(field, options);
+	case 4:		return MakeScalarStepper<T, 4>(field, options);
+	default:	return ScalarStepper<T>();
+	}
+}
+
+template<typename T>
+static std::unique_ptr<TracerParticles<T>> MakeTracers(const FluidField<T>& field, const HeadlessOptions& options)
+{
+	if (options.tracers <= 0)
+		return nullptr;
+
+	std::unique_ptr<TracerParticles<T>> tracers = std::make_unique<TracerParticles<T>>(field.GetResolution());
+	tracers->SetThreadPool(field.GetThreadPool());
+	tracers->SetPeriodic(field.GetBoundaryMode() == BoundaryMode::Periodic);
+	tracers->SetAdvectionKernel(options.advection);
+	tracers->SetSortInterval(options.tracerSortInterval);
+	tracers->Seed(options.tracers);
+	return tracers;
+}
+
+static void ConfigureController(TimestepController& controller, const HeadlessOptions& options)
+{
+	controller.SetCflNumber(options.cfl);
+	controller.SetTimestepLimits(DEFAULT_MIN_TIMESTEP, options.maxTimestep);
+}
+
+template<typename T>
+static void PrintReport(const FluidField<T>& field, const HeadlessOptions& options, const IterationCounts& counts, double elapsed)
+{
+	double cells = (double)options.size * (double)options.size;
+	double steps = (double)std::max(counts.steps, 1LL);
+	std::cout << "Grid:              " << options.size << "x" << options.size << std::endl
+		<< "Precision:         " << (sizeof(T) == sizeof(float) ? "float" : "double") << std::endl
+		<< "Threads:           " << field.GetThreadCount() << std::endl
+		<< "Step mode:         " << (field.GetStepMode() == StepMode::Fused ? "fused" : "split") << std::endl
+		<< "Advection kernel:  " << GetAdvectionKernelName(field.GetAdvectionKernel()) << std::endl
+		<< "Steps:             " << counts.steps << " (dt = " << counts.simulatedTime / steps << ")" << std::endl;
+
+	if (options.cfl > 0.0)
+	{
+		std::cout << "Frames:            " << options.steps << " (dt = " << options.dt << ", CFL " << options.cfl
+			<< ", " << (double)counts.steps / options.steps << " steps/frame)" << std::endl;
+	}
+
+	if (options.sparseThreshold > 0.0)
+		std::cout << "Active area:       " << 100.0 * counts.activeFraction / steps << "% of the grid on average (threshold " << options.sparseThreshold << ")" << std::endl;
+
+	if (field.GetObstacles())
+	{
+		std::cout << "Obstacles:         " << field.GetObstacles()->GetSolidCount() << " solid cells, "
+			<< field.GetObstacles()->GetBoundaryCount() << " on the walls" << std::endl;
+	}
+
+	if (options.channels > 0)
+	{
+		std::cout << "Scalar transport:  " << options.channels << " channels, " << counts.transportSeconds * 1000.0 / steps << " ms/step ("
+			<< counts.transportSeconds * 1000.0 / steps / options.channels << " ms/step per channel)" << std::endl;
+	}
+
+	if (options.tracers > 0)
+	{
+		std::cout << "Tracers:           " << options.tracers << " particles, " << counts.tracerSeconds * 1000.0 / steps << " ms/step ("
+			<< options.tracers * steps / std::max(counts.tracerSeconds, 1e-9) << " particles/sec)" << std::endl;
+	}
+
+	FieldMemoryStats memory = GetFieldMemoryStats();
+	std::cout << "Field memory:      " << memory.liveBytes / (1024 * 1024) << " MiB in use, " << memory.largeBlocks << " huge page aligned blocks, "
+		<< memory.reused << " of " << memory.allocations << " allocations reused" << std::endl;
+
+	std::cout << "Elapsed:           " << elapsed << " s" << std::endl
+		<< "Steps/sec:         " << steps / elapsed << std::endl
+		<< "Cell updates/sec:  " << cells * steps / elapsed << std::endl
+		<< "Pressure solve:    " << counts.pressure / steps << " iterations/step, residual " << field.GetPressureStats().residual << std::endl
+		<< "Viscosity solve:   " << counts.viscosity / steps << " iterations/step, residual " << field.GetViscosityStats().residual << std::endl
+		<< "Diffusion solve:   " << counts.diffusion / steps << " iterations/step, residual " << field.GetDiffusionStats().residual << std::endl;
+}
+
+template<typename T>
+static int Run(const HeadlessOptions& options)
+{
+	FluidField<T> field(options.size);
+	Configure(field, options);
+	if (!LoadObstacles(field, options))
+		return 1;
+
+	TimestepController controller;
+	ConfigureController(controller, options);
+
+	if (!options.loadPath.empty())
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		CheckpointFile checkpoint;
+		if (!checkpoint.Open(options.loadPath))
+		{
+			std::cerr << "Cannot load " << options.loadPath << ": " << checkpoint.GetError() << std::endl;
+			return 1;
+		}
+
+		if (!field.LoadCheckpoint(checkpoint))
+		{
+			std::cerr << "Checkpoint " << options.loadPath << " does not match the grid size or precision" << std::endl;
+			return 1;
+		}
+
+		double elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start).count();
+		std::cout << "Restored step " << field.GetStepCount() << " from " << options.loadPath << " in " << elapsed * 1000.0 << " ms" << std::endl;
+	}
+
+	// Images only make sense with a prefix to write them to
+	RecorderSettings recording = options.recording;
+	if (recording.imagePrefix.empty())
+		recording.imageFormat = ImageFormat::None;
+
+	std::unique_ptr<FrameRecorder<T>> recorder;
+	if (!recording.containerPath.empty() || recording.imageFormat != ImageFormat::None)
+	{
+		recorder = std::make_unique<FrameRecorder<T>>(recording);
+		if (!recorder->IsOpen())
+		{
+			std::cerr << "Cannot record: " << recorder->GetError() << std::endl;
+			return 1;
+		}
+	}
+
+	IterationCounts counts;
+	ScalarStepper<T> scalars = MakeScalarStepper(field, options);
+	std::unique_ptr<TracerParticles<T>> tracers = MakeTracers(field, options);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int step = 0; step < options.steps; step++)
+	{
+		long long before = counts.steps;
+		Frame(field, controller, options, counts, scalars, tracers.get());
+
+		if (recorder && counts.steps != before)
+			recorder->Submit(field);
+	}
+	double elapsed = std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::steady_clock::now() - start).count();
+
+	PrintReport(field, options, counts, elapsed);
+
+	if (recorder)
+	{
+		recorder->Close();
+
+		RecorderStats stats = recorder->GetStats();
+		std::cout << "Recorded:          " << stats.written << " frames, " << stats.dropped << " dropped";
+		if (stats.encodedBytes > 0)
+			std::cout << ", " << stats.encodedBytes / 1024 << " KiB (" << (double)stats.rawBytes / (double)stats.encodedBytes << "x smaller than raw)";
+		std::cout << std::endl;
+
+		if (stats.failed)
+		{
+			std::cerr << "Recording failed: " << recorder->GetError() << std::endl;
+			return 1;
+		}
+	}
+
+	if (tracers && !options.tracerDumpPath.empty())
+	{
+		if (!tracers->Dump(options.tracerDumpPath))
+		{
+			std::cerr << "Cannot dump tracers: " << tracers->GetError() << std::endl;
+			return 1;
+		}
+
+		std::cout << "Dumped " << tracers->GetCount() << " tracers to " << options.tracerDumpPath << std::endl;
+	}
+
+	if (!options.savePath.empty())
+	{
+		auto saveStart = std::chrono::steady_clock::now();
+		std::future<bool> saved = field.SaveCheckpoint(options.savePath);
+		auto saveCopied = std::chrono::steady_clock::now();
+
+		if (!saved.get())
+		{
+			std::cerr << "Cannot write " << options.savePath << std::endl;
+			return 1;
+		}
+
+		auto saveEnd = std::chrono::steady_clock::now();
+		std::cout << "Saved step " << field.GetStepCount() << " to " << options.savePath << " ("
+			<< std::chrono::duration<double, std::milli>(saveCopied - saveStart).count() << " ms blocking, "
+			<< std::chrono::duration<double, std::milli>(saveEnd - saveStart).count() << " ms total)" << std::endl;
+	}
+
+	return 0;
+}
+
+// L2 norm of the difference relative to the reference, and the largest absolute difference, over the interior
+static FieldError CompareFields(ArraySpan<const float> approximation, ArraySpan<const double> reference, int N)
+{
+	int size = N + 2;
+	double difference = 0.0, norm = 0.0;
+
+	FieldError error;
+	for (int j = 1; j <= N; j++)
+	{
+		for (int i = 1; i <= N; i++)
+		{
+			double delta = (double)approximation[j * size + i] - reference[j * size + i];
+			difference += delta * delta;
+			norm += reference[j * size + i] * reference[j * size + i];
+			error.maximum = std::max(error.maximum, std::abs(delta));
+		}
+	}
+
+	error.relative = (norm > 0.0) ? std::sqrt(difference / norm) : 0.0;
+	return error;
+}
+
+static int RunComparison(const HeadlessOptions& options)
+{
+	FluidField<float> single(options.size);
+	FluidField<double> reference(options.size);
+	Configure(single, options);
+	Configure(reference, options);
+	if (!LoadObstacles(single, options) || !LoadObstacles(reference, options))
+		return 1;
+
+	TimestepController singleController, referenceController;
+	ConfigureController(singleController, options);
+	ConfigureController(referenceController, options);
+
+	IterationCounts singleCounts, referenceCounts;
+	double singleElapsed = 0.0, referenceElapsed = 0.0;
+
+	int interval = std::max(options.steps / 10, 1);
+
+	std::cout << std::setw(8) << "Step" << std::setw(16) << "density rel" << std::setw(16) << "density max"
+		<< std::setw(16) << "velocity rel" << std::setw(16) << "velocity max" << std::endl;
+
+	for (int step = 1; step <= options.steps; step++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		Frame(single, singleController, options, singleCounts);
+		auto middle = std::chrono::steady_clock::now();
+		Frame(reference, referenceController, options, referenceCounts);
+		auto end = std::chrono::steady_clock::now();
+
+		singleElapsed += std::chrono::duration_cast<std::chrono::duration<double>>(middle - start).count();
+		referenceElapsed += std::chrono::duration_cast<std::chrono::duration<double>>(end - middle).count();
+
+		if (step % interval != 0 && step != options.steps)
+			continue;
+
+		FieldError density = CompareFields(single.GetDensity(), reference.GetDensity(), options.size);
+		FieldError horizontal = CompareFields(single.GetVelocity().horizontal, reference.GetVelocity().horizontal, options.size);
+		FieldError vertical = CompareFields(single.GetVelocity().vertical, reference.GetVelocity().vertical, options.size);
+
+		std::cout << std::setw(8) << step << std::setw(16) << density.relative << std::setw(16) << density.maximum
+			<< std::setw(16) << std::max(horizontal.relative, vertical.relative)
+			<< std::setw(16) << std::max(horizontal.maximum, vertical.maximum) << std::endl;
+	}
+
+	std::cout << std::endl;
+	PrintReport(single, options, singleCounts, singleElapsed);
+	std::cout << std::endl;
+	PrintReport(reference, options, referenceCounts, referenceElapsed);
+
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	HeadlessOptions options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	if (!options.profilePath.empty())
+	{
+		if (!EULER_FLUID_PROFILING)
+			std::cerr << "Profiling was compiled out, the trace will be empty" << std::endl;
+
+		Profiler::SetThreadName("Solver");
+		Profiler::SetEnabled(true);
+	}
+
+	SetHugePageMode(options.hugePages);
+
+	int result;
+	if (options.compare)
+		result = RunComparison(options);
+	else if (options.singlePrecision)
+		result = Run<float>(options);
+	else
+		result = Run<double>(options);
+
+	if (!options.profilePath.empty())
+	{
+		Profiler::SetEnabled(false);
+
+		std::cout << std::endl;
+		Profiler::PrintSummary(std::cout);
+
+		if (!Profiler::WriteChromeTrace(options.profilePath))
+		{
+			std::cerr << "Cannot write " << options.profilePath << std::endl;
+			return 1;
+		}
+	}
+
+	return result;
+}
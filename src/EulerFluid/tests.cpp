@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AdvectionKernels.hpp"
+#include "Checkpoint.hpp"
+#include "FieldMemory.hpp"
+#include "FluidField.hpp"
+#include "FrameRecorder.hpp"
+#include "ScalarTransport.hpp"
+#include "Scenario.hpp"
+
+#define TEST_RESOLUTION 61
+#define TEST_STEPS 24
+#define TEST_VISCOSITY 0.002
+#define TEST_DIFFUSION 0.0005
+#define TEST_DT (1.0 / 60.0)
+
+/**
+ * Checks for the invariants the solver promises: the SIMD kernels match the scalar
+ * ones, threaded runs are reproducible, checkpoints resume exactly, recordings read
+ * back within their quantization, and the scalar transport follows the density.
+ * Every check is registered with CTest on its own, `EulerFluidTests NAME` runs one
+ * of them and no argument runs all of them.
+ */
+
+static bool Check(bool condition, const std::string& what)
+{
+	if (!condition)
+		std::cerr << "FAILED: " << what << std::endl;
+
+	return condition;
+}
+
+template<typename T>
+static bool SameBits(ArraySpan<const T> a, ArraySpan<const T> b)
+{
+	return a.size() == b.size() && std::memcmp(a.data(), b.data(), sizeof(T) * a.size()) == 0;
+}
+
+template<typename T>
+static bool SameState(const FluidField<T>& a, const FluidField<T>& b)
+{
+	return SameBits(a.GetDensity(), b.GetDensity())
+		&& SameBits<T>(a.GetVelocity().horizontal, b.GetVelocity().horizontal)
+		&& SameBits<T>(a.GetVelocity().vertical, b.GetVelocity().vertical);
+}
+
+template<typename T>
+static void Run(FluidField<T>& field, int steps)
+{
+	for (int i = 0; i < steps; i++)
+	{
+		QueueStandardScenario(field);
+		field.Step(TEST_VISCOSITY, TEST_DIFFUSION, TEST_DT);
+	}
+}
+
+template<typename T>
+static const char* TypeName()
+{
+	return (sizeof(T) == sizeof(float)) ? "float" : "double";
+}
+
+template<typename T>
+static bool CheckAdvectionKernels()
+{
+	const int N = TEST_RESOLUTION;
+	const int size = N + 2;
+	const int cells = size * size;
+	const int particles = 1000 + 13;
+
+	std::mt19937 random(7);
+	std::uniform_real_distribution<double> velocity(-3.0, 3.0);
+	std::uniform_real_distribution<double> value(0.0, 1.0);
+	std::uniform_real_distribution<double> position(0.0, N + 1.0);
+
+	std::vector<T> u(cells), v(cells);
+	std::vector<std::vector<T>> sources(ADVECTION_MAX_CHANNELS, std::vector<T>(cells));
+	for (int i = 0; i < cells; i++)
+	{
+		u[i] = (T)velocity(random);
+		v[i] = (T)velocity(random);
+		for (std::vector<T>& source : sources)
+			source[i] = (T)value(random);
+	}
+
+	std::vector<T> startX(particles), startY(particles);
+	for (int i = 0; i < particles; i++)
+	{
+		startX[i] = (T)position(random);
+		startY[i] = (T)position(random);
+	}
+
+	bool ok = true;
+	for (bool periodic : { false, true })
+	{
+		// Scalar reference for the cells and the particles
+		std::vector<std::vector<T>> expected(ADVECTION_MAX_CHANNELS, std::vector<T>(cells, 0));
+		std::vector<T> expectedX = startX, expectedY = startY;
+
+		AdvectionJob<T> job;
+		job.N = N;
+		job.size = size;
+		job.dt0 = (T)(TEST_DT * N);
+		job.columnBegin = 1;
+		job.columnEnd = N + 1;
+		job.u = u.data();
+		job.v = v.data();
+		job.channels = ADVECTION_MAX_CHANNELS;
+		job.periodic = periodic;
+		for (int c = 0; c < ADVECTION_MAX_CHANNELS; c++)
+		{
+			job.source[c] = sources[c].data();
+			job.target[c] = expected[c].data();
+		}
+
+		TracerJob<T> tracerJob;
+		tracerJob.N = N;
+		tracerJob.size = size;
+		tracerJob.dt0 = job.dt0;
+		tracerJob.halfDt0 = job.dt0 / 2;
+		tracerJob.u = u.data();
+		tracerJob.v = v.data();
+		tracerJob.x = expectedX.data();
+		tracerJob.y = expectedY.data();
+		tracerJob.periodic = periodic;
+
+		AdvectRowsScalar<T>(job, 1, N + 1);
+		AdvectTracersScalar<T>(tracerJob, 0, particles);
+
+		for (AdvectionKernel kernel : { AdvectionKernel::AVX2, AdvectionKernel::AVX512 })
+		{
+			std::string name = std::string(GetAdvectionKernelName(kernel)) + " " + TypeName<T>() + (periodic ? " periodic" : " closed");
+			if (ResolveAdvectionKernel(kernel) != kernel)
+			{
+				std::cout << "Skipping " << name << ", not supported here" << std::endl;
+				continue;
+			}
+
+			std::vector<std::vector<T>> actual(ADVECTION_MAX_CHANNELS, std::vector<T>(cells, 0));
+			for (int c = 0; c < ADVECTION_MAX_CHANNELS; c++)
+				job.target[c] = actual[c].data();
+
+			// An odd column range leaves a remainder for the scalar tail of every row
+			GetAdvectRowsFunction<T>(kernel)(job, 1, N + 1);
+
+			for (int c = 0; c < ADVECTION_MAX_CHANNELS; c++)
+				ok = Check(SameBits<T>(actual[c], expected[c]), name + " advection of channel " + std::to_string(c)) && ok;
+
+			std::vector<T> x = startX, y = startY;
+			tracerJob.x = x.data();
+			tracerJob.y = y.data();
+			GetAdvectTracersFunction<T>(kernel)(tracerJob, 0, particles);
+
+			ok = Check(SameBits<T>(x, expectedX) && SameBits<T>(y, expectedY), name + " tracer advection") && ok;
+		}
+	}
+
+	// The whole solver picks its kernel at runtime, so the runs must agree as well
+	FluidField<T> reference(TEST_RESOLUTION);
+	reference.SetAdvectionKernel(AdvectionKernel::Scalar);
+	Run(reference, TEST_STEPS);
+
+	FluidField<T> automatic(TEST_RESOLUTION);
+	automatic.SetAdvectionKernel(AdvectionKernel::Auto);
+	Run(automatic, TEST_STEPS);
+
+	ok = Check(SameState(reference, automatic), std::string(GetAdvectionKernelName(automatic.GetAdvectionKernel())) + " " + TypeName<T>() + " field") && ok;
+	return ok;
+}
+
+static bool TestAdvection()
+{
+	return CheckAdvectionKernels<float>() & CheckAdvectionKernels<double>();
+}
+
+static bool TestThreads()
+{
+	bool ok = true;
+
+	for (StepMode mode : { StepMode::Split, StepMode::Fused })
+	{
+		for (int threads : { 2, 3 })
+		{
+			FluidField<double> first(TEST_RESOLUTION);
+			FluidField<double> second(TEST_RESOLUTION);
+
+			for (FluidField<double>* field : { &first, &second })
+			{
+				field->SetStepMode(mode);
+				field->SetThreadCount(threads);
+				Run(*field, TEST_STEPS);
+			}
+
+			ok = Check(SameState(first, second), std::to_string(threads) + " threads, " + (mode == StepMode::Fused ? "fused" : "split") + " step") && ok;
+		}
+	}
+
+	return ok;
+}
+
+static bool TestCheckpoint()
+{
+	const std::string path = "EulerFluidTests.chk";
+	bool ok = true;
+
+	for (int threads : { 0, 2 })
+	{
+		FluidField<double> original(TEST_RESOLUTION);
+		original.SetThreadCount(threads);
+		Run(original, TEST_STEPS);
+
+		if (!Check(original.SaveCheckpoint(path).get(), "writing " + path))
+			return false;
+
+		Run(original, TEST_STEPS);
+
+		CheckpointFile checkpoint;
+		if (!Check(checkpoint.Open(path), "opening " + path + ": " + checkpoint.GetError()))
+			return false;
+
+		FluidField<double> resumed(TEST_RESOLUTION);
+		resumed.SetThreadCount(threads);
+		ok = Check(resumed.LoadCheckpoint(checkpoint), "loading " + path) && ok;
+		Run(resumed, TEST_STEPS);
+
+		ok = Check(resumed.GetStepCount() == original.GetStepCount(), "step count after resuming") && ok;
+		ok = Check(SameState(original, resumed), "resumed state with " + std::to_string(threads) + " threads") && ok;
+	}
+
+	// Headers whose arrays would land outside the file or off the scalar alignment must be rejected
+	CheckpointHeader valid;
+	{
+		FILE* file = std::fopen(path.c_str(), "rb");
+		ok = Check(file != nullptr && std::fread(&valid, sizeof(valid), 1, file) == 1, "reading the header of " + path) && ok;
+		if (file != nullptr)
+			std::fclose(file);
+	}
+
+	const uint64_t strides[] = {
+		((uint64_t)1 << 61) + CHECKPOINT_ALIGNMENT,		// Wraps the size of all arrays around to a few pages
+		valid.arrayBytes									// Fits in the file, but leaves the later arrays unaligned
+	};
+
+	for (uint64_t stride : strides)
+	{
+		CheckpointHeader header = valid;
+		header.arrayStride = stride;
+
+		FILE* file = std::fopen(path.c_str(), "r+b");
+		ok = Check(file != nullptr && std::fwrite(&header, sizeof(header), 1, file) == 1, "patching " + path) && ok;
+		if (file != nullptr)
+			std::fclose(file);
+
+		CheckpointFile checkpoint;
+		ok = Check(!checkpoint.Open(path), "rejecting an array stride of " + std::to_string(stride)) && ok;
+	}
+
+	std::remove(path.c_str());
+	return ok;
+}
+
+static bool TestRecording()
+{
+	const std::string path = "EulerFluidTests.efr";
+	bool ok = true;
+
+	for (int bits : { 8, 16 })
+	{
+		RecorderSettings settings;
+		settings.containerPath = path;
+		settings.bits = bits;
+		settings.keyframeInterval = 5;
+		settings.queueDepth = RECORDER_MAX_QUEUE_DEPTH;
+
+		FluidField<double> field(TEST_RESOLUTION);
+		std::vector<FluidFrame<double>> frames(TEST_STEPS);
+
+		{
+			FrameRecorder<double> recorder(settings);
+			if (!Check(recorder.IsOpen(), "creating " + path + ": " + recorder.GetError()))
+				return false;
+
+			for (int i = 0; i < TEST_STEPS; i++)
+			{
+				Run(field, 1);
+				field.Snapshot(frames[i]);
+
+				// Dropped frames are fine for the recorder, but the check wants all of them
+				while (!recorder.Submit(field))
+					std::this_thread::yield();
+			}
+
+			recorder.Close();
+			ok = Check(!recorder.GetStats().failed, "writing " + path + ": " + recorder.GetError()) && ok;
+		}
+
+		RecordingReader reader;
+		if (!Check(reader.Open(path), "opening " + path + ": " + reader.GetError()))
+			return false;
+
+		ok = Check(reader.GetResolution() == TEST_RESOLUTION && reader.GetFrameCount() == TEST_STEPS, "frame count of the recording") && ok;
+		if (!ok)
+			return false;
+
+		// A keyframe range can grow by the headroom on each side, and rounding adds half a level
+		double levels = (double)((1u << bits) - 1);
+		double tolerance[RECORDING_CHANNELS] = { 0.0 };
+		for (const FluidFrame<double>& frame : frames)
+		{
+			ArraySpan<const double> channels[RECORDING_CHANNELS] = { frame.density, frame.velocity.horizontal, frame.velocity.vertical };
+			for (int c = 0; c < RECORDING_CHANNELS; c++)
+			{
+				auto range = std::minmax_element(channels[c].begin(), channels[c].end());
+				tolerance[c] = std::max(tolerance[c], (*range.second - *range.first) * 1.5 / levels + 1e-6);
+			}
+		}
+
+		// Backwards, so every frame is decoded from its keyframe, and then forwards, frame after frame
+		std::vector<int> order;
+		for (int i = TEST_STEPS - 1; i >= 0; i--)
+			order.push_back(i);
+		for (int i = 0; i < TEST_STEPS; i++)
+			order.push_back(i);
+
+		FluidFrame<double> decoded;
+		for (int i : order)
+		{
+			if (!Check(reader.ReadFrame(i, decoded), "decoding frame " + std::to_string(i) + ": " + reader.GetError()))
+				return false;
+
+			const FluidFrame<double>& frame = frames[i];
+			ArraySpan<const double> expected[RECORDING_CHANNELS] = { frame.density, frame.velocity.horizontal, frame.velocity.vertical };
+			ArraySpan<const double> actual[RECORDING_CHANNELS] = { decoded.density, decoded.velocity.horizontal, decoded.velocity.vertical };
+
+			bool close = decoded.step == frame.step;
+			for (int c = 0; c < RECORDING_CHANNELS; c++)
+				for (size_t k = 0; close && k < expected[c].size(); k++)
+					close = std::abs(expected[c][k] - actual[c][k]) <= tolerance[c];
+
+			ok = Check(close, std::to_string(bits) + " bit frame " + std::to_string(i)) && ok;
+		}
+	}
+
+	std::remove(path.c_str());
+	return ok;
+}
+
+template<typename T>
+static bool CheckTransport()
+{
+	FluidField<T> field(TEST_RESOLUTION);
+	ScalarTransport<T, 1> transport(TEST_RESOLUTION);
+
+	std::vector<T> channel;
+	bool ok = true;
+
+	for (int i = 0; ok && i < TEST_STEPS; i++)
+	{
+		Run(field, 1);
+
+		QueueStandardScenario(transport);
+		transport.Step(field.GetVelocity(), TEST_DIFFUSION, TEST_DT);
+		transport.ExtractChannel(0, channel);
+
+		ok = Check(SameBits<T>(channel, field.GetDensity()), std::string(TypeName<T>()) + " transport at step " + std::to_string(i + 1));
+	}
+
+	return ok;
+}
+
+static bool TestTransport()
+{
+	return CheckTransport<float>() & CheckTransport<double>();
+}
+
+static bool TestMemory()
+{
+	{
+		FluidField<float> small(TEST_RESOLUTION);
+		FluidField<double> large(4 * TEST_RESOLUTION);
+		Run(small, 2);
+		Run(large, 2);
+	}
+
+	bool ok = Check(GetFieldMemoryStats().pooledBytes > 0, "freed fields are pooled");
+
+	ReleasePooledFieldMemory();
+	FieldMemoryStats stats = GetFieldMemoryStats();
+	ok = Check(stats.liveBytes == 0, "no field memory is live, " + std::to_string(stats.liveBytes) + " bytes") && ok;
+	ok = Check(stats.pooledBytes == 0, "the pool is empty after the release, " + std::to_string(stats.pooledBytes) + " bytes") && ok;
+	return ok;
+}
+
+struct TestCase
+{
+	const char* name;
+	bool (*run)();
+};
+
+static const TestCase TEST_CASES[] = {
+	{ "advection", &TestAdvection },
+	{ "threads", &TestThreads },
+	{ "checkpoint", &TestCheckpoint },
+	{ "recording", &TestRecording },
+	{ "transport", &TestTransport },
+	{ "memory", &TestMemory }
+};
+
+int main(int argc, char** argv)
+{
+	std::string selected = (argc > 1) ? argv[1] : "";
+	bool found = false;
+	bool ok = true;
+
+	for (const TestCase& test : TEST_CASES)
+	{
+		if (!selected.empty() && selected != test.name)
+			continue;
+
+		found = true;
+		bool passed = test.run();
+		std::cout << (passed ? "passed: " : "FAILED: ") << test.name << std::endl;
+		ok = ok && passed;
+	}
+
+	if (!found)
+	{
+		std::cerr << "Unknown test " << selected << std::endl;
+		return 1;
+	}
+
+	return ok ? 0 : 1;
+}